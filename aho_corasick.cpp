@@ -0,0 +1,98 @@
+#include "aho_corasick.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+    constexpr uint32_t kNoState = UINT32_MAX;
+}
+
+AhoCorasick::AhoCorasick() : m_classCount(1), m_patternCount(0), m_distinctCount(0), m_rootOutput(-1) {
+    std::fill(std::begin(m_classOf), std::end(m_classOf), 0);
+    m_transitions.assign(1, 0);
+    m_output.assign(1, -1);
+    m_outputLink.assign(1, -1);
+}
+
+void AhoCorasick::build(const std::vector<std::string>& patterns) {
+    // One input class per distinct pattern byte, class 0 for everything else
+    std::fill(std::begin(m_classOf), std::end(m_classOf), 0);
+    m_classCount = 1;
+    for (const auto& pattern : patterns) {
+        for (char c : pattern) {
+            unsigned char byte = static_cast<unsigned char>(c);
+            if (m_classOf[byte] == 0) {
+                m_classOf[byte] = static_cast<uint16_t>(m_classCount++);
+            }
+        }
+    }
+
+    m_patternCount = patterns.size();
+    m_distinctCount = 0;
+    m_rootOutput = -1;
+    m_transitions.assign(m_classCount, kNoState);
+    m_output.assign(1, -1);
+    m_outputLink.assign(1, -1);
+
+    // Build the trie of patterns
+    for (size_t index = 0; index < patterns.size(); index++) {
+        uint32_t state = 0;
+        for (char c : patterns[index]) {
+            size_t slot = state * m_classCount + m_classOf[static_cast<unsigned char>(c)];
+            if (m_transitions[slot] == kNoState) {
+                m_transitions[slot] = static_cast<uint32_t>(m_output.size());
+                m_transitions.resize(m_transitions.size() + m_classCount, kNoState);
+                m_output.push_back(-1);
+                m_outputLink.push_back(-1);
+            }
+            state = m_transitions[slot];
+        }
+
+        if (state == 0) {
+            if (m_rootOutput < 0) {
+                m_rootOutput = static_cast<int32_t>(index);
+                m_distinctCount++;
+            }
+        } else if (m_output[state] < 0) {
+            m_output[state] = static_cast<int32_t>(index);
+            m_distinctCount++;
+        }
+    }
+
+    // Breadth-first, fill in failure transitions so every state has a move for every class
+    std::vector<uint32_t> failure(m_output.size(), 0);
+    std::vector<uint32_t> queue;
+    queue.reserve(m_output.size());
+
+    for (size_t c = 0; c < m_classCount; c++) {
+        uint32_t& next = m_transitions[c];
+        if (next == kNoState) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+
+    for (size_t head = 0; head < queue.size(); head++) {
+        uint32_t state = queue[head];
+        for (size_t c = 0; c < m_classCount; c++) {
+            uint32_t& next = m_transitions[state * m_classCount + c];
+            uint32_t fallback = m_transitions[failure[state] * m_classCount + c];
+            if (next == kNoState) {
+                next = fallback;
+                continue;
+            }
+
+            failure[next] = fallback;
+            m_outputLink[next] = m_output[fallback] >= 0 ? static_cast<int32_t>(fallback) : m_outputLink[fallback];
+            queue.push_back(next);
+        }
+    }
+}
+
+size_t AhoCorasick::getPatternCount() const {
+    return m_patternCount;
+}
+
+size_t AhoCorasick::getDistinctPatternCount() const {
+    return m_distinctCount;
+}
@@ -0,0 +1,65 @@
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Aho-Corasick automaton for finding a fixed set of patterns in a text.
+ * The patterns are compiled once into a complete state machine, after which
+ * a text of any length is scanned with exactly one table lookup per byte,
+ * however many patterns there are.
+ * Bytes that occur in no pattern share a single input class, so the
+ * transition table only has one column per distinct pattern byte.
+ */
+class AhoCorasick {
+public:
+    AhoCorasick();
+
+    // Compile the patterns, replacing any previous set
+    void build(const std::vector<std::string>& patterns);
+
+    // Number of compiled patterns, and of different ones among them
+    size_t getPatternCount() const;
+    size_t getDistinctPatternCount() const;
+
+    // Call onMatch(patternIndex, end) for every occurrence, where end is one past the
+    // occurrence's last byte. Duplicate patterns report the index of their first copy.
+    // Scanning stops early when onMatch returns false.
+    template <typename Func>
+    void scan(std::string_view text, Func onMatch) const {
+        if (m_rootOutput >= 0 && !onMatch(static_cast<size_t>(m_rootOutput), 0)) {
+            return;
+        }
+
+        uint32_t state = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            state = m_transitions[state * m_classCount + m_classOf[static_cast<unsigned char>(text[i])]];
+
+            // Walk the states whose patterns end here
+            int32_t outputState = m_output[state] >= 0 ? static_cast<int32_t>(state) : m_outputLink[state];
+            while (outputState > 0) {
+                if (!onMatch(static_cast<size_t>(m_output[outputState]), i + 1)) {
+                    return;
+                }
+                outputState = m_outputLink[outputState];
+            }
+        }
+    }
+
+private:
+    uint16_t m_classOf[256];            // Input class of each byte; 0 for bytes in no pattern
+    size_t m_classCount;
+    size_t m_patternCount;
+    size_t m_distinctCount;
+
+    std::vector<uint32_t> m_transitions;    // Next state, indexed by state * m_classCount + class
+    std::vector<int32_t> m_output;          // Pattern ending exactly at each state, or -1
+    std::vector<int32_t> m_outputLink;      // Nearest suffix state with an output, or -1
+    int32_t m_rootOutput;                   // Index of an empty pattern, or -1
+};
+
+#endif // AHO_CORASICK_H
@@ -0,0 +1,32 @@
+#include "atom_table.h"
+
+const std::string& Atom::str() const {
+    static const std::string empty;
+    return m_text != nullptr ? *m_text : empty;
+}
+
+AtomTable& AtomTable::global() {
+    static AtomTable table;
+    return table;
+}
+
+Atom AtomTable::intern(std::string_view text) {
+    auto found = m_index.find(text);
+    if (found != m_index.end()) {
+        return Atom(found->second);
+    }
+
+    // The index's key views the stored copy, not the caller's text
+    const std::string& stored = m_texts.emplace_back(text);
+    m_index.emplace(std::string_view(stored), &stored);
+    return Atom(&stored);
+}
+
+Atom AtomTable::find(std::string_view text) const {
+    auto found = m_index.find(text);
+    return found != m_index.end() ? Atom(found->second) : Atom();
+}
+
+size_t AtomTable::size() const {
+    return m_texts.size();
+}
@@ -0,0 +1,71 @@
+#ifndef ATOM_TABLE_H
+#define ATOM_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * An interned string. Two atoms of the same text are the same pointer, so
+ * comparing atoms never looks at their bytes, and every use of a text shares
+ * the one copy the table holds.
+ */
+class Atom {
+public:
+    Atom() : m_text(nullptr) {}
+
+    // True for the atom of no text, returned by AtomTable::find for text never interned
+    bool isNull() const { return m_text == nullptr; }
+
+    // The text; empty for a null atom
+    const std::string& str() const;
+    std::string_view view() const { return str(); }
+
+    bool operator==(Atom other) const { return m_text == other.m_text; }
+    bool operator!=(Atom other) const { return m_text != other.m_text; }
+
+private:
+    friend class AtomTable;
+    friend struct std::hash<Atom>;
+
+    explicit Atom(const std::string* text) : m_text(text) {}
+
+    const std::string* m_text;
+};
+
+template <>
+struct std::hash<Atom> {
+    size_t operator()(Atom atom) const { return std::hash<const std::string*>{}(atom.m_text); }
+};
+
+/**
+ * The texts atoms stand for. Interned text lives as long as the table, so
+ * only program text is interned: the identifiers, literals and statements of
+ * a script, which are bounded by its size. Data a script reads or builds at
+ * run time must not be, or the table would grow without bound.
+ */
+class AtomTable {
+public:
+    // The table shared by the interpreter, its parser and the values it creates
+    static AtomTable& global();
+
+    // The atom of text, added if it is new
+    Atom intern(std::string_view text);
+
+    // The atom of text, or a null atom if it was never interned
+    Atom find(std::string_view text) const;
+
+    // Number of distinct texts interned
+    size_t size() const;
+
+private:
+    // Texts sit in a deque so that growing it never moves them
+    std::deque<std::string> m_texts;
+    std::unordered_map<std::string_view, const std::string*> m_index;
+};
+
+#endif // ATOM_TABLE_H
@@ -0,0 +1,97 @@
+// Insert and lookup cost of FlameTable against the std::map FlameMemory used before it.
+//
+// Build and run from the repository root:
+//   g++ -std=c++17 -O2 -I. -o flame_table_bench bench/flame_table_bench.cpp flame_table.cpp variable.cpp
+//       parser.cpp value_map.cpp bit_vector.cpp buffer_view.cpp memory_manager.cpp scratch_arena.cpp
+//       utils.cpp string_kernels.cpp    (one command, wrapped here)
+//   ./flame_table_bench [maxKeys]
+//
+// Keys are "key<i>", each with the same int value. Lookups visit every key once in a shuffled
+// order so neither container is helped by walking its keys in storage order.
+
+#include "flame_table.h"
+#include "variable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double nanosecondsPer(Clock::time_point start, size_t count) {
+        std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+        return elapsed.count() / static_cast<double>(count);
+    }
+
+    // Keeps the compiler from dropping lookups whose result is unused
+    volatile size_t g_sink;
+
+    void run(size_t count) {
+        // Every key gets a copy of the same value, which keeps 10M keys within a few GB
+        const Variable value("int.value", "42");
+        std::vector<std::string> keys;
+        keys.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            keys.push_back("key" + std::to_string(i));
+        }
+        std::vector<size_t> order(count);
+        for (size_t i = 0; i < count; i++) {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+
+        double mapInsert, mapLookup, tableInsert, tableLookup;
+        {
+            std::map<std::string, Variable> map;
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < count; i++) {
+                map[keys[i]] = value;
+            }
+            mapInsert = nanosecondsPer(start, count);
+
+            size_t found = 0;
+            start = Clock::now();
+            for (size_t i : order) {
+                found += map.find(keys[i]) != map.end();
+            }
+            mapLookup = nanosecondsPer(start, count);
+            g_sink = found;
+        }
+        {
+            FlameTable table;
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < count; i++) {
+                table.insert(keys[i], value);
+            }
+            tableInsert = nanosecondsPer(start, count);
+
+            size_t found = 0;
+            start = Clock::now();
+            for (size_t i : order) {
+                found += table.find(keys[i]) != nullptr;
+            }
+            tableLookup = nanosecondsPer(start, count);
+            g_sink = found;
+        }
+
+        std::printf("%10zu %12.0f / %-8.0f %12.0f / %-8.0f\n", count, mapInsert, mapLookup, tableInsert, tableLookup);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxKeys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+
+    std::printf("%10s %23s %23s\n", "keys", "std::map insert/lookup", "FlameTable insert/lookup");
+    for (size_t count : {size_t(1000), size_t(100000), size_t(10000000)}) {
+        if (count <= maxKeys) {
+            run(count);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,176 @@
+// Each StringKernels operation against the standard-library code it replaced.
+//
+// Build and run from the repository root:
+//   g++ -std=c++17 -O2 -I. bench/string_kernels_bench.cpp string_kernels.cpp -o string_kernels_bench
+//   ./string_kernels_bench
+//   FLARE_STRING_KERNELS=sse2 ./string_kernels_bench    (or scalar, to compare the kernel sets)
+//
+// Before timing, every kernel is checked against its std version on random input.
+
+#include "string_kernels.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Keeps the compiler from dropping work whose result is unused
+    volatile size_t g_sink;
+
+    // Best time of a few rounds, in nanoseconds per call
+    template <typename Func>
+    double timeCall(Func func) {
+        size_t iterations = 1;
+        for (;;) {
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < iterations; i++) {
+                g_sink = func();
+            }
+            std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+            if (elapsed.count() > 2e7) {
+                break;
+            }
+            iterations *= 2;
+        }
+        double best = 1e300;
+        for (int round = 0; round < 5; round++) {
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < iterations; i++) {
+                g_sink = func();
+            }
+            std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+            best = std::min(best, elapsed.count() / iterations);
+        }
+        return best;
+    }
+
+    void report(const char* name, double kernel, double reference, const char* referenceName) {
+        std::printf("%-32s %10.0f ns   %10.0f ns %s\n", name, kernel, reference, referenceName);
+    }
+
+    std::string stdTrim(const std::string& text) {
+        size_t start = 0;
+        while (start < text.size() && std::isspace(static_cast<unsigned char>(text[start]))) {
+            start++;
+        }
+        size_t end = text.size();
+        while (end > start && std::isspace(static_cast<unsigned char>(text[end - 1]))) {
+            end--;
+        }
+        return text.substr(start, end - start);
+    }
+
+    std::vector<std::string> stdSplit(const std::string& text, char delimiter) {
+        std::vector<std::string> parts;
+        std::stringstream stream(text);
+        std::string part;
+        while (std::getline(stream, part, delimiter)) {
+            parts.push_back(part);
+        }
+        // getline drops the empty piece after a trailing delimiter
+        if (text.empty() || text.back() == delimiter) {
+            parts.push_back("");
+        }
+        return parts;
+    }
+
+    std::string stdReplaceAll(std::string text, const std::string& from, const std::string& to) {
+        for (size_t pos = text.find(from); pos != std::string::npos; pos = text.find(from, pos + to.size())) {
+            text.replace(pos, from.size(), to);
+        }
+        return text;
+    }
+
+    // Random text over a small alphabet so needles and delimiters turn up often
+    std::string randomText(std::mt19937& random, size_t length, const char* alphabet) {
+        std::string text;
+        size_t alphabetSize = std::char_traits<char>::length(alphabet);
+        for (size_t i = 0; i < length; i++) {
+            text += alphabet[random() % alphabetSize];
+        }
+        return text;
+    }
+
+    bool checkAgainstStd() {
+        std::mt19937 random(7);
+        for (int round = 0; round < 20000; round++) {
+            std::string text = randomText(random, random() % 200, "ab ,\t\n");
+            std::string needle = randomText(random, 1 + random() % 3, "ab ,");
+            std::string to = randomText(random, random() % 4, "xy");
+
+            if (StringKernels::find(text, needle) != text.find(needle) ||
+                StringKernels::findAnyOf(text, needle) != text.find_first_of(needle) ||
+                std::string(StringKernels::trim(text)) != stdTrim(text) ||
+                StringKernels::replaceAll(text, needle, to) != stdReplaceAll(text, needle, to)) {
+                std::printf("mismatch on \"%s\" with \"%s\"\n", text.c_str(), needle.c_str());
+                return false;
+            }
+            std::vector<std::string_view> parts;
+            StringKernels::split(text, ',', parts);
+            if (std::vector<std::string>(parts.begin(), parts.end()) != stdSplit(text, ',')) {
+                std::printf("split mismatch on \"%s\"\n", text.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main() {
+    if (!checkAgainstStd()) {
+        return 1;
+    }
+    std::printf("kernels: %s\n\n", StringKernels::getImplementationName());
+    std::printf("%-32s %13s   %13s\n", "", "kernel", "reference");
+
+    // find where the needle's first byte is common, so memchr-based search stops often
+    std::string common(4096, 'a');
+    common.replace(common.size() - 4, 4, "aaab");
+    report("find, common first byte, 4 KB",
+           timeCall([&] { return StringKernels::find(common, "aaab"); }),
+           timeCall([&] { return common.find("aaab"); }), "std::string::find");
+
+    std::string rare(4096, 'x');
+    rare.replace(rare.size() - 4, 4, "abcd");
+    report("find, rare first byte, 4 KB",
+           timeCall([&] { return StringKernels::find(rare, "abcd"); }),
+           timeCall([&] { return rare.find("abcd"); }), "std::string::find");
+
+    std::string padded = std::string(200, ' ') + "word" + std::string(200, '\t');
+    report("trim 400 B of padding",
+           timeCall([&] { return StringKernels::trim(padded).size(); }),
+           timeCall([&] { return stdTrim(padded).size(); }), "isspace loop");
+
+    std::mt19937 random(1);
+    std::string fields = randomText(random, 4096, "abcdefgh,");
+    report("split 4 KB",
+           timeCall([&] {
+               std::vector<std::string_view> parts;
+               StringKernels::split(fields, ',', parts);
+               return parts.size();
+           }),
+           timeCall([&] { return stdSplit(fields, ',').size(); }), "stringstream");
+
+    std::string text = randomText(random, 65536, "abcdefgh ");
+    report("replaceAll 64 KB, shrinking",
+           timeCall([&] { return StringKernels::replaceAll(text, "ab", "x").size(); }),
+           timeCall([&] { return stdReplaceAll(text, "ab", "x").size(); }), "replace in place");
+
+    std::vector<std::string_view> from = {"ab", "cd", "ef"};
+    std::vector<std::string_view> to = {"1", "22", "333"};
+    report("3-pair replace 64 KB",
+           timeCall([&] { return StringKernels::replaceAll(text, from, to).size(); }),
+           timeCall([&] {
+               std::string result = stdReplaceAll(text, "ab", "1");
+               result = stdReplaceAll(result, "cd", "22");
+               return stdReplaceAll(result, "ef", "333").size();
+           }), "three passes");
+    return 0;
+}
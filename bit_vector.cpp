@@ -0,0 +1,438 @@
+#include "bit_vector.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FLARE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    struct Kernels {
+        const char* name;
+        void (*bitwiseAnd)(const uint64_t* a, const uint64_t* b, uint64_t* out, size_t n);
+        void (*bitwiseOr)(const uint64_t* a, const uint64_t* b, uint64_t* out, size_t n);
+        void (*bitwiseXor)(const uint64_t* a, const uint64_t* b, uint64_t* out, size_t n);
+        void (*invert)(const uint64_t* a, uint64_t* out, size_t n);
+        size_t (*popcount)(const uint64_t* a, size_t n);
+    };
+
+    // Scalar kernels
+
+    void andScalar(const uint64_t* a, const uint64_t* b, uint64_t* out, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = a[i] & b[i];
+        }
+    }
+
+    void orScalar(const uint64_t* a, const uint64_t* b, uint64_t* out, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = a[i] | b[i];
+        }
+    }
+
+    void xorScalar(const uint64_t* a, const uint64_t* b, uint64_t* out, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = a[i] ^ b[i];
+        }
+    }
+
+    void invertScalar(const uint64_t* a, uint64_t* out, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = ~a[i];
+        }
+    }
+
+    size_t popcountWord(uint64_t word) {
+        // Bit counts of pairs, then nibbles, then bytes, summed by one multiply
+        word = word - ((word >> 1) & 0x5555555555555555ULL);
+        word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+        word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        return static_cast<size_t>((word * 0x0101010101010101ULL) >> 56);
+    }
+
+    size_t popcountScalar(const uint64_t* a, size_t n) {
+        size_t count = 0;
+        for (size_t i = 0; i < n; i++) {
+            count += popcountWord(a[i]);
+        }
+        return count;
+    }
+
+    const Kernels kScalarKernels = {
+        "scalar", andScalar, orScalar, xorScalar, invertScalar, popcountScalar
+    };
+
+#ifdef FLARE_X86_KERNELS
+#define FLARE_TARGET_AVX2 __attribute__((target("avx2")))
+
+    struct AndBlock {
+        FLARE_TARGET_AVX2 __m256i operator()(__m256i x, __m256i y) const { return _mm256_and_si256(x, y); }
+    };
+    struct OrBlock {
+        FLARE_TARGET_AVX2 __m256i operator()(__m256i x, __m256i y) const { return _mm256_or_si256(x, y); }
+    };
+    struct XorBlock {
+        FLARE_TARGET_AVX2 __m256i operator()(__m256i x, __m256i y) const { return _mm256_xor_si256(x, y); }
+    };
+
+    // Combines whole blocks of four words and returns how many words it covered
+    template <typename Combine>
+    FLARE_TARGET_AVX2 inline size_t bitwiseAvx2(const uint64_t* a, const uint64_t* b, uint64_t* out, size_t n,
+                                                Combine combine) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 4));
+            __m256i y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i y1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 4));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), combine(x0, y0));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 4), combine(x1, y1));
+        }
+        for (; i + 4 <= n; i += 4) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), combine(x, y));
+        }
+        return i;
+    }
+
+    FLARE_TARGET_AVX2 void andAvx2(const uint64_t* a, const uint64_t* b, uint64_t* out, size_t n) {
+        size_t i = bitwiseAvx2(a, b, out, n, AndBlock());
+        andScalar(a + i, b + i, out + i, n - i);
+    }
+
+    FLARE_TARGET_AVX2 void orAvx2(const uint64_t* a, const uint64_t* b, uint64_t* out, size_t n) {
+        size_t i = bitwiseAvx2(a, b, out, n, OrBlock());
+        orScalar(a + i, b + i, out + i, n - i);
+    }
+
+    FLARE_TARGET_AVX2 void xorAvx2(const uint64_t* a, const uint64_t* b, uint64_t* out, size_t n) {
+        size_t i = bitwiseAvx2(a, b, out, n, XorBlock());
+        xorScalar(a + i, b + i, out + i, n - i);
+    }
+
+    FLARE_TARGET_AVX2 void invertAvx2(const uint64_t* a, uint64_t* out, size_t n) {
+        const __m256i ones = _mm256_set1_epi64x(-1);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_xor_si256(x, ones));
+        }
+        invertScalar(a + i, out + i, n - i);
+    }
+
+    FLARE_TARGET_AVX2 size_t popcountAvx2(const uint64_t* a, size_t n) {
+        // Each byte's count is two lookups of 4-bit counts; psadbw sums them into the
+        // four 64-bit lanes every 8 words, before the byte counters could overflow
+        const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                               0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i lowNibbles = _mm256_set1_epi8(0x0F);
+        __m256i total = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 4));
+            __m256i counts = _mm256_add_epi8(
+                _mm256_add_epi8(_mm256_shuffle_epi8(table, _mm256_and_si256(x0, lowNibbles)),
+                                _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(x0, 4), lowNibbles))),
+                _mm256_add_epi8(_mm256_shuffle_epi8(table, _mm256_and_si256(x1, lowNibbles)),
+                                _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(x1, 4), lowNibbles))));
+            total = _mm256_add_epi64(total, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+        }
+        size_t count = static_cast<size_t>(_mm256_extract_epi64(total, 0)) +
+                       static_cast<size_t>(_mm256_extract_epi64(total, 1)) +
+                       static_cast<size_t>(_mm256_extract_epi64(total, 2)) +
+                       static_cast<size_t>(_mm256_extract_epi64(total, 3));
+        return count + popcountScalar(a + i, n - i);
+    }
+
+    const Kernels kAvx2Kernels = {
+        "avx2", andAvx2, orAvx2, xorAvx2, invertAvx2, popcountAvx2
+    };
+#endif
+
+    const Kernels& selectKernels() {
+        // FLARE_BIT_KERNELS=scalar caps the choice, for comparing implementations
+        const char* cap = std::getenv("FLARE_BIT_KERNELS");
+        if (cap != nullptr && std::string_view(cap) == "scalar") {
+            return kScalarKernels;
+        }
+#ifdef FLARE_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return kAvx2Kernels;
+        }
+#endif
+        return kScalarKernels;
+    }
+
+    const Kernels& kernels() {
+        static const Kernels& selected = selectKernels();
+        return selected;
+    }
+
+    int digitValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+}
+
+BitVector::BitVector() : m_width(0), m_word(0) {
+}
+
+BitVector::BitVector(size_t width, uint64_t value) : m_width(width), m_word(0) {
+    if (width > 64) {
+        m_words = std::make_shared<std::vector<uint64_t>>(wordCount(), 0);
+        (*m_words)[0] = value;
+    } else {
+        m_word = value;
+        clearUnusedBits();
+    }
+}
+
+BitVector BitVector::zeros(size_t width) {
+    return BitVector(width, 0);
+}
+
+bool BitVector::parse(const std::string& text, size_t width, BitVector& result) {
+    std::string_view digits = text;
+    bool negative = !digits.empty() && digits.front() == '-';
+    if (negative) {
+        digits.remove_prefix(1);
+    }
+
+    // Hex and binary digits are laid into the words from the last one, so they may run
+    // to any width
+    unsigned bitsPerDigit = 0;
+    if (digits.size() > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+        bitsPerDigit = 4;
+    } else if (digits.size() > 2 && digits[0] == '0' && (digits[1] == 'b' || digits[1] == 'B')) {
+        bitsPerDigit = 1;
+    }
+
+    BitVector value = zeros(width);
+    if (bitsPerDigit != 0) {
+        digits.remove_prefix(2);
+        uint64_t* words = value.mutableWords();
+        size_t bit = 0;
+        for (size_t i = digits.size(); i-- > 0;) {
+            int digit = digitValue(digits[i]);
+            if (digit < 0 || static_cast<unsigned>(digit) >= (1u << bitsPerDigit)) {
+                return false;
+            }
+            for (unsigned b = 0; b < bitsPerDigit && bit < width; b++, bit++) {
+                if ((digit >> b) & 1) {
+                    words[bit / 64] |= uint64_t(1) << (bit % 64);
+                }
+            }
+        }
+    } else {
+        if (digits.empty()) {
+            return false;
+        }
+        uint64_t number = 0;
+        for (char c : digits) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            number = number * 10 + static_cast<uint64_t>(c - '0');
+        }
+        value = BitVector(width, number);
+    }
+
+    // -x is ~x + 1, as two's complement at the width
+    result = negative ? add(value.inverted(), BitVector(width, 1)) : value;
+    return true;
+}
+
+uint64_t BitVector::toUint64() const {
+    return m_width == 0 ? 0 : words()[0];
+}
+
+bool BitVector::isZero() const {
+    const uint64_t* bits = words();
+    return std::all_of(bits, bits + wordCount(), [](uint64_t word) { return word == 0; });
+}
+
+bool BitVector::operator==(const BitVector& other) const {
+    return m_width == other.m_width && std::equal(words(), words() + wordCount(), other.words());
+}
+
+bool BitVector::getBit(size_t index) const {
+    return (words()[index / 64] >> (index % 64)) & 1;
+}
+
+void BitVector::setBit(size_t index, bool value) {
+    uint64_t* bits = mutableWords();
+    uint64_t mask = uint64_t(1) << (index % 64);
+    bits[index / 64] = value ? bits[index / 64] | mask : bits[index / 64] & ~mask;
+}
+
+BitVector BitVector::resized(size_t width) const {
+    if (width == m_width) {
+        return *this;
+    }
+    BitVector result = zeros(width);
+    uint64_t* bits = result.mutableWords();
+    std::copy(words(), words() + std::min(wordCount(), result.wordCount()), bits);
+    result.clearUnusedBits();
+    return result;
+}
+
+size_t BitVector::popcount() const {
+    return kernels().popcount(words(), wordCount());
+}
+
+BitVector BitVector::bitwise(Op op, const BitVector& a, const BitVector& b) {
+    const BitVector& wide = a.m_width >= b.m_width ? a : b;
+    const BitVector& narrow = a.m_width >= b.m_width ? b : a;
+    BitVector result = zeros(wide.m_width);
+    uint64_t* out = result.mutableWords();
+
+    // Past the narrow operand's words its zero extension leaves and clearing, and or
+    // and xor copying the wide operand
+    size_t common = narrow.wordCount();
+    const Kernels& active = kernels();
+    auto kernel = op == Op::And ? active.bitwiseAnd : op == Op::Or ? active.bitwiseOr : active.bitwiseXor;
+    kernel(wide.words(), narrow.words(), out, common);
+    if (op != Op::And) {
+        std::copy(wide.words() + common, wide.words() + wide.wordCount(), out + common);
+    }
+    return result;
+}
+
+BitVector BitVector::bitwiseAnd(const BitVector& a, const BitVector& b) {
+    return bitwise(Op::And, a, b);
+}
+
+BitVector BitVector::bitwiseOr(const BitVector& a, const BitVector& b) {
+    return bitwise(Op::Or, a, b);
+}
+
+BitVector BitVector::bitwiseXor(const BitVector& a, const BitVector& b) {
+    return bitwise(Op::Xor, a, b);
+}
+
+BitVector BitVector::inverted() const {
+    BitVector result = zeros(m_width);
+    kernels().invert(words(), result.mutableWords(), wordCount());
+    result.clearUnusedBits();
+    return result;
+}
+
+BitVector BitVector::shiftedLeft(size_t count) const {
+    BitVector result = zeros(m_width);
+    if (count >= m_width) {
+        return result;
+    }
+    const uint64_t* in = words();
+    uint64_t* out = result.mutableWords();
+    size_t wordShift = count / 64;
+    unsigned bitShift = count % 64;
+    for (size_t i = wordCount(); i-- > wordShift;) {
+        uint64_t word = in[i - wordShift] << bitShift;
+        if (bitShift != 0 && i > wordShift) {
+            word |= in[i - wordShift - 1] >> (64 - bitShift);
+        }
+        out[i] = word;
+    }
+    result.clearUnusedBits();
+    return result;
+}
+
+BitVector BitVector::shiftedRight(size_t count) const {
+    BitVector result = zeros(m_width);
+    if (count >= m_width) {
+        return result;
+    }
+    const uint64_t* in = words();
+    uint64_t* out = result.mutableWords();
+    size_t words = wordCount();
+    size_t wordShift = count / 64;
+    unsigned bitShift = count % 64;
+    for (size_t i = 0; i + wordShift < words; i++) {
+        uint64_t word = in[i + wordShift] >> bitShift;
+        if (bitShift != 0 && i + wordShift + 1 < words) {
+            word |= in[i + wordShift + 1] << (64 - bitShift);
+        }
+        out[i] = word;
+    }
+    return result;
+}
+
+BitVector BitVector::add(const BitVector& a, const BitVector& b) {
+    size_t width = std::max(a.m_width, b.m_width);
+    BitVector x = a.resized(width);
+    BitVector y = b.resized(width);
+    BitVector result = zeros(width);
+    const uint64_t* xs = x.words();
+    const uint64_t* ys = y.words();
+    uint64_t* out = result.mutableWords();
+    uint64_t carry = 0;
+    for (size_t i = 0; i < result.wordCount(); i++) {
+        uint64_t sum = xs[i] + ys[i];
+        uint64_t carryOut = sum < xs[i];
+        out[i] = sum + carry;
+        carry = carryOut | (out[i] < sum);
+    }
+    result.clearUnusedBits();
+    return result;
+}
+
+BitVector BitVector::subtract(const BitVector& a, const BitVector& b) {
+    // a - b is a + ~b + 1 at the common width
+    size_t width = std::max(a.m_width, b.m_width);
+    return add(add(a.resized(width), b.resized(width).inverted()), BitVector(width, 1));
+}
+
+bool BitVector::multiply(const BitVector& a, const BitVector& b, BitVector& result) {
+    size_t width = std::max(a.m_width, b.m_width);
+    if (width > 64) {
+        return false;
+    }
+    result = BitVector(width, a.toUint64() * b.toUint64());
+    return true;
+}
+
+std::string BitVector::toString() const {
+    if (m_width <= 64) {
+        return std::to_string(toUint64());
+    }
+
+    static const char kHexDigits[] = "0123456789abcdef";
+    size_t digits = (m_width + 3) / 4;
+    std::string text = "0x";
+    text.reserve(digits + 2);
+    const uint64_t* bits = words();
+    for (size_t i = digits; i-- > 0;) {
+        text += kHexDigits[(bits[i / 16] >> ((i % 16) * 4)) & 0xF];
+    }
+    return text;
+}
+
+const char* BitVector::getImplementationName() {
+    return kernels().name;
+}
+
+uint64_t* BitVector::mutableWords() {
+    if (m_width <= 64) {
+        return &m_word;
+    }
+    if (m_words.use_count() != 1) {
+        m_words = std::make_shared<std::vector<uint64_t>>(*m_words);
+    }
+    return m_words->data();
+}
+
+void BitVector::clearUnusedBits() {
+    unsigned used = m_width % 64;
+    if (m_width == 0) {
+        m_word = 0;
+    } else if (used != 0) {
+        mutableWords()[wordCount() - 1] &= (uint64_t(1) << used) - 1;
+    }
+}
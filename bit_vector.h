@@ -0,0 +1,95 @@
+#ifndef BIT_VECTOR_H
+#define BIT_VECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * A binary value of a fixed number of bits, the payload of bin variables
+ * (bin.16.flags = 0xFFFF). Values up to 64 bits wide live in one inline
+ * word; wider ones are packed bit-vectors whose words are shared between
+ * copies until one of them is changed. Bits above the width are always zero.
+ *
+ * Arithmetic wraps around at the width. Operands of different widths are
+ * zero-extended to the wider one, which is also the width of the result.
+ * The bitwise and popcount kernels over whole words have an AVX2 and a plain
+ * scalar version; the AVX2 one is picked once, the first time any of them
+ * runs, if the CPU has it.
+ */
+class BitVector {
+public:
+    static constexpr size_t kMaxWidth = size_t(1) << 26;
+
+    BitVector();
+
+    // A value of width bits holding the low bits of value
+    BitVector(size_t width, uint64_t value);
+
+    // Parse 0x hex, 0b binary or decimal text into a value of width bits, keeping its
+    // low bits; returns false if text isn't a number
+    static bool parse(const std::string& text, size_t width, BitVector& result);
+
+    size_t width() const { return m_width; }
+
+    // The low 64 bits
+    uint64_t toUint64() const;
+
+    bool isZero() const;
+    bool operator==(const BitVector& other) const;
+
+    // Bit at index, which must be below width()
+    bool getBit(size_t index) const;
+    void setBit(size_t index, bool value);
+
+    // The same value truncated or zero-extended to width bits
+    BitVector resized(size_t width) const;
+
+    // Number of bits set
+    size_t popcount() const;
+
+    static BitVector bitwiseAnd(const BitVector& a, const BitVector& b);
+    static BitVector bitwiseOr(const BitVector& a, const BitVector& b);
+    static BitVector bitwiseXor(const BitVector& a, const BitVector& b);
+    BitVector inverted() const;
+
+    // Logical shifts; bits shifted past either end are dropped
+    BitVector shiftedLeft(size_t count) const;
+    BitVector shiftedRight(size_t count) const;
+
+    // Sums and differences carry across words at any width; products are limited to
+    // 64 bits, and multiply returns false for anything wider
+    static BitVector add(const BitVector& a, const BitVector& b);
+    static BitVector subtract(const BitVector& a, const BitVector& b);
+    static bool multiply(const BitVector& a, const BitVector& b, BitVector& result);
+
+    // Unsigned decimal up to 64 bits, 0x and hex digits padded to the width above
+    std::string toString() const;
+
+    // Name of the kernel set in use: "avx2" or "scalar"
+    static const char* getImplementationName();
+
+private:
+    size_t m_width;
+    uint64_t m_word;                                // The bits of a value up to 64 bits wide
+    std::shared_ptr<std::vector<uint64_t>> m_words; // The bits of a wider one, least significant first
+
+    size_t wordCount() const { return (m_width + 63) / 64; }
+    const uint64_t* words() const { return m_words ? m_words->data() : &m_word; }
+
+    // The words to change, first copied if other values share them
+    uint64_t* mutableWords();
+
+    // Clear the bits of the top word above the width
+    void clearUnusedBits();
+
+    // A zero value of width bits
+    static BitVector zeros(size_t width);
+
+    enum class Op { And, Or, Xor };
+    static BitVector bitwise(Op op, const BitVector& a, const BitVector& b);
+};
+
+#endif // BIT_VECTOR_H
@@ -0,0 +1,146 @@
+#include "buffer_view.h"
+#include "memory_manager.h"
+#include <cstring>
+
+namespace {
+    uint64_t swapBytes(uint64_t bits, size_t size) {
+        uint64_t swapped = 0;
+        for (size_t i = 0; i < size; i++) {
+            swapped = (swapped << 8) | ((bits >> (i * 8)) & 0xFF);
+        }
+        return swapped;
+    }
+
+    // Host byte order, checked once rather than assumed
+    bool isHostBigEndian() {
+        const uint16_t probe = 1;
+        uint8_t first;
+        std::memcpy(&first, &probe, 1);
+        return first == 0;
+    }
+}
+
+BufferView::BufferView() : m_blockId(-1), m_offset(0), m_length(0) {
+}
+
+BufferView::BufferView(const std::shared_ptr<MemoryBlock>& block, size_t offset, size_t length)
+    : m_block(block), m_blockId(block->id), m_offset(offset), m_length(length) {
+}
+
+uint8_t* BufferView::data() const {
+    std::shared_ptr<MemoryBlock> block = m_block.lock();
+    return block ? static_cast<uint8_t*>(block->pointer) + m_offset : nullptr;
+}
+
+uint8_t* BufferView::range(size_t offset, size_t length) const {
+    if (offset > m_length || length > m_length - offset) {
+        return nullptr;
+    }
+    uint8_t* start = data();
+    return start != nullptr ? start + offset : nullptr;
+}
+
+bool BufferView::slice(size_t offset, size_t length, BufferView& result) const {
+    if (offset > m_length || length > m_length - offset) {
+        return false;
+    }
+    result = *this;
+    result.m_offset = m_offset + offset;
+    result.m_length = length;
+    return true;
+}
+
+bool BufferView::parseScalar(std::string_view name, Scalar& type, bool& bigEndian) {
+    bigEndian = false;
+    if (name.size() > 2 && name.substr(name.size() - 2) == "be") {
+        bigEndian = true;
+        name.remove_suffix(2);
+    } else if (name.size() > 2 && name.substr(name.size() - 2) == "le") {
+        name.remove_suffix(2);
+    }
+
+    static const struct {
+        const char* name;
+        Scalar type;
+    } kScalars[] = {
+        {"u8", Scalar::U8}, {"u16", Scalar::U16}, {"u32", Scalar::U32}, {"u64", Scalar::U64},
+        {"i8", Scalar::I8}, {"i16", Scalar::I16}, {"i32", Scalar::I32}, {"i64", Scalar::I64},
+        {"f32", Scalar::F32}, {"f64", Scalar::F64},
+    };
+    for (const auto& scalar : kScalars) {
+        if (name == scalar.name) {
+            type = scalar.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t BufferView::getScalarSize(Scalar type) {
+    switch (type) {
+        case Scalar::U8: case Scalar::I8: return 1;
+        case Scalar::U16: case Scalar::I16: return 2;
+        case Scalar::U32: case Scalar::I32: case Scalar::F32: return 4;
+        default: return 8;
+    }
+}
+
+bool BufferView::load(Scalar type, bool bigEndian, size_t offset, uint64_t& bits) const {
+    size_t size = getScalarSize(type);
+    const uint8_t* start = range(offset, size);
+    if (start == nullptr) {
+        return false;
+    }
+
+    // The element's bytes land in the low end of bits on a little-endian host
+    static const bool hostBigEndian = isHostBigEndian();
+    bits = 0;
+    if (hostBigEndian) {
+        std::memcpy(reinterpret_cast<uint8_t*>(&bits) + sizeof(bits) - size, start, size);
+    } else {
+        std::memcpy(&bits, start, size);
+    }
+    if (bigEndian != hostBigEndian) {
+        bits = swapBytes(bits, size);
+    }
+    return true;
+}
+
+bool BufferView::store(Scalar type, bool bigEndian, size_t offset, uint64_t bits) const {
+    size_t size = getScalarSize(type);
+    uint8_t* start = range(offset, size);
+    if (start == nullptr) {
+        return false;
+    }
+
+    static const bool hostBigEndian = isHostBigEndian();
+    if (bigEndian != hostBigEndian) {
+        bits = swapBytes(bits, size);
+    }
+    if (hostBigEndian) {
+        std::memcpy(start, reinterpret_cast<const uint8_t*>(&bits) + sizeof(bits) - size, size);
+    } else {
+        std::memcpy(start, &bits, size);
+    }
+    return true;
+}
+
+bool BufferView::fill(uint8_t byte, size_t offset, size_t length) const {
+    uint8_t* start = range(offset, length);
+    if (start == nullptr) {
+        return false;
+    }
+    std::memset(start, byte, length);
+    return true;
+}
+
+bool BufferView::copy(const BufferView& destination, size_t destinationOffset, const BufferView& source,
+                      size_t sourceOffset, size_t length) {
+    uint8_t* to = destination.range(destinationOffset, length);
+    const uint8_t* from = source.range(sourceOffset, length);
+    if (to == nullptr || from == nullptr) {
+        return false;
+    }
+    std::memmove(to, from, length);
+    return true;
+}
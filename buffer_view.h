@@ -0,0 +1,68 @@
+#ifndef BUFFER_VIEW_H
+#define BUFFER_VIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+struct MemoryBlock;
+
+/**
+ * A window of bytes in a mem or virmem block, the payload of buf variables
+ * (buf.header = view(1, 0, 64)). Copying a view copies no bytes, and the
+ * bytes can be passed to library calls as they are.
+ *
+ * A view does not keep its block alive. Once frmem frees the block, every
+ * access through the view fails instead of touching freed memory. Each
+ * access is checked against the window, and loads and stores go through
+ * memcpy, so offsets need no particular alignment.
+ */
+class BufferView {
+public:
+    // Element types of typed loads and stores
+    enum class Scalar { U8, U16, U32, U64, I8, I16, I32, I64, F32, F64 };
+
+    BufferView();
+
+    // Bytes [offset, offset + length) of block, which the caller has checked lie inside it
+    BufferView(const std::shared_ptr<MemoryBlock>& block, size_t offset, size_t length);
+
+    int getBlockId() const { return m_blockId; }
+    size_t getOffset() const { return m_offset; }
+    size_t getLength() const { return m_length; }
+
+    // Start of the window, or nullptr if the block has been freed
+    uint8_t* data() const;
+
+    // Bytes [offset, offset + length) of this window; returns false if they don't fit in it
+    bool slice(size_t offset, size_t length, BufferView& result) const;
+
+    // Parse an element type such as u8, i32, f64 or u32be; little-endian unless it ends in be
+    static bool parseScalar(std::string_view name, Scalar& type, bool& bigEndian);
+    static size_t getScalarSize(Scalar type);
+
+    // Read or write one element at offset as raw bits, low bits first; returns false if
+    // it doesn't fit in the window or the block is gone
+    bool load(Scalar type, bool bigEndian, size_t offset, uint64_t& bits) const;
+    bool store(Scalar type, bool bigEndian, size_t offset, uint64_t bits) const;
+
+    // Set length bytes from offset to byte
+    bool fill(uint8_t byte, size_t offset, size_t length) const;
+
+    // Copy length bytes between windows, which may overlap
+    static bool copy(const BufferView& destination, size_t destinationOffset, const BufferView& source,
+                     size_t sourceOffset, size_t length);
+
+private:
+    std::weak_ptr<MemoryBlock> m_block;
+    int m_blockId;
+    size_t m_offset;
+    size_t m_length;
+
+    // Start of bytes [offset, offset + length) of the window, or nullptr if they don't fit
+    // or the block is gone
+    uint8_t* range(size_t offset, size_t length) const;
+};
+
+#endif // BUFFER_VIEW_H
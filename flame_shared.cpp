@@ -0,0 +1,391 @@
+#include "flame_shared.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    constexpr char kSharedMagic[8] = {'F', 'L', 'M', 'S', 'H', 'M', '0', '1'};
+
+    size_t roundUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    void cpuRelax() {
+#if defined(__SSE2__)
+        _mm_pause();
+#endif
+    }
+}
+
+// Segment header; ready is set last so an attaching process never sees a half-built segment
+struct FlameShared::Header {
+    char magic[8];
+    uint64_t slotCount;
+    uint64_t heapBytes;
+    std::atomic<uint64_t> heapUsed;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> bytesUsed;
+    std::atomic<uint32_t> writerLock;
+    std::atomic<uint32_t> ready;
+};
+
+// One table slot; everything but seq is only read between two matching even values of seq
+struct FlameShared::Slot {
+    std::atomic<uint32_t> seq;
+    uint32_t isUsed;
+    uint64_t hash;
+    uint64_t offset;        // Heap offset of type, key and value, stored back to back
+    uint32_t capacity;      // Heap bytes reserved at offset
+    uint32_t keyLength;
+    uint32_t valueLength;
+    uint32_t typeLength;
+    uint64_t expiresAt;     // Wall-clock milliseconds, 0 if the entry never expires
+};
+
+FlameShared::FlameShared()
+    : m_base(nullptr), m_mappedBytes(0), m_writable(false),
+      m_header(nullptr), m_slots(nullptr), m_heap(nullptr) {
+}
+
+FlameShared::~FlameShared() {
+    close();
+}
+
+bool FlameShared::fail(const std::string& message) {
+    m_lastError = message;
+    if (errno != 0) {
+        m_lastError += std::string(" (") + std::strerror(errno) + ")";
+    }
+    return false;
+}
+
+uint64_t FlameShared::hashKey(std::string_view key) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : key) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string FlameShared::segmentName(const std::string& name) {
+    std::string segment = "/flare.";
+    for (char c : name) {
+        segment += (c == '/') ? '_' : c;
+    }
+    return segment;
+}
+
+size_t FlameShared::segmentBytes(size_t slotCount, size_t heapBytes) {
+    return roundUp(sizeof(Header), 64) + slotCount * sizeof(Slot) + heapBytes;
+}
+
+void FlameShared::bindLayout() {
+    char* base = static_cast<char*>(m_base);
+    m_header = reinterpret_cast<Header*>(base);
+    m_slots = reinterpret_cast<Slot*>(base + roundUp(sizeof(Header), 64));
+    m_heap = reinterpret_cast<char*>(m_slots + m_header->slotCount);
+}
+
+bool FlameShared::create(const std::string& name, size_t heapBytes) {
+    close();
+    errno = 0;
+    m_name = name;
+
+    // Roughly one slot per 32 payload bytes, as a power of two
+    size_t slotCount = 64;
+    while (slotCount < heapBytes / 32) {
+        slotCount <<= 1;
+    }
+    size_t totalBytes = segmentBytes(slotCount, heapBytes);
+    std::string segment = segmentName(name);
+
+    int fd = shm_open(segment.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return fail("Cannot create shared memory '" + segment + "'");
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return fail("Cannot inspect shared memory '" + segment + "'");
+    }
+
+    // A segment of another size is replaced; processes attached to it keep the old one
+    bool reuse = static_cast<size_t>(info.st_size) == totalBytes;
+    if (!reuse && info.st_size != 0) {
+        ::close(fd);
+        shm_unlink(segment.c_str());
+        fd = shm_open(segment.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) {
+            return fail("Cannot create shared memory '" + segment + "'");
+        }
+    }
+
+    if (!reuse && ftruncate(fd, static_cast<off_t>(totalBytes)) != 0) {
+        ::close(fd);
+        return fail("Cannot size shared memory '" + segment + "'");
+    }
+
+    m_base = mmap(nullptr, totalBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m_base == MAP_FAILED) {
+        m_base = nullptr;
+        return fail("Cannot map shared memory '" + segment + "'");
+    }
+    m_mappedBytes = totalBytes;
+    m_writable = true;
+
+    Header* header = static_cast<Header*>(m_base);
+    if (reuse && header->ready.load(std::memory_order_acquire) == 1 &&
+        std::memcmp(header->magic, kSharedMagic, sizeof(kSharedMagic)) == 0 &&
+        header->slotCount == slotCount && header->heapBytes == heapBytes) {
+        bindLayout();
+        return true;
+    }
+
+    // Fresh segment: ftruncate zero-filled it, so every slot starts empty
+    std::memcpy(header->magic, kSharedMagic, sizeof(kSharedMagic));
+    header->slotCount = slotCount;
+    header->heapBytes = heapBytes;
+    header->heapUsed.store(0, std::memory_order_relaxed);
+    header->count.store(0, std::memory_order_relaxed);
+    header->bytesUsed.store(0, std::memory_order_relaxed);
+    header->writerLock.store(0, std::memory_order_relaxed);
+    header->ready.store(1, std::memory_order_release);
+
+    bindLayout();
+    return true;
+}
+
+bool FlameShared::attach(const std::string& name) {
+    close();
+    errno = 0;
+    m_name = name;
+    std::string segment = segmentName(name);
+
+    int fd = shm_open(segment.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return fail("Cannot open shared memory '" + segment + "'");
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+        ::close(fd);
+        return fail("Shared memory '" + segment + "' is not a FlameMemory container");
+    }
+
+    m_base = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m_base == MAP_FAILED) {
+        m_base = nullptr;
+        return fail("Cannot map shared memory '" + segment + "'");
+    }
+    m_mappedBytes = info.st_size;
+    m_writable = false;
+
+    const Header* header = static_cast<const Header*>(m_base);
+    if (header->ready.load(std::memory_order_acquire) != 1 ||
+        std::memcmp(header->magic, kSharedMagic, sizeof(kSharedMagic)) != 0 ||
+        segmentBytes(header->slotCount, header->heapBytes) != m_mappedBytes) {
+        close();
+        return fail("Shared memory '" + segment + "' is not a FlameMemory container");
+    }
+
+    bindLayout();
+    return true;
+}
+
+void FlameShared::close() {
+    if (m_base != nullptr) {
+        munmap(m_base, m_mappedBytes);
+    }
+    m_base = nullptr;
+    m_mappedBytes = 0;
+    m_writable = false;
+    m_header = nullptr;
+    m_slots = nullptr;
+    m_heap = nullptr;
+}
+
+bool FlameShared::unlink() {
+    errno = 0;
+    if (shm_unlink(segmentName(m_name).c_str()) != 0) {
+        return fail("Cannot remove shared memory '" + segmentName(m_name) + "'");
+    }
+    return true;
+}
+
+bool FlameShared::insert(std::string_view key, const Variable& value, uint64_t expiresAt) {
+    errno = 0;
+    if (!m_writable) {
+        return fail("FlameMemory '" + m_name + "' is attached read-only");
+    }
+
+    std::string type = value.getTypeString();
+    std::string payload = value.getValueAsString();
+    size_t needed = type.size() + key.size() + payload.size();
+    uint64_t hash = hashKey(key);
+
+    uint32_t unlocked = 0;
+    while (!m_header->writerLock.compare_exchange_weak(unlocked, 1, std::memory_order_acquire)) {
+        unlocked = 0;
+        cpuRelax();
+    }
+
+    // Only one writer gets here, so slots can be read without checking their sequence
+    size_t mask = m_header->slotCount - 1;
+    size_t index = hash & mask;
+    Slot* slot = nullptr;
+    for (size_t probe = 0; probe <= mask; probe++) {
+        Slot& candidate = m_slots[index];
+        if (!candidate.isUsed ||
+            (candidate.hash == hash && candidate.keyLength == key.size() &&
+             std::memcmp(m_heap + candidate.offset + candidate.typeLength, key.data(), key.size()) == 0)) {
+            slot = &candidate;
+            break;
+        }
+        index = (index + 1) & mask;
+    }
+
+    bool isNew = slot == nullptr || !slot->isUsed;
+    if (slot == nullptr || (isNew && (m_header->count.load(std::memory_order_relaxed) + 1) * 8 > m_header->slotCount * 7)) {
+        m_header->writerLock.store(0, std::memory_order_release);
+        return fail("FlameMemory '" + m_name + "' has no free slots");
+    }
+
+    // Reuse the slot's heap space when the new value fits, otherwise take fresh space
+    uint64_t offset = slot->offset;
+    uint32_t capacity = isNew ? 0 : slot->capacity;
+    if (needed > capacity) {
+        size_t reserved = roundUp(needed, 8);
+        uint64_t heapUsed = m_header->heapUsed.load(std::memory_order_relaxed);
+        if (heapUsed + reserved > m_header->heapBytes) {
+            m_header->writerLock.store(0, std::memory_order_release);
+            return fail("FlameMemory '" + m_name + "' is full (" + std::to_string(heapUsed) + " of " +
+                        std::to_string(m_header->heapBytes) + " bytes used)");
+        }
+        offset = heapUsed;
+        capacity = static_cast<uint32_t>(reserved);
+        m_header->heapUsed.store(heapUsed + reserved, std::memory_order_relaxed);
+    }
+
+    size_t oldBytes = isNew ? 0 : slot->keyLength + slot->valueLength;
+
+    uint32_t seq = slot->seq.load(std::memory_order_relaxed);
+    slot->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    char* data = m_heap + offset;
+    std::memcpy(data, type.data(), type.size());
+    std::memcpy(data + type.size(), key.data(), key.size());
+    std::memcpy(data + type.size() + key.size(), payload.data(), payload.size());
+    slot->hash = hash;
+    slot->offset = offset;
+    slot->capacity = capacity;
+    slot->typeLength = static_cast<uint32_t>(type.size());
+    slot->keyLength = static_cast<uint32_t>(key.size());
+    slot->valueLength = static_cast<uint32_t>(payload.size());
+    slot->expiresAt = expiresAt;
+    slot->isUsed = 1;
+
+    slot->seq.store(seq + 2, std::memory_order_release);
+
+    if (isNew) {
+        m_header->count.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_header->bytesUsed.fetch_add(key.size() + payload.size() - oldBytes, std::memory_order_relaxed);
+    m_header->writerLock.store(0, std::memory_order_release);
+    return true;
+}
+
+bool FlameShared::get(std::string_view key, Variable& value, uint64_t now) const {
+    if (m_header == nullptr) {
+        return false;
+    }
+
+    uint64_t hash = hashKey(key);
+    size_t mask = m_header->slotCount - 1;
+    size_t index = hash & mask;
+    std::string type;
+    std::string payload;
+
+    for (size_t probe = 0; probe <= mask; probe++) {
+        const Slot& slot = m_slots[index];
+        bool isUsed;
+        bool matched;
+        uint64_t expiresAt;
+
+        while (true) {
+            uint32_t before = slot.seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                cpuRelax();
+                continue;
+            }
+
+            isUsed = slot.isUsed != 0;
+            expiresAt = slot.expiresAt;
+            uint64_t offset = slot.offset;
+            size_t typeLength = slot.typeLength;
+            size_t keyLength = slot.keyLength;
+            size_t valueLength = slot.valueLength;
+
+            // A torn read can see garbage, so bounds are checked before touching the heap
+            matched = isUsed && slot.hash == hash && keyLength == key.size() &&
+                      offset + typeLength + keyLength + valueLength <= m_header->heapBytes &&
+                      std::memcmp(m_heap + offset + typeLength, key.data(), keyLength) == 0;
+            if (matched) {
+                type.assign(m_heap + offset, typeLength);
+                payload.assign(m_heap + offset + typeLength + keyLength, valueLength);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == before) {
+                break;
+            }
+        }
+
+        if (!isUsed) {
+            return false;
+        }
+        if (matched) {
+            if (expiresAt != 0 && expiresAt <= now) {
+                return false;
+            }
+            value = Variable(type + "." + std::string(key), payload);
+            return true;
+        }
+        index = (index + 1) & mask;
+    }
+
+    return false;
+}
+
+size_t FlameShared::size() const {
+    return m_header == nullptr ? 0 : m_header->count.load(std::memory_order_relaxed);
+}
+
+size_t FlameShared::getBytesUsed() const {
+    return m_header == nullptr ? 0 : m_header->bytesUsed.load(std::memory_order_relaxed);
+}
+
+size_t FlameShared::getByteBudget() const {
+    return m_header == nullptr ? 0 : m_header->heapBytes;
+}
+
+bool FlameShared::isWritable() const {
+    return m_writable;
+}
+
+const std::string& FlameShared::getLastError() const {
+    return m_lastError;
+}
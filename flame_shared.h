@@ -0,0 +1,94 @@
+#ifndef FLAME_SHARED_H
+#define FLAME_SHARED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "variable.h"
+
+/**
+ * FlameMemory container that lives in POSIX shared memory.
+ * One process creates the segment and writes to it; any number of other
+ * processes attach read-only and look entries up in place, so the table
+ * exists once per host no matter how many interpreters read it.
+ * The segment holds a header, an open-addressing slot array and a heap for
+ * keys and values. Every slot carries a sequence counter: the writer makes
+ * it odd while it changes the slot and even again when done, and readers
+ * retry if the counter moved while they read. Readers never take a lock and
+ * never write to the segment. Writers serialize on a spin lock in the header.
+ * Entries can be overwritten but not removed.
+ */
+class FlameShared {
+public:
+    FlameShared();
+    ~FlameShared();
+
+    FlameShared(const FlameShared&) = delete;
+    FlameShared& operator=(const FlameShared&) = delete;
+
+    // Create the segment for writing, or reopen it if it already exists with the same layout
+    bool create(const std::string& name, size_t heapBytes);
+
+    // Map an existing segment read-only
+    bool attach(const std::string& name);
+
+    // Unmap the segment; the segment itself stays until unlink
+    void close();
+
+    // Remove the segment name; processes that still have it mapped keep their mapping
+    bool unlink();
+
+    // Insert or overwrite a value; expiresAt is wall-clock milliseconds, 0 for never
+    bool insert(std::string_view key, const Variable& value, uint64_t expiresAt = 0);
+
+    // Look up a key, filling value; entries past their expiry time count as missing
+    bool get(std::string_view key, Variable& value, uint64_t now) const;
+
+    // Number of entries
+    size_t size() const;
+
+    // Payload bytes (keys and values) currently stored
+    size_t getBytesUsed() const;
+
+    // Heap bytes available for keys and values
+    size_t getByteBudget() const;
+
+    // True if this process may write
+    bool isWritable() const;
+
+    // Description of the last failure
+    const std::string& getLastError() const;
+
+private:
+    struct Header;
+    struct Slot;
+
+    std::string m_name;
+    std::string m_lastError;
+    void* m_base;
+    size_t m_mappedBytes;
+    bool m_writable;
+
+    Header* m_header;
+    Slot* m_slots;
+    char* m_heap;
+
+    // Set the error message and return false
+    bool fail(const std::string& message);
+
+    // Point the header, slot and heap pointers into the mapping
+    void bindLayout();
+
+    // Stable across processes and builds, unlike std::hash
+    static uint64_t hashKey(std::string_view key);
+
+    // Name of the shared memory object for a container
+    static std::string segmentName(const std::string& name);
+
+    // Bytes needed for a segment with the given slot count and heap size
+    static size_t segmentBytes(size_t slotCount, size_t heapBytes);
+};
+
+#endif // FLAME_SHARED_H
@@ -0,0 +1,465 @@
+#include "flame_store.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr char kSnapshotMagic[8] = {'F', 'L', 'M', 'S', 'N', 'A', 'P', '2'};
+    constexpr char kLogMagic[8] = {'F', 'L', 'M', 'L', 'O', 'G', '0', '1'};
+
+    // magic, generation, record count, byte budget, eviction policy
+    constexpr size_t kSnapshotHeaderSize = 40;
+    // magic, generation
+    constexpr size_t kLogHeaderSize = 16;
+
+    // Record layout: crc32, body length, then the body:
+    // op, expiry (wall-clock ms), type length, key length, value length, type, key, value
+    constexpr size_t kRecordPrefixSize = 8;
+    constexpr size_t kRecordFixedBodySize = 1 + 8 + 1 + 4 + 4;
+    constexpr uint8_t kOpWrite = 1;
+    constexpr uint8_t kOpErase = 2;
+
+    // Writes are handed to the kernel once this much is buffered
+    constexpr size_t kFlushThreshold = 64 * 1024;
+
+    // The log is never compacted below this size
+    constexpr size_t kMinCompactBytes = 1024 * 1024;
+
+    struct CrcTable {
+        uint32_t values[256];
+
+        CrcTable() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++) {
+                    crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+                }
+                values[i] = crc;
+            }
+        }
+    };
+
+    uint32_t crc32(const char* data, size_t size) {
+        static const CrcTable table;
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; i++) {
+            crc = table.values[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+        }
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    template <typename T>
+    void appendValue(std::vector<char>& out, T value) {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    T readValue(const char* data) {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    bool writeAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    // Read-only mapping of a whole file, unmapped when it goes out of scope
+    struct MappedFile {
+        const char* data = nullptr;
+        size_t size = 0;
+
+        bool map(int fd) {
+            struct stat info;
+            if (fstat(fd, &info) != 0) {
+                return false;
+            }
+            size = static_cast<size_t>(info.st_size);
+            if (size == 0) {
+                return true;
+            }
+            void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED) {
+                size = 0;
+                return false;
+            }
+            madvise(address, size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(address);
+            return true;
+        }
+
+        ~MappedFile() {
+            if (data != nullptr) {
+                munmap(const_cast<char*>(data), size);
+            }
+        }
+    };
+}
+
+FlameStore::FlameStore()
+    : m_logFd(-1), m_generation(0), m_clockOffset(0), m_storedBudget(0), m_storedPolicy(EvictionPolicy::REJECT),
+      m_snapshotBytes(0), m_logBytes(0) {
+}
+
+FlameStore::~FlameStore() {
+    close();
+}
+
+bool FlameStore::fail(const std::string& message) {
+    m_lastError = message;
+    if (errno != 0) {
+        m_lastError += std::string(" (") + std::strerror(errno) + ")";
+    }
+    return false;
+}
+
+uint64_t FlameStore::wallClockMs() {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+}
+
+bool FlameStore::open(const std::string& path, FlameTable& table, int64_t clockOffset) {
+    close();
+    m_path = path;
+    m_clockOffset = clockOffset;
+    m_generation = 0;
+    m_storedBudget = 0;
+    m_storedPolicy = EvictionPolicy::REJECT;
+    m_snapshotBytes = 0;
+    m_logBytes = 0;
+    errno = 0;
+
+    size_t evictions = table.getEvictions();
+    if (!loadSnapshot(table) || !loadLog(table)) {
+        close();
+        return false;
+    }
+
+    // A budget or policy the snapshot doesn't hold yet, or entries it cost while loading, go to disk now
+    if ((table.getEvictions() != evictions || table.getByteBudget() != m_storedBudget ||
+         table.getEvictionPolicy() != m_storedPolicy) && !compact(table)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool FlameStore::loadSnapshot(FlameTable& table) {
+    int fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            errno = 0;
+            return true;
+        }
+        return fail("Cannot open snapshot '" + m_path + "'");
+    }
+
+    MappedFile file;
+    bool mapped = file.map(fd);
+    ::close(fd);
+    if (!mapped) {
+        return fail("Cannot map snapshot '" + m_path + "'");
+    }
+
+    if (file.size < kSnapshotHeaderSize || std::memcmp(file.data, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0) {
+        return fail("'" + m_path + "' is not a FlameMemory snapshot");
+    }
+
+    m_generation = readValue<uint64_t>(file.data + 8);
+    uint64_t expected = readValue<uint64_t>(file.data + 16);
+    uint64_t policy = readValue<uint64_t>(file.data + 32);
+    if (policy > static_cast<uint64_t>(EvictionPolicy::LFU)) {
+        return fail("Snapshot '" + m_path + "' is corrupted");
+    }
+    m_storedBudget = static_cast<size_t>(readValue<uint64_t>(file.data + 24));
+    m_storedPolicy = static_cast<EvictionPolicy>(policy);
+
+    // A budget declared before opening wins over the stored one
+    if (table.getByteBudget() == 0) {
+        table.setByteBudget(m_storedBudget);
+        table.setEvictionPolicy(m_storedPolicy);
+    }
+    table.reserve(table.size() + expected);
+
+    // Snapshots are renamed into place only once complete, so any damage here is real corruption
+    size_t count = 0;
+    size_t valid = 0;
+    size_t body = file.size - kSnapshotHeaderSize;
+    if (!decodeRecords(file.data + kSnapshotHeaderSize, body, m_path, table, count, valid)) {
+        return false;
+    }
+    if (valid != body || count != expected) {
+        return fail("Snapshot '" + m_path + "' is corrupted");
+    }
+
+    m_snapshotBytes = file.size;
+    return true;
+}
+
+bool FlameStore::loadLog(FlameTable& table) {
+    std::string logPath = m_path + ".log";
+    m_logFd = ::open(logPath.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (m_logFd < 0) {
+        return fail("Cannot open log '" + logPath + "'");
+    }
+
+    MappedFile file;
+    if (!file.map(m_logFd)) {
+        return fail("Cannot map log '" + logPath + "'");
+    }
+
+    // A missing header or an older generation means the snapshot already holds everything
+    if (file.size < kLogHeaderSize || std::memcmp(file.data, kLogMagic, sizeof(kLogMagic)) != 0 ||
+        readValue<uint64_t>(file.data + 8) != m_generation) {
+        return resetLog();
+    }
+
+    size_t count = 0;
+    size_t valid = 0;
+    size_t body = file.size - kLogHeaderSize;
+    if (!decodeRecords(file.data + kLogHeaderSize, body, logPath, table, count, valid)) {
+        return false;
+    }
+    m_logBytes = kLogHeaderSize + valid;
+
+    // Cut off a record that was only partly written
+    if (valid != body && ftruncate(m_logFd, static_cast<off_t>(m_logBytes)) != 0) {
+        return fail("Cannot truncate log '" + logPath + "'");
+    }
+    return true;
+}
+
+bool FlameStore::resetLog() {
+    if (ftruncate(m_logFd, 0) != 0) {
+        return fail("Cannot truncate log '" + m_path + ".log'");
+    }
+
+    std::vector<char> header(kLogMagic, kLogMagic + sizeof(kLogMagic));
+    appendValue<uint64_t>(header, m_generation);
+    if (!writeAll(m_logFd, header.data(), header.size()) || fdatasync(m_logFd) != 0) {
+        return fail("Cannot write log '" + m_path + ".log'");
+    }
+
+    m_buffer.clear();
+    m_logBytes = kLogHeaderSize;
+    return true;
+}
+
+void FlameStore::encodeRecord(std::vector<char>& out, uint8_t op, std::string_view key, std::string_view type,
+                              std::string_view payload, uint64_t expiresAt) const {
+    uint64_t wallExpiry = expiresAt == 0 ? 0 : static_cast<uint64_t>(static_cast<int64_t>(expiresAt) + m_clockOffset);
+
+    size_t start = out.size();
+    appendValue<uint32_t>(out, 0);
+    appendValue<uint32_t>(out, static_cast<uint32_t>(kRecordFixedBodySize + type.size() + key.size() + payload.size()));
+    appendValue<uint8_t>(out, op);
+    appendValue<uint64_t>(out, wallExpiry);
+    appendValue<uint8_t>(out, static_cast<uint8_t>(type.size()));
+    appendValue<uint32_t>(out, static_cast<uint32_t>(key.size()));
+    appendValue<uint32_t>(out, static_cast<uint32_t>(payload.size()));
+    out.insert(out.end(), type.begin(), type.end());
+    out.insert(out.end(), key.begin(), key.end());
+    out.insert(out.end(), payload.begin(), payload.end());
+
+    uint32_t crc = crc32(out.data() + start + kRecordPrefixSize, out.size() - start - kRecordPrefixSize);
+    std::memcpy(out.data() + start, &crc, sizeof(crc));
+}
+
+bool FlameStore::decodeRecords(const char* data, size_t size, const std::string& file, FlameTable& table,
+                               size_t& count, size_t& valid) {
+    uint64_t now = wallClockMs();
+    size_t offset = 0;
+
+    while (size - offset >= kRecordPrefixSize) {
+        const char* record = data + offset;
+        uint32_t crc = readValue<uint32_t>(record);
+        uint32_t length = readValue<uint32_t>(record + 4);
+        if (length < kRecordFixedBodySize || length > size - offset - kRecordPrefixSize) {
+            break;
+        }
+
+        const char* body = record + kRecordPrefixSize;
+        uint8_t op = static_cast<uint8_t>(body[0]);
+        if (crc32(body, length) != crc || (op != kOpWrite && op != kOpErase)) {
+            break;
+        }
+
+        uint64_t wallExpiry = readValue<uint64_t>(body + 1);
+        size_t typeLength = static_cast<uint8_t>(body[9]);
+        size_t keyLength = readValue<uint32_t>(body + 10);
+        size_t valueLength = readValue<uint32_t>(body + 14);
+        if (kRecordFixedBodySize + typeLength + keyLength + valueLength != length) {
+            break;
+        }
+
+        const char* text = body + kRecordFixedBodySize;
+        std::string type(text, typeLength);
+        std::string_view key(text + typeLength, keyLength);
+
+        if (op == kOpErase || (wallExpiry != 0 && wallExpiry <= now)) {
+            // Removed, or the latest write to this key has already run out
+            table.erase(key);
+        } else {
+            // Replaying under the budget evicts as the live table did; a refused write means
+            // the store holds more than the budget allows
+            uint64_t expiresAt = wallExpiry == 0 ? 0 : static_cast<uint64_t>(static_cast<int64_t>(wallExpiry) - m_clockOffset);
+            if (!table.insert(key, Variable(type + "." + std::string(key),
+                                            std::string(text + typeLength + keyLength, valueLength)), expiresAt)) {
+                errno = 0;
+                return fail("'" + std::string(key) + "' in '" + file + "' doesn't fit the " +
+                            std::to_string(table.getByteBudget()) + "-byte budget");
+            }
+        }
+
+        count++;
+        offset += kRecordPrefixSize + length;
+    }
+
+    valid = offset;
+    return true;
+}
+
+bool FlameStore::recordWrite(std::string_view key, const Variable& value, uint64_t expiresAt) {
+    return appendRecord(kOpWrite, key, value.getTypeString(), value.getValueAsString(), expiresAt);
+}
+
+bool FlameStore::recordErase(std::string_view key) {
+    return appendRecord(kOpErase, key, std::string_view(), std::string_view(), 0);
+}
+
+bool FlameStore::appendRecord(uint8_t op, std::string_view key, std::string_view type, std::string_view payload, uint64_t expiresAt) {
+    if (m_logFd < 0) {
+        return fail("FlameMemory store is not open");
+    }
+
+    size_t before = m_buffer.size();
+    encodeRecord(m_buffer, op, key, type, payload, expiresAt);
+    m_logBytes += m_buffer.size() - before;
+
+    if (m_buffer.size() >= kFlushThreshold) {
+        return flush();
+    }
+    return true;
+}
+
+bool FlameStore::flush() {
+    if (m_buffer.empty()) {
+        return true;
+    }
+    errno = 0;
+    if (!writeAll(m_logFd, m_buffer.data(), m_buffer.size())) {
+        return fail("Cannot append to log '" + m_path + ".log'");
+    }
+    m_buffer.clear();
+    return true;
+}
+
+bool FlameStore::sync() {
+    if (m_logFd < 0) {
+        return fail("FlameMemory store is not open");
+    }
+    if (!flush()) {
+        return false;
+    }
+    errno = 0;
+    if (fdatasync(m_logFd) != 0) {
+        return fail("Cannot sync log '" + m_path + ".log'");
+    }
+    return true;
+}
+
+bool FlameStore::needsCompaction() const {
+    return m_logBytes > kMinCompactBytes && m_logBytes > m_snapshotBytes;
+}
+
+bool FlameStore::compact(const FlameTable& table) {
+    if (m_logFd < 0) {
+        return fail("FlameMemory store is not open");
+    }
+    errno = 0;
+
+    std::vector<char> snapshot(kSnapshotMagic, kSnapshotMagic + sizeof(kSnapshotMagic));
+    appendValue<uint64_t>(snapshot, m_generation + 1);
+    appendValue<uint64_t>(snapshot, table.size());
+    appendValue<uint64_t>(snapshot, table.getByteBudget());
+    appendValue<uint64_t>(snapshot, static_cast<uint64_t>(table.getEvictionPolicy()));
+    table.forEach([&](const FlameEntry& entry) {
+        encodeRecord(snapshot, kOpWrite, entry.key, entry.value.getTypeString(), entry.value.getValueAsString(),
+                     entry.expiresAt);
+    });
+
+    // Write the new snapshot beside the old one, then swap it in atomically
+    std::string tempPath = m_path + ".tmp";
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return fail("Cannot create '" + tempPath + "'");
+    }
+    bool written = writeAll(fd, snapshot.data(), snapshot.size()) && fsync(fd) == 0;
+    ::close(fd);
+    if (!written) {
+        std::remove(tempPath.c_str());
+        return fail("Cannot write '" + tempPath + "'");
+    }
+    if (std::rename(tempPath.c_str(), m_path.c_str()) != 0 || !syncDirectory(m_path)) {
+        return fail("Cannot replace snapshot '" + m_path + "'");
+    }
+
+    // From here on the old log is stale; its generation no longer matches if we crash before the reset
+    m_generation++;
+    m_storedBudget = table.getByteBudget();
+    m_storedPolicy = table.getEvictionPolicy();
+    m_snapshotBytes = snapshot.size();
+    return resetLog();
+}
+
+bool FlameStore::syncDirectory(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+void FlameStore::close() {
+    if (m_logFd >= 0) {
+        flush();
+        ::close(m_logFd);
+        m_logFd = -1;
+    }
+    m_buffer.clear();
+}
+
+bool FlameStore::isOpen() const {
+    return m_logFd >= 0;
+}
+
+const std::string& FlameStore::getPath() const {
+    return m_path;
+}
+
+const std::string& FlameStore::getLastError() const {
+    return m_lastError;
+}
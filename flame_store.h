@@ -0,0 +1,114 @@
+#ifndef FLAME_STORE_H
+#define FLAME_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "flame_table.h"
+
+/**
+ * On-disk backing for a FlameMemory container.
+ * A store is two files: a compacted snapshot at the given path and an
+ * append-only log of writes next to it (path + ".log"). Both hold binary,
+ * length-prefixed records with a CRC each, so opening a store maps the files
+ * and copies the records straight into the table without parsing any text.
+ * The log records erasures as well as writes, including entries the table
+ * evicts or lets expire, and the snapshot header holds the table's byte
+ * budget and eviction policy, so a reopened store is the table it was.
+ * A torn record at the end of the log (from a crash mid-write) fails its CRC
+ * and is cut off, which leaves the store at the last complete write.
+ * When the log outgrows the snapshot, compaction writes a new snapshot to a
+ * temporary file and renames it into place before the log is emptied; a
+ * generation number in both headers tells a stale log apart from a live one.
+ */
+class FlameStore {
+public:
+    FlameStore();
+    ~FlameStore();
+
+    FlameStore(const FlameStore&) = delete;
+    FlameStore& operator=(const FlameStore&) = delete;
+
+    // Open (or create) the store at path and load its entries into table.
+    // clockOffset converts table expiry times to wall-clock milliseconds: wall = table + offset.
+    // A table without a byte budget takes the stored budget and policy; otherwise its own
+    // are kept, applied while loading, and written to a new snapshot if they differ.
+    bool open(const std::string& path, FlameTable& table, int64_t clockOffset);
+
+    // Append a write to the log
+    bool recordWrite(std::string_view key, const Variable& value, uint64_t expiresAt);
+
+    // Append the removal of a key to the log, for erased, evicted and expired entries
+    bool recordErase(std::string_view key);
+
+    // Flush buffered writes and wait until they are on disk
+    bool sync();
+
+    // Replace the snapshot with the current contents of table and empty the log
+    bool compact(const FlameTable& table);
+
+    // True once the log is big enough that compacting would pay off
+    bool needsCompaction() const;
+
+    // Flush and close the files
+    void close();
+
+    bool isOpen() const;
+    const std::string& getPath() const;
+
+    // Description of the last failure
+    const std::string& getLastError() const;
+
+private:
+    std::string m_path;
+    std::string m_lastError;
+    int m_logFd;
+    uint64_t m_generation;
+    int64_t m_clockOffset;
+
+    // Byte budget and eviction policy the current snapshot was written with
+    size_t m_storedBudget;
+    EvictionPolicy m_storedPolicy;
+
+    size_t m_snapshotBytes;
+    size_t m_logBytes;              // Bytes in the log, including buffered ones
+    std::vector<char> m_buffer;     // Writes not yet handed to the kernel
+
+    // Set the error message and return false
+    bool fail(const std::string& message);
+
+    // Write the buffer to the log file
+    bool flush();
+
+    // Load the snapshot file; a missing file is an empty store
+    bool loadSnapshot(FlameTable& table);
+
+    // Replay the log, truncating a torn tail; a log from another generation is reset
+    bool loadLog(FlameTable& table);
+
+    // Truncate the log and write a fresh header for the current generation
+    bool resetLog();
+
+    // Encode one record into the write buffer, flushing it once it is big enough
+    bool appendRecord(uint8_t op, std::string_view key, std::string_view type, std::string_view payload, uint64_t expiresAt);
+
+    // Append one encoded record to out; an erase has no type or payload
+    void encodeRecord(std::vector<char>& out, uint8_t op, std::string_view key, std::string_view type,
+                      std::string_view payload, uint64_t expiresAt) const;
+
+    // Apply records from data (the contents of file) to table, setting valid to the length of
+    // the well-formed prefix; fails if a write doesn't fit the table's budget
+    bool decodeRecords(const char* data, size_t size, const std::string& file, FlameTable& table,
+                       size_t& count, size_t& valid);
+
+    // Wall-clock time in milliseconds
+    static uint64_t wallClockMs();
+
+    // fsync the directory holding path so a rename is durable
+    static bool syncDirectory(const std::string& path);
+};
+
+#endif // FLAME_STORE_H
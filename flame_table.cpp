@@ -0,0 +1,485 @@
+#include "flame_table.h"
+#include <functional>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Control byte values; full slots hold seven hash bits (0..127)
+    constexpr int8_t kEmpty = -128;
+    constexpr int8_t kDeleted = -2;
+
+    size_t hashKey(std::string_view key) {
+        return std::hash<std::string_view>{}(key);
+    }
+
+    int8_t controlHash(size_t hash) {
+        return static_cast<int8_t>(hash & 0x7F);
+    }
+}
+
+FlameTable::FlameTable(size_t byteBudget)
+    : m_size(0), m_tombstones(0), m_bytesUsed(0), m_byteBudget(byteBudget),
+      m_policy(EvictionPolicy::REJECT), m_head(npos), m_tail(npos), m_firstBucket(npos),
+      m_hits(0), m_misses(0), m_evictions(0), m_evictionLog(nullptr) {
+}
+
+uint32_t FlameTable::matchGroup(const int8_t* group, int8_t value) {
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupSize; i++) {
+        if (group[i] == value) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+size_t FlameTable::findSlot(std::string_view key, size_t hash) const {
+    size_t capacity = m_control.size();
+    if (capacity == 0) {
+        return npos;
+    }
+
+    size_t groupMask = capacity / kGroupSize - 1;
+    size_t group = (hash >> 7) & groupMask;
+    int8_t h2 = controlHash(hash);
+
+    // Triangular probing over groups visits every group once
+    for (size_t probe = 0; probe <= groupMask; probe++) {
+        const int8_t* ctrl = &m_control[group * kGroupSize];
+
+        uint32_t mask = matchGroup(ctrl, h2);
+        while (mask != 0) {
+            size_t slot = group * kGroupSize + __builtin_ctz(mask);
+            const FlameEntry& entry = m_entries[m_slots[slot]];
+            if (entry.hash == hash && entry.key == key) {
+                return slot;
+            }
+            mask &= mask - 1;
+        }
+
+        // An empty slot ends the probe sequence
+        if (matchGroup(ctrl, kEmpty) != 0) {
+            return npos;
+        }
+
+        group = (group + probe + 1) & groupMask;
+    }
+
+    return npos;
+}
+
+size_t FlameTable::findInsertSlot(size_t hash) const {
+    size_t capacity = m_control.size();
+    size_t groupMask = capacity / kGroupSize - 1;
+    size_t group = (hash >> 7) & groupMask;
+
+    for (size_t probe = 0; probe <= groupMask; probe++) {
+        const int8_t* ctrl = &m_control[group * kGroupSize];
+        uint32_t mask = matchGroup(ctrl, kEmpty) | matchGroup(ctrl, kDeleted);
+        if (mask != 0) {
+            return group * kGroupSize + __builtin_ctz(mask);
+        }
+        group = (group + probe + 1) & groupMask;
+    }
+
+    return npos;
+}
+
+void FlameTable::rehash(size_t capacity) {
+    m_control.assign(capacity, kEmpty);
+    m_slots.assign(capacity, npos);
+    m_tombstones = 0;
+
+    for (uint32_t index = 0; index < m_entries.size(); index++) {
+        if (!m_entries[index].isUsed) {
+            continue;
+        }
+        size_t slot = findInsertSlot(m_entries[index].hash);
+        m_control[slot] = controlHash(m_entries[index].hash);
+        m_slots[slot] = index;
+    }
+}
+
+Variable* FlameTable::find(std::string_view key) {
+    uint32_t index = findIndex(key);
+    return index == npos ? nullptr : &m_entries[index].value;
+}
+
+const Variable* FlameTable::find(std::string_view key) const {
+    uint32_t index = findIndex(key);
+    return index == npos ? nullptr : &m_entries[index].value;
+}
+
+const Variable* FlameTable::get(std::string_view key, uint64_t now) {
+    uint32_t index = findIndex(key);
+    if (index != npos && m_entries[index].expiresAt != 0 && m_entries[index].expiresAt <= now) {
+        eraseIndex(index);
+        index = npos;
+    }
+    if (index == npos) {
+        m_misses++;
+        return nullptr;
+    }
+    m_hits++;
+    touchEntry(index);
+    return &m_entries[index].value;
+}
+
+bool FlameTable::contains(std::string_view key, uint64_t now) const {
+    uint32_t index = findIndex(key);
+    return index != npos && (m_entries[index].expiresAt == 0 || m_entries[index].expiresAt > now);
+}
+
+uint32_t FlameTable::findIndex(std::string_view key) const {
+    size_t slot = findSlot(key, hashKey(key));
+    return slot == npos ? npos : m_slots[slot];
+}
+
+bool FlameTable::insert(std::string_view key, const Variable& value, uint64_t expiresAt) {
+    return insertValue(key, value, expiresAt);
+}
+
+bool FlameTable::insert(std::string_view key, Variable&& value, uint64_t expiresAt) {
+    return insertValue(key, std::move(value), expiresAt);
+}
+
+template <typename Value>
+bool FlameTable::insertValue(std::string_view key, Value&& value, uint64_t expiresAt) {
+    size_t hash = hashKey(key);
+    size_t newBytes = entryBytes(key, value);
+
+    // A value bigger than the whole budget can never fit
+    if (m_byteBudget != 0 && newBytes > m_byteBudget) {
+        return false;
+    }
+
+    // Overwrite an existing entry in place
+    size_t slot = findSlot(key, hash);
+    if (slot != npos) {
+        uint32_t index = m_slots[slot];
+        size_t oldBytes = entryBytes(m_entries[index].key, m_entries[index].value);
+        while (m_byteBudget != 0 && m_bytesUsed - oldBytes + newBytes > m_byteBudget) {
+            if (!evictOne(index)) {
+                return false;
+            }
+        }
+        m_entries[index].value = std::forward<Value>(value);
+        m_entries[index].expiresAt = expiresAt;
+        m_bytesUsed = m_bytesUsed - oldBytes + newBytes;
+        touchEntry(index);
+        return true;
+    }
+
+    while (m_byteBudget != 0 && m_bytesUsed + newBytes > m_byteBudget) {
+        if (!evictOne(npos)) {
+            return false;
+        }
+    }
+
+    // Keep the load (including tombstones) under 7/8
+    size_t capacity = m_control.size();
+    if (capacity == 0 || (m_size + m_tombstones + 1) * 8 > capacity * 7) {
+        size_t newCapacity = capacity == 0 ? kGroupSize : capacity;
+        while ((m_size + 1) * 16 > newCapacity * 7) {
+            newCapacity *= 2;
+        }
+        rehash(newCapacity);
+    }
+
+    uint32_t index;
+    if (!m_freeEntries.empty()) {
+        index = m_freeEntries.back();
+        m_freeEntries.pop_back();
+    } else {
+        index = static_cast<uint32_t>(m_entries.size());
+        m_entries.emplace_back();
+    }
+
+    FlameEntry& entry = m_entries[index];
+    entry.key.assign(key.data(), key.size());
+    entry.value = std::forward<Value>(value);
+    entry.hash = hash;
+    entry.isUsed = true;
+    entry.expiresAt = expiresAt;
+
+    slot = findInsertSlot(hash);
+    if (m_control[slot] == kDeleted) {
+        m_tombstones--;
+    }
+    m_control[slot] = controlHash(hash);
+    m_slots[slot] = index;
+
+    m_size++;
+    m_bytesUsed += newBytes;
+    linkEntry(index);
+    return true;
+}
+
+bool FlameTable::erase(std::string_view key) {
+    uint32_t index = findIndex(key);
+    if (index == npos) {
+        return false;
+    }
+    eraseIndex(index);
+    return true;
+}
+
+bool FlameTable::expire(std::string_view key, uint64_t expiresAt) {
+    uint32_t index = findIndex(key);
+    if (index == npos || expiresAt == 0 || m_entries[index].expiresAt != expiresAt) {
+        return false;
+    }
+    eraseIndex(index);
+    return true;
+}
+
+void FlameTable::eraseIndex(uint32_t index) {
+    FlameEntry& entry = m_entries[index];
+    size_t slot = findSlot(entry.key, entry.hash);
+
+    unlinkEntry(index);
+    m_bytesUsed -= entryBytes(entry.key, entry.value);
+
+    entry.isUsed = false;
+    entry.key.clear();
+    entry.value = Variable();
+    m_freeEntries.push_back(index);
+
+    m_control[slot] = kDeleted;
+    m_slots[slot] = npos;
+    m_tombstones++;
+    m_size--;
+}
+
+bool FlameTable::evictOne(uint32_t keep) {
+    uint32_t victim = npos;
+
+    if (m_policy == EvictionPolicy::LRU) {
+        victim = m_tail;
+        if (victim == keep && victim != npos) {
+            victim = m_entries[victim].prev;
+        }
+    } else if (m_policy == EvictionPolicy::LFU) {
+        // Lowest frequency first, oldest within the bucket
+        for (uint32_t bucket = m_firstBucket; bucket != npos && victim == npos; bucket = m_buckets[bucket].next) {
+            victim = m_buckets[bucket].tail;
+            if (victim == keep) {
+                victim = m_entries[victim].prev;
+            }
+        }
+    }
+
+    if (victim == npos) {
+        return false;
+    }
+
+    if (m_evictionLog != nullptr) {
+        m_evictionLog->push_back(m_entries[victim].key);
+    }
+    eraseIndex(victim);
+    m_evictions++;
+    return true;
+}
+
+void FlameTable::listPushFront(uint32_t& head, uint32_t& tail, uint32_t index) {
+    FlameEntry& entry = m_entries[index];
+    entry.prev = npos;
+    entry.next = head;
+    if (head != npos) {
+        m_entries[head].prev = index;
+    } else {
+        tail = index;
+    }
+    head = index;
+}
+
+void FlameTable::listRemove(uint32_t& head, uint32_t& tail, uint32_t index) {
+    FlameEntry& entry = m_entries[index];
+    if (entry.prev != npos) {
+        m_entries[entry.prev].next = entry.next;
+    } else {
+        head = entry.next;
+    }
+    if (entry.next != npos) {
+        m_entries[entry.next].prev = entry.prev;
+    } else {
+        tail = entry.prev;
+    }
+    entry.prev = npos;
+    entry.next = npos;
+}
+
+uint32_t FlameTable::newBucket(size_t frequency, uint32_t prev, uint32_t next) {
+    uint32_t bucket;
+    if (!m_freeBuckets.empty()) {
+        bucket = m_freeBuckets.back();
+        m_freeBuckets.pop_back();
+    } else {
+        bucket = static_cast<uint32_t>(m_buckets.size());
+        m_buckets.emplace_back();
+    }
+
+    m_buckets[bucket] = {frequency, npos, npos, prev, next};
+    if (prev != npos) {
+        m_buckets[prev].next = bucket;
+    } else {
+        m_firstBucket = bucket;
+    }
+    if (next != npos) {
+        m_buckets[next].prev = bucket;
+    }
+    return bucket;
+}
+
+void FlameTable::freeBucket(uint32_t bucket) {
+    const FrequencyBucket& node = m_buckets[bucket];
+    if (node.prev != npos) {
+        m_buckets[node.prev].next = node.next;
+    } else {
+        m_firstBucket = node.next;
+    }
+    if (node.next != npos) {
+        m_buckets[node.next].prev = node.prev;
+    }
+    m_freeBuckets.push_back(bucket);
+}
+
+void FlameTable::linkEntry(uint32_t index) {
+    if (m_policy == EvictionPolicy::LRU) {
+        listPushFront(m_head, m_tail, index);
+    } else if (m_policy == EvictionPolicy::LFU) {
+        // New entries start in the frequency 1 bucket at the front
+        uint32_t bucket = m_firstBucket;
+        if (bucket == npos || m_buckets[bucket].frequency != 1) {
+            bucket = newBucket(1, npos, m_firstBucket);
+        }
+        m_entries[index].bucket = bucket;
+        listPushFront(m_buckets[bucket].head, m_buckets[bucket].tail, index);
+    }
+}
+
+void FlameTable::unlinkEntry(uint32_t index) {
+    if (m_policy == EvictionPolicy::LRU) {
+        listRemove(m_head, m_tail, index);
+    } else if (m_policy == EvictionPolicy::LFU) {
+        uint32_t bucket = m_entries[index].bucket;
+        listRemove(m_buckets[bucket].head, m_buckets[bucket].tail, index);
+        if (m_buckets[bucket].head == npos) {
+            freeBucket(bucket);
+        }
+    }
+}
+
+void FlameTable::touchEntry(uint32_t index) {
+    if (m_policy == EvictionPolicy::LRU) {
+        listRemove(m_head, m_tail, index);
+        listPushFront(m_head, m_tail, index);
+    } else if (m_policy == EvictionPolicy::LFU) {
+        // Move the entry to the bucket for the next frequency, creating it if needed
+        uint32_t bucket = m_entries[index].bucket;
+        size_t frequency = m_buckets[bucket].frequency;
+        uint32_t next = m_buckets[bucket].next;
+
+        uint32_t target = next;
+        if (next == npos || m_buckets[next].frequency != frequency + 1) {
+            target = newBucket(frequency + 1, bucket, next);
+        }
+
+        listRemove(m_buckets[bucket].head, m_buckets[bucket].tail, index);
+        if (m_buckets[bucket].head == npos) {
+            freeBucket(bucket);
+        }
+
+        m_entries[index].bucket = target;
+        listPushFront(m_buckets[target].head, m_buckets[target].tail, index);
+    }
+}
+
+void FlameTable::rebuildOrder() {
+    m_head = npos;
+    m_tail = npos;
+    m_buckets.clear();
+    m_freeBuckets.clear();
+    m_firstBucket = npos;
+
+    for (uint32_t index = 0; index < m_entries.size(); index++) {
+        if (m_entries[index].isUsed) {
+            linkEntry(index);
+        }
+    }
+}
+
+void FlameTable::clear() {
+    m_control.clear();
+    m_slots.clear();
+    m_entries.clear();
+    m_freeEntries.clear();
+    m_size = 0;
+    m_tombstones = 0;
+    m_bytesUsed = 0;
+    rebuildOrder();
+}
+
+void FlameTable::reserve(size_t count) {
+    size_t capacity = kGroupSize;
+    while (count * 8 > capacity * 7) {
+        capacity *= 2;
+    }
+    if (capacity > m_control.size()) {
+        rehash(capacity);
+    }
+    m_entries.reserve(count);
+}
+
+size_t FlameTable::size() const {
+    return m_size;
+}
+
+size_t FlameTable::getBytesUsed() const {
+    return m_bytesUsed;
+}
+
+size_t FlameTable::getByteBudget() const {
+    return m_byteBudget;
+}
+
+void FlameTable::setByteBudget(size_t byteBudget) {
+    m_byteBudget = byteBudget;
+}
+
+EvictionPolicy FlameTable::getEvictionPolicy() const {
+    return m_policy;
+}
+
+void FlameTable::setEvictionPolicy(EvictionPolicy policy) {
+    m_policy = policy;
+    rebuildOrder();
+}
+
+size_t FlameTable::getHits() const {
+    return m_hits;
+}
+
+size_t FlameTable::getMisses() const {
+    return m_misses;
+}
+
+size_t FlameTable::getEvictions() const {
+    return m_evictions;
+}
+
+void FlameTable::setEvictionLog(std::vector<std::string>* keys) {
+    m_evictionLog = keys;
+}
+
+size_t FlameTable::entryBytes(std::string_view key, const Variable& value) {
+    return key.size() + value.getByteSize();
+}
@@ -0,0 +1,206 @@
+#ifndef FLAME_TABLE_H
+#define FLAME_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "variable.h"
+
+// A key/value pair stored in a FlameTable
+struct FlameEntry {
+    std::string key;
+    Variable value;
+    size_t hash;
+    bool isUsed;
+    uint64_t expiresAt;     // Expiry time in milliseconds, 0 if the entry never expires
+
+    // Links for the eviction order (recency list, or the list inside a frequency bucket)
+    uint32_t prev;
+    uint32_t next;
+    uint32_t bucket;
+};
+
+// What a full FlameTable does when a write doesn't fit
+enum class EvictionPolicy {
+    REJECT,     // Refuse the write
+    LRU,        // Drop the least recently used entries
+    LFU         // Drop the least frequently used entries (oldest first on ties)
+};
+
+/**
+ * Open-addressing hash table used for FlameMemory containers.
+ * Slots are probed sixteen at a time: each slot has a control byte holding
+ * seven bits of the key's hash, and a whole group is compared with a single
+ * SIMD instruction before any key is touched. Entries live in a separate
+ * array and keep their index for as long as they exist.
+ * The table also tracks how many payload bytes (keys and values) it holds;
+ * a write that would go over the byte budget is either refused or makes
+ * room by evicting entries, depending on the eviction policy. Recency and
+ * frequency are kept in intrusive lists so every bookkeeping step is O(1).
+ */
+class FlameTable {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    // A byte budget of 0 means unlimited
+    explicit FlameTable(size_t byteBudget = 0);
+
+    // Look up a key; returns nullptr if it is not present
+    Variable* find(std::string_view key);
+    const Variable* find(std::string_view key) const;
+
+    // Look up a key as a cache access: counts a hit or miss and updates the eviction order.
+    // Entries whose expiry time is at or before now are dropped and count as a miss.
+    const Variable* get(std::string_view key, uint64_t now = 0);
+
+    // Check whether a key is present and not expired at now, without counting an access
+    bool contains(std::string_view key, uint64_t now = 0) const;
+
+    // Get the entry index for a key, or npos
+    uint32_t findIndex(std::string_view key) const;
+
+    // Insert or overwrite a value, evicting entries if the policy allows;
+    // returns false if the value doesn't fit in the budget
+    bool insert(std::string_view key, const Variable& value, uint64_t expiresAt = 0);
+    bool insert(std::string_view key, Variable&& value, uint64_t expiresAt = 0);
+
+    // Remove a key; returns false if it was not present
+    bool erase(std::string_view key);
+
+    // Remove a key if it is still set to expire at the given time; returns true if removed
+    bool expire(std::string_view key, uint64_t expiresAt);
+
+    // Remove everything
+    void clear();
+
+    // Make room for at least count entries without rehashing
+    void reserve(size_t count);
+
+    // Number of stored entries
+    size_t size() const;
+
+    // Payload bytes (keys and values) currently stored
+    size_t getBytesUsed() const;
+
+    // Maximum payload bytes, 0 if unlimited
+    size_t getByteBudget() const;
+    void setByteBudget(size_t byteBudget);
+
+    // Payload bytes a key/value pair takes up
+    static size_t entryBytes(std::string_view key, const Variable& value);
+
+    // Eviction policy used when the budget is reached
+    EvictionPolicy getEvictionPolicy() const;
+    void setEvictionPolicy(EvictionPolicy policy);
+
+    // Cache statistics
+    size_t getHits() const;
+    size_t getMisses() const;
+    size_t getEvictions() const;
+
+    // While set, the key of every entry evicted is appended to keys; nullptr stops this
+    void setEvictionLog(std::vector<std::string>* keys);
+
+    // Call func(entry) for every stored entry
+    template <typename Func>
+    void forEach(Func func) const {
+        for (const auto& entry : m_entries) {
+            if (entry.isUsed) {
+                func(entry);
+            }
+        }
+    }
+
+    // Resume a walk over the entries at cursor (0 to start), calling func(entry) for each;
+    // func returns true for entries it takes, and the walk stops once limit were taken.
+    // Returns the cursor to continue from, or npos when every entry has been visited.
+    // Entries added or removed meanwhile may or may not be seen, but none is visited twice.
+    template <typename Func>
+    uint32_t scan(uint32_t cursor, size_t limit, Func func) const {
+        size_t taken = 0;
+        for (uint32_t index = cursor; index < m_entries.size(); index++) {
+            if (taken == limit) {
+                return index;
+            }
+            if (m_entries[index].isUsed && func(m_entries[index])) {
+                taken++;
+            }
+        }
+        return npos;
+    }
+
+private:
+    static constexpr size_t kGroupSize = 16;
+
+    std::vector<int8_t> m_control;      // One control byte per slot
+    std::vector<uint32_t> m_slots;      // Entry index for each full slot
+    std::vector<FlameEntry> m_entries;  // Entry storage, indices stay stable
+    std::vector<uint32_t> m_freeEntries;
+
+    size_t m_size;
+    size_t m_tombstones;
+    size_t m_bytesUsed;
+    size_t m_byteBudget;
+
+    // Eviction order: one recency list for LRU, a list of frequency buckets for LFU
+    struct FrequencyBucket {
+        size_t frequency;
+        uint32_t head;
+        uint32_t tail;
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    EvictionPolicy m_policy;
+    uint32_t m_head;
+    uint32_t m_tail;
+    std::vector<FrequencyBucket> m_buckets;
+    std::vector<uint32_t> m_freeBuckets;
+    uint32_t m_firstBucket;
+
+    size_t m_hits;
+    size_t m_misses;
+    size_t m_evictions;
+    std::vector<std::string>* m_evictionLog;
+
+    // Find the slot holding a key, or npos
+    size_t findSlot(std::string_view key, size_t hash) const;
+
+    // Find a free slot for a key that is known to be absent
+    size_t findInsertSlot(size_t hash) const;
+
+    // Rebuild the slot arrays with the given capacity
+    void rehash(size_t capacity);
+
+    // Shared by the copying and moving insert
+    template <typename Value>
+    bool insertValue(std::string_view key, Value&& value, uint64_t expiresAt);
+
+    // Remove the entry with the given index
+    void eraseIndex(uint32_t index);
+
+    // Drop one entry according to the policy, never the one given; false if nothing can go
+    bool evictOne(uint32_t keep);
+
+    // Eviction order bookkeeping
+    void linkEntry(uint32_t index);
+    void unlinkEntry(uint32_t index);
+    void touchEntry(uint32_t index);
+    void rebuildOrder();
+
+    // Doubly linked list helpers, used for the recency list and the bucket lists
+    void listPushFront(uint32_t& head, uint32_t& tail, uint32_t index);
+    void listRemove(uint32_t& head, uint32_t& tail, uint32_t index);
+
+    // Frequency bucket helpers (LFU)
+    uint32_t newBucket(size_t frequency, uint32_t prev, uint32_t next);
+    void freeBucket(uint32_t bucket);
+
+    // Bitmask of slots in a group whose control byte equals value
+    static uint32_t matchGroup(const int8_t* group, int8_t value);
+};
+
+#endif // FLAME_TABLE_H
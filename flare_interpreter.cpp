@@ -1,12 +1,25 @@
 #include "flare_interpreter.h"
+#include "value_map.h"
 #include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
 
 FlareInterpreter::FlareInterpreter() 
     : m_version("0.1.0"), 
       m_isDynamicMode(false), 
       m_currentLine(0), 
-      m_isRunning(false) {
+      m_isRunning(false),
+      m_loopExit(LoopExit::None),
+      m_loopDepth(0),
+      m_pendingMemoBudget(0),
+      m_lastFlameMemory(nullptr),
+      m_reclaimedUpTo(0),
+      m_nextExpiryId(1),
+      m_startTime(std::chrono::steady_clock::now()) {
     
     m_memoryManager = std::make_unique<MemoryManager>();
     m_parser = std::make_unique<Parser>();
@@ -76,10 +89,20 @@ bool FlareInterpreter::run() {
 
     // Check for dynamic mode
     processDynamicMode();
+    if (m_isDynamicMode) {
+        analyzeLiveness();
+    }
 
     // Register core variables
     registerCoreVariables();
 
+    // Blocks are matched up once; statements laid out for an earlier script no longer apply
+    buildBlockTable();
+    m_matches.clear();
+    m_loopExit = LoopExit::None;
+    m_loopDepth = 0;
+    m_pendingMemoBudget = 0;
+
     // Process each line
     while (m_isRunning && m_currentLine < m_scriptLines.size()) {
         std::string line = m_scriptLines[m_currentLine];
@@ -87,6 +110,12 @@ bool FlareInterpreter::run() {
             m_errorHandler->reportError("Error executing line " + std::to_string(m_currentLine + 1));
             return false;
         }
+        if (m_expiryWheel.size() > 0) {
+            expireTimers();
+        }
+        if (m_isDynamicMode) {
+            reclaimDeadValues();
+        }
         m_currentLine++;
     }
 
@@ -102,6 +131,10 @@ void FlareInterpreter::addBuiltInFunction(const std::string& name,
     m_builtInFunctions[name] = func;
 }
 
+void FlareInterpreter::resetScratch() {
+    m_scratch.reset();
+}
+
 void FlareInterpreter::setupBuiltInFunctions() {
     // Add the arch() function
     addBuiltInFunction("arch", [this](const std::vector<Variable>& args) -> Variable {
@@ -136,8 +169,9 @@ bool FlareInterpreter::processIfStatement(const std::string& line) {
     std::string trimmedLine = m_utils->trim(line);
     
     size_t openParen = trimmedLine.find('(');
-    size_t closeParen = trimmedLine.find(')');
     size_t openBrace = trimmedLine.find('{');
+    // The condition runs to the last ')' before the brace, so it may contain calls
+    size_t closeParen = trimmedLine.rfind(')', openBrace);
     
     if (openParen != std::string::npos && closeParen != std::string::npos && 
         openBrace != std::string::npos && openParen < closeParen && closeParen < openBrace) {
@@ -149,47 +183,8 @@ bool FlareInterpreter::processIfStatement(const std::string& line) {
         bool conditionMet = evaluateCondition(condition);
         
         // Find the end of the if block
-        int braceCount = 1;
         size_t ifBlockStart = m_currentLine + 1;
-        size_t ifBlockEnd = ifBlockStart;
-        
-        while (ifBlockEnd < m_scriptLines.size() && braceCount > 0) {
-            std::string blockLine = m_scriptLines[ifBlockEnd];
-            
-            // Check for braces in the line, but handle them more carefully
-            // to avoid counting braces in strings or comments
-            for (size_t i = 0; i < blockLine.length(); i++) {
-                char c = blockLine[i];
-                
-                // Skip comments
-                if (c == '#') {
-                    break;
-                }
-                
-                // Skip string literals
-                if (c == '"') {
-                    i++;
-                    while (i < blockLine.length() && blockLine[i] != '"') {
-                        if (blockLine[i] == '\\' && i + 1 < blockLine.length()) {
-                            i++; // Skip escape character
-                        }
-                        i++;
-                    }
-                    continue;
-                }
-                
-                // Count braces
-                if (c == '{') braceCount++;
-                if (c == '}') braceCount--;
-                if (braceCount == 0) break;
-            }
-            
-            ifBlockEnd++;
-            
-            if (braceCount == 0) {
-                break;
-            }
-        }
+        size_t ifBlockEnd = findBlockEnd(m_currentLine) + 1;
         
         // Check if there's an else block after this
         bool hasElseBlock = false;
@@ -200,56 +195,15 @@ bool FlareInterpreter::processIfStatement(const std::string& line) {
             std::string nextLine = m_utils->trim(m_scriptLines[elseBlockStart]);
             if (nextLine == "else" || nextLine == "else {") {
                 hasElseBlock = true;
-                braceCount = 1;
                 elseBlockStart++;
-                elseBlockEnd = elseBlockStart;
-                
-                while (elseBlockEnd < m_scriptLines.size() && braceCount > 0) {
-                    std::string blockLine = m_scriptLines[elseBlockEnd];
-                    
-                    // Check for braces in the line, but handle them more carefully
-                    // to avoid counting braces in strings or comments
-                    for (size_t i = 0; i < blockLine.length(); i++) {
-                        char c = blockLine[i];
-                        
-                        // Skip comments
-                        if (c == '#') {
-                            break;
-                        }
-                        
-                        // Skip string literals
-                        if (c == '"') {
-                            i++;
-                            while (i < blockLine.length() && blockLine[i] != '"') {
-                                if (blockLine[i] == '\\' && i + 1 < blockLine.length()) {
-                                    i++; // Skip escape character
-                                }
-                                i++;
-                            }
-                            continue;
-                        }
-                        
-                        // Count braces
-                        if (c == '{') braceCount++;
-                        if (c == '}') braceCount--;
-                        if (braceCount == 0) break;
-                    }
-                    
-                    elseBlockEnd++;
-                    
-                    if (braceCount == 0) {
-                        break;
-                    }
-                }
+                elseBlockEnd = findBlockEnd(elseBlockStart - 1) + 1;
             }
         }
         
         if (conditionMet) {
             // Execute the if block
-            for (size_t i = ifBlockStart; i < ifBlockEnd - 1; i++) {
-                processLine(m_scriptLines[i]);
-                if (!m_isRunning) return false;
-            }
+            executeLines(ifBlockStart, ifBlockEnd - 1);
+            if (!m_isRunning) return false;
             
             // Skip the else block if it exists
             if (hasElseBlock) {
@@ -261,10 +215,8 @@ bool FlareInterpreter::processIfStatement(const std::string& line) {
             // Skip the if block
             if (hasElseBlock) {
                 // Execute the else block
-                for (size_t i = elseBlockStart; i < elseBlockEnd - 1; i++) {
-                    processLine(m_scriptLines[i]);
-                    if (!m_isRunning) return false;
-                }
+                executeLines(elseBlockStart, elseBlockEnd - 1);
+                if (!m_isRunning) return false;
                 m_currentLine = elseBlockEnd - 1;
             } else {
                 m_currentLine = ifBlockEnd - 1;
@@ -279,6 +231,17 @@ bool FlareInterpreter::processIfStatement(const std::string& line) {
 
 // Evaluate a condition expression
 bool FlareInterpreter::evaluateCondition(const std::string& condition) {
+    // A lone call such as matchAny(...) or text.contains(...) is evaluated for its result
+    if (m_parser->isCallExpression(condition)) {
+        Variable result = evaluateExpression(m_utils->trim(condition));
+        if (result.isBoolean()) {
+            return result.getBoolValue();
+        } else if (result.isInteger()) {
+            return result.getIntValue() != 0;
+        }
+        return !result.getValueAsString().empty();
+    }
+    
     // Check for inequality (!=)
     size_t neqPos = condition.find("!=");
     if (neqPos != std::string::npos) {
@@ -389,6 +352,8 @@ bool FlareInterpreter::evaluateCondition(const std::string& condition) {
         return condVar.getBoolValue();
     } else if (condVar.isInteger()) {
         return condVar.getIntValue() != 0;
+    } else if (condVar.isBinary()) {
+        return !condVar.getBinaryValue()->isZero();
     } else if (condVar.isString()) {
         return !condVar.getStringValue().empty();
     }
@@ -426,28 +391,37 @@ Variable FlareInterpreter::getVariable(const std::string& name) {
         }
     }
     
-    // Check if it's a string literal (enclosed in quotes)
-    if (name.size() >= 2 && name.front() == '"' && name.back() == '"') {
+    // Check if it's a string literal (enclosed in quotes, not "a" + "b")
+    if (name.size() >= 2 && name.front() == '"' && name.find('"', 1) == name.size() - 1) {
         return Variable("str.literal", name.substr(1, name.size() - 2));
     }
     
-    // Check local variables if in a function call
-    if (!m_localVariables.empty()) {
-        auto& locals = m_localVariables.top();
-        if (locals.find(name) != locals.end()) {
-            return locals[name];
-        }
+    // Check local variables if in a function call, then global variables
+    if (const Variable* found = findVariable(name)) {
+        return *found;
     }
     
-    // Check global variables
-    if (m_globalVariables.find(name) != m_globalVariables.end()) {
-        return m_globalVariables[name];
+    // data[i] and data[start:end]
+    if (m_parser->isIndexExpression(name)) {
+        return evaluateIndex(name);
     }
     
     // If not found, create a default variable
     return Variable("str.undefined", "");
 }
 
+Variable* FlareInterpreter::findVariable(const std::string& name) {
+    if (!m_localVariables.empty()) {
+        auto& locals = m_localVariables.top();
+        auto found = locals.find(name);
+        if (found != locals.end()) {
+            return &found->second;
+        }
+    }
+    auto found = m_globalVariables.find(name);
+    return found != m_globalVariables.end() ? &found->second : nullptr;
+}
+
 // Set a variable value in the current scope
 void FlareInterpreter::setVariable(const std::string& name, const Variable& value) {
     if (!m_localVariables.empty()) {
@@ -459,6 +433,21 @@ void FlareInterpreter::setVariable(const std::string& name, const Variable& valu
     }
 }
 
+std::string FlareInterpreter::previewValue(const Variable& value) const {
+    const size_t maxItems = 16;
+    size_t items = value.isList() ? value.getListLength() : 0;
+    if (items <= maxItems) {
+        return value.getValueAsString();
+    }
+    
+    std::string text = "[";
+    for (size_t i = 0; i < maxItems; i++) {
+        text += value.getListItem(i).getValueAsString();
+        text += ", ";
+    }
+    return text + "... (" + std::to_string(items) + " items)]";
+}
+
 // Process for loops
 bool FlareInterpreter::processForLoop(const std::string& line) {
     std::string trimmedLine = m_utils->trim(line);
@@ -467,9 +456,14 @@ bool FlareInterpreter::processForLoop(const std::string& line) {
         return false;
     }
     
+    // for i = 0 to 10 has no parentheses around its header
+    if (trimmedLine.find(" to ") != std::string::npos && m_utils->trim(trimmedLine.substr(4)).front() != '(') {
+        return processRangeLoop(trimmedLine);
+    }
+    
     size_t openParen = trimmedLine.find('(');
-    size_t closeParen = trimmedLine.find(')');
     size_t openBrace = trimmedLine.find('{');
+    size_t closeParen = trimmedLine.rfind(')', openBrace);
     
     if (openParen == std::string::npos || closeParen == std::string::npos || 
         openBrace == std::string::npos || openParen >= closeParen || closeParen >= openBrace) {
@@ -504,21 +498,8 @@ bool FlareInterpreter::processForLoop(const std::string& line) {
     std::string increment = forParts[2];
     
     // Find the body of the for loop
-    int braceCount = 1;
     size_t loopBodyStart = m_currentLine + 1;
-    size_t loopBodyEnd = loopBodyStart;
-    
-    while (loopBodyEnd < m_scriptLines.size() && braceCount > 0) {
-        std::string blockLine = m_scriptLines[loopBodyEnd];
-        
-        for (char c : blockLine) {
-            if (c == '{') braceCount++;
-            if (c == '}') braceCount--;
-            if (braceCount == 0) break;
-        }
-        
-        loopBodyEnd++;
-    }
+    size_t loopBodyEnd = findBlockEnd(m_currentLine) + 1;
     
     // Execute the loop
     // First, process the initialization (usually a variable assignment)
@@ -539,12 +520,16 @@ bool FlareInterpreter::processForLoop(const std::string& line) {
     }
     
     // Now run the loop as long as the condition is true
+    m_loopDepth++;
     while (evaluateCondition(condition)) {
-        // Execute the loop body
-        for (size_t i = loopBodyStart; i < loopBodyEnd - 1; i++) {
-            processLine(m_scriptLines[i]);
-            if (!m_isRunning) return false;
+        // Execute the loop body; continue goes on to the increment
+        executeLines(loopBodyStart, loopBodyEnd - 1);
+        if (!m_isRunning) return false;
+        if (m_loopExit == LoopExit::Break) {
+            m_loopExit = LoopExit::None;
+            break;
         }
+        m_loopExit = LoopExit::None;
         
         // Process the increment
         if (!increment.empty()) {
@@ -588,6 +573,7 @@ bool FlareInterpreter::processForLoop(const std::string& line) {
             }
         }
     }
+    m_loopDepth--;
     
     // Skip past the end of the loop in the main execution
     m_currentLine = loopBodyEnd - 1;
@@ -638,7 +624,6 @@ bool FlareInterpreter::processFunction(const std::string& line) {
     }
     
     // Find the function body
-    int braceCount = 1;
     size_t openBrace = trimmedLine.find('{');
     
     if (openBrace == std::string::npos) {
@@ -647,66 +632,42 @@ bool FlareInterpreter::processFunction(const std::string& line) {
     }
     
     size_t bodyStart = m_currentLine + 1;
-    size_t bodyEnd = bodyStart;
-    
-    while (bodyEnd < m_scriptLines.size() && braceCount > 0) {
-        std::string bodyLine = m_scriptLines[bodyEnd];
-        
-        // Check for braces in the line, but handle them more carefully
-        // to avoid counting braces in strings or comments
-        for (size_t i = 0; i < bodyLine.length(); i++) {
-            char c = bodyLine[i];
-            
-            // Skip comments
-            if (c == '#') {
-                break;
-            }
-            
-            // Skip string literals
-            if (c == '"') {
-                i++;
-                while (i < bodyLine.length() && bodyLine[i] != '"') {
-                    if (bodyLine[i] == '\\' && i + 1 < bodyLine.length()) {
-                        i++; // Skip escape character
-                    }
-                    i++;
-                }
-                continue;
-            }
-            
-            // Count braces
-            if (c == '{') braceCount++;
-            if (c == '}') braceCount--;
-            if (braceCount == 0) break;
-        }
-        
-        bodyEnd++;
-        
-        if (braceCount == 0) {
-            break;
-        }
-    }
+    size_t bodyEnd = std::min(findBlockEnd(m_currentLine) + 1, m_scriptLines.size());
     
     // Store the function
     FunctionDefinition func;
     func.name = functionName;
     func.parameters = parameters;
+    func.bodyStart = bodyStart;
     
     // Store the function body, excluding the closing brace
     for (size_t i = bodyStart; i < bodyEnd; i++) {
         func.body.push_back(m_scriptLines[i]);
     }
     
+    // An @memo function caches its results, which is only sound if it has no side effects
+    size_t memoBudget = m_pendingMemoBudget;
+    m_pendingMemoBudget = 0;
+    if (memoBudget > 0) {
+        std::string problem;
+        if (!checkPureFunction(func, problem)) {
+            m_errorHandler->reportError("@memo function '" + functionName + "' " + problem);
+            return false;
+        }
+        func.memo = std::make_shared<FlameTable>(memoBudget);
+        func.memo->setEvictionPolicy(EvictionPolicy::LRU);
+    }
+    
     m_userFunctions[functionName] = func;
     
     // Skip the function body in normal execution
-    m_currentLine = bodyEnd;
+    m_currentLine = bodyEnd - 1;
     
     return true;
 }
 
 // Process function call
-bool FlareInterpreter::processFunctionCall(const std::string& name, const std::vector<std::string>& args) {
+bool FlareInterpreter::processFunctionCall(const std::string& name, const ArgList& args) {
     // Check if the function exists
     if (m_userFunctions.find(name) == m_userFunctions.end()) {
         m_errorHandler->reportError("Function '" + name + "' not defined");
@@ -730,11 +691,15 @@ bool FlareInterpreter::processFunctionCall(const std::string& name, const std::v
         std::string paramName = func.parameters[i];
         std::string argValue = args[i];
         
-        // Check if the argument is a variable first
+        // Check if the argument is a variable first, then whether it's an expression such as n - 1
         Variable argVar = getVariable(argValue);
-        if (argVar.getTypeString() != "str.undefined") {
-            // It's a variable, use its value and type
-            localVars[paramName] = argVar;
+        if (argVar.getTypeAndName() == "str.undefined" && (m_parser->isCallExpression(argValue) ||
+                m_parser->findOperator(argValue, "+-*/") != std::string::npos)) {
+            argVar = evaluateExpression(argValue);
+        }
+        if (argVar.getTypeAndName() != "str.undefined") {
+            // It's a variable, use its value and type; the payload is shared, not copied
+            localVars[paramName] = std::move(argVar);
         } else {
             // Remove quotes if present
             if (argValue.size() >= 2 && argValue.front() == '"' && argValue.back() == '"') {
@@ -771,14 +736,44 @@ bool FlareInterpreter::processFunctionCall(const std::string& name, const std::v
         }
     }
     
+    // An @memo function's result for the same argument values is reused
+    if (func.memo) {
+        std::string key;
+        for (const auto& parameter : func.parameters) {
+            const Variable& value = localVars[parameter];
+            key += value.getTypeString();
+            key += ':';
+            key += value.getValueAsString();
+            key += '\x1f';
+        }
+        if (const Variable* cached = func.memo->get(key)) {
+            m_globalVariables["__return_value"] = *cached;
+            return true;
+        }
+        if (!executeFunctionBody(func, std::move(localVars))) {
+            return false;
+        }
+        func.memo->insert(key, m_globalVariables["__return_value"]);
+        return true;
+    }
+    
+    return executeFunctionBody(func, std::move(localVars));
+}
+
+bool FlareInterpreter::executeFunctionBody(const FunctionDefinition& func, std::map<std::string, Variable> localVars) {
     // Save current line position to return after function execution
     m_callStack.push(m_currentLine);
     
+    // Loops of the caller can't be left from inside the function
+    size_t callerLoopDepth = m_loopDepth;
+    m_loopDepth = 0;
+    
     // Set up the new local scope
-    m_localVariables.push(localVars);
+    m_localVariables.push(std::move(localVars));
     
-    // Execute the function body
-    for (const std::string& line : func.body) {
+    // Execute the function body; a block inside it moves past its own lines
+    for (size_t bodyLine = 0; bodyLine < func.body.size(); bodyLine++) {
+        const std::string& line = func.body[bodyLine];
         // Check for return statement
         std::string trimmedLine = m_utils->trim(line);
         if (trimmedLine.find("return ") == 0) {
@@ -805,6 +800,7 @@ bool FlareInterpreter::processFunctionCall(const std::string& name, const std::v
                     // Restore the previous line position
                     m_currentLine = m_callStack.top();
                     m_callStack.pop();
+                    m_loopDepth = callerLoopDepth;
                     
                     // Store the return value in a special variable that can be accessed later
                     m_globalVariables["__return_value"] = returnValue;
@@ -828,6 +824,7 @@ bool FlareInterpreter::processFunctionCall(const std::string& name, const std::v
                 // Restore the previous line position
                 m_currentLine = m_callStack.top();
                 m_callStack.pop();
+                m_loopDepth = callerLoopDepth;
                 
                 // Store the return value in a special variable that can be accessed later
                 m_globalVariables["__return_value"] = returnValue;
@@ -849,6 +846,7 @@ bool FlareInterpreter::processFunctionCall(const std::string& name, const std::v
             // Restore the previous line position
             m_currentLine = m_callStack.top();
             m_callStack.pop();
+            m_loopDepth = callerLoopDepth;
             
             // Store the return value in a special variable that can be accessed later
             m_globalVariables["__return_value"] = returnValue;
@@ -869,7 +867,9 @@ bool FlareInterpreter::processFunctionCall(const std::string& name, const std::v
         }
         
         // Process regular function body line
+        m_currentLine = func.bodyStart + bodyLine;
         processLine(line);
+        bodyLine = m_currentLine - func.bodyStart;
         
         // Check if we need to stop execution
         if (!m_isRunning) {
@@ -877,6 +877,7 @@ bool FlareInterpreter::processFunctionCall(const std::string& name, const std::v
             m_localVariables.pop();
             m_currentLine = m_callStack.top();
             m_callStack.pop();
+            m_loopDepth = callerLoopDepth;
             return false;
         }
     }
@@ -887,6 +888,7 @@ bool FlareInterpreter::processFunctionCall(const std::string& name, const std::v
     // Restore the previous line position
     m_currentLine = m_callStack.top();
     m_callStack.pop();
+    m_loopDepth = callerLoopDepth;
     
     // Return void (0) as default
     m_globalVariables["__return_value"] = Variable("int.__return_value", "0");
@@ -896,14 +898,114 @@ bool FlareInterpreter::processFunctionCall(const std::string& name, const std::v
 
 // Evaluate an expression to get its value
 Variable FlareInterpreter::evaluateExpression(const std::string& expr) {
+    // Builtin calls take their arguments verbatim, operators included, so they're
+    // dispatched before anything tries to split the expression. A script's own function
+    // wins over a builtin of the same name; user calls are made further down.
+    if (m_parser->isCallExpression(expr) &&
+        m_userFunctions.find(expr.substr(0, expr.find('('))) == m_userFunctions.end()) {
+        size_t openParen = expr.find('(');
+        std::string funcName = expr.substr(0, openParen);
+        size_t dotPos = funcName.rfind('.');
+        std::string methodName = dotPos != std::string::npos ? funcName.substr(dotPos + 1) : "";
+        
+        // regex(pattern), regex(pattern).method(text) and pattern.method(text), where pattern
+        // is a string variable; fmem.match and fmem.search belong to FlameMemory
+        if (funcName == "regex") {
+            return evaluateRegex(expr);
+        }
+        if ((methodName == "match" || methodName == "search" || methodName == "findAll") &&
+            funcName.compare(0, 5, "fmem.") != 0) {
+            const Variable* receiver = findVariable(funcName.substr(0, dotPos));
+            if (receiver != nullptr && receiver->isString()) {
+                return evaluateRegex(expr);
+            }
+        }
+        
+        // The rest are single calls whose arguments run to the final ')'
+        bool singleCall = m_parser->findClosingParen(expr, openParen) == expr.size() - 1;
+        std::string argsStr = expr.substr(openParen + 1, expr.size() - openParen - 2);
+        if (singleCall && (funcName == "matchAny" || funcName == "matchAll" || funcName == "matchHits")) {
+            return evaluatePatternMatch(funcName, argsStr);
+        }
+        if (singleCall && (funcName == "indexOf" || funcName == "trim" || funcName == "split" || funcName == "replaceAll")) {
+            return evaluateStringBuiltin(funcName, argsStr);
+        }
+        if (singleCall && (funcName == "dot" || funcName == "axpy" || funcName == "gemv" || funcName == "gemm" ||
+                           funcName == "fill")) {
+            return evaluateLinearAlgebra(funcName, argsStr);
+        }
+        if (singleCall && (funcName == "predict" || funcName == "classify")) {
+            return evaluateModel(funcName, argsStr);
+        }
+        if (singleCall && funcName == "len") {
+            return evaluateLength(argsStr);
+        }
+        if (singleCall && (funcName == "has" || funcName == "keys" || funcName == "values")) {
+            return evaluateMapBuiltin(funcName, argsStr);
+        }
+        if (singleCall && (funcName == "popcount" || funcName == "shl" || funcName == "shr" || funcName == "not" ||
+                           funcName == "bit" || funcName == "setbit" || funcName == "width")) {
+            return evaluateBinaryBuiltin(funcName, argsStr);
+        }
+        if (singleCall && (funcName == "view" || funcName == "load")) {
+            return evaluateBufferBuiltin(funcName, argsStr);
+        }
+        
+        // FlameMemory commands called for their result, such as fmem.read("data", "key")
+        if (singleCall && funcName.find("fmem.") == 0) {
+            if (!processFlameMemory(funcName, m_parser->parseParenthesizedArgs(argsStr, &m_scratch))) {
+                return Variable("str.undefined", "");
+            }
+            return m_globalVariables["__return_value"];
+        }
+        
+        // Statistics of an @memo function's cache, such as memo.stats(fib, "hits")
+        if (singleCall && funcName.find("memo.") == 0) {
+            if (!processMemo(funcName, m_parser->parseParenthesizedArgs(argsStr, &m_scratch))) {
+                return Variable("str.undefined", "");
+            }
+            return m_globalVariables["__return_value"];
+        }
+        
+        // Handle string.contains() method
+        if (singleCall && methodName == "contains") {
+            Variable obj = getVariable(funcName.substr(0, dotPos));
+            
+            if (obj.isString()) {
+                argsStr = m_utils->trim(argsStr);
+                
+                // The argument is a literal or a variable; an unknown bare word is taken as text
+                Variable argVar = getVariable(argsStr);
+                std::string searchStr = argVar.getTypeAndName() != "str.undefined" ? argVar.getValueAsString() : argsStr;
+                
+                // Check if the string contains the search string
+                bool contains = StringKernels::find(obj.getStringValue(), searchStr) != StringKernels::npos;
+                return Variable("act.result", contains ? "true" : "false");
+            }
+        }
+    }
+    
     // First check if it's a simple variable name
     Variable var = getVariable(expr);
-    if (!var.getTypeString().empty() && var.getTypeString() != "str.undefined") {
+    if (var.getTypeAndName() != "str.undefined") {
         return var;
     }
     
-    // Check for arithmetic operations
-    size_t plusPos = expr.find('+');
+    // Bitwise operators bind more loosely than arithmetic: | below ^ below &
+    for (char op : {'|', '^', '&'}) {
+        size_t opPos = m_parser->findOperator(expr, std::string_view(&op, 1));
+        if (opPos != std::string::npos) {
+            Variable leftVal = evaluateExpression(m_utils->trim(expr.substr(0, opPos)));
+            Variable rightVal = evaluateExpression(m_utils->trim(expr.substr(opPos + 1)));
+            return evaluateBinaryOperator(op, leftVal, rightVal);
+        }
+    }
+    
+    // Check for arithmetic operations. Operators of one precedence level group from the
+    // left, so the expression splits at the last + or - and then at the last * or /
+    size_t addPos = m_parser->findOperator(expr, "+-");
+    size_t mulLevelPos = m_parser->findOperator(expr, "*/");
+    size_t plusPos = addPos != std::string::npos && expr[addPos] == '+' ? addPos : std::string::npos;
     if (plusPos != std::string::npos) {
         std::string leftExpr = m_utils->trim(expr.substr(0, plusPos));
         std::string rightExpr = m_utils->trim(expr.substr(plusPos + 1));
@@ -911,7 +1013,9 @@ Variable FlareInterpreter::evaluateExpression(const std::string& expr) {
         Variable leftVal = evaluateExpression(leftExpr);
         Variable rightVal = evaluateExpression(rightExpr);
         
-        if (leftVal.isInteger() && rightVal.isInteger()) {
+        if (leftVal.isBinary() || rightVal.isBinary()) {
+            return evaluateBinaryOperator('+', leftVal, rightVal);
+        } else if (leftVal.isInteger() && rightVal.isInteger()) {
             int result = leftVal.getIntValue() + rightVal.getIntValue();
             return Variable("int.result", std::to_string(result));
         } else if (leftVal.isFloat() && rightVal.isFloat()) {
@@ -919,21 +1023,24 @@ Variable FlareInterpreter::evaluateExpression(const std::string& expr) {
             return Variable("fl.result", std::to_string(result));
         } else if (leftVal.isString() || rightVal.isString()) {
             // String concatenation
-            std::string result = leftVal.getValueAsString() + rightVal.getValueAsString();
-            return Variable("str.result", result);
+            Variable result("str.result", leftVal);
+            result.appendString(rightVal.isString() ? rightVal.getStringValue() : rightVal.getValueAsString());
+            return result;
         }
     }
     
     // Subtraction
-    size_t minusPos = expr.find('-');
-    if (minusPos != std::string::npos && minusPos > 0) { // Skip if it's a negative number
+    size_t minusPos = addPos != std::string::npos && expr[addPos] == '-' ? addPos : std::string::npos;
+    if (minusPos != std::string::npos) {
         std::string leftExpr = m_utils->trim(expr.substr(0, minusPos));
         std::string rightExpr = m_utils->trim(expr.substr(minusPos + 1));
         
         Variable leftVal = evaluateExpression(leftExpr);
         Variable rightVal = evaluateExpression(rightExpr);
         
-        if (leftVal.isInteger() && rightVal.isInteger()) {
+        if (leftVal.isBinary() || rightVal.isBinary()) {
+            return evaluateBinaryOperator('-', leftVal, rightVal);
+        } else if (leftVal.isInteger() && rightVal.isInteger()) {
             int result = leftVal.getIntValue() - rightVal.getIntValue();
             return Variable("int.result", std::to_string(result));
         } else if (leftVal.isFloat() && rightVal.isFloat()) {
@@ -943,7 +1050,7 @@ Variable FlareInterpreter::evaluateExpression(const std::string& expr) {
     }
     
     // Multiplication
-    size_t mulPos = expr.find('*');
+    size_t mulPos = mulLevelPos != std::string::npos && expr[mulLevelPos] == '*' ? mulLevelPos : std::string::npos;
     if (mulPos != std::string::npos) {
         std::string leftExpr = m_utils->trim(expr.substr(0, mulPos));
         std::string rightExpr = m_utils->trim(expr.substr(mulPos + 1));
@@ -951,7 +1058,9 @@ Variable FlareInterpreter::evaluateExpression(const std::string& expr) {
         Variable leftVal = evaluateExpression(leftExpr);
         Variable rightVal = evaluateExpression(rightExpr);
         
-        if (leftVal.isInteger() && rightVal.isInteger()) {
+        if (leftVal.isBinary() || rightVal.isBinary()) {
+            return evaluateBinaryOperator('*', leftVal, rightVal);
+        } else if (leftVal.isInteger() && rightVal.isInteger()) {
             int result = leftVal.getIntValue() * rightVal.getIntValue();
             return Variable("int.result", std::to_string(result));
         } else if (leftVal.isFloat() && rightVal.isFloat()) {
@@ -961,7 +1070,7 @@ Variable FlareInterpreter::evaluateExpression(const std::string& expr) {
     }
     
     // Division
-    size_t divPos = expr.find('/');
+    size_t divPos = mulLevelPos != std::string::npos && expr[mulLevelPos] == '/' ? mulLevelPos : std::string::npos;
     if (divPos != std::string::npos) {
         std::string leftExpr = m_utils->trim(expr.substr(0, divPos));
         std::string rightExpr = m_utils->trim(expr.substr(divPos + 1));
@@ -997,7 +1106,7 @@ Variable FlareInterpreter::evaluateExpression(const std::string& expr) {
         std::string argsStr = expr.substr(openParen + 1, closeParen - openParen - 1);
         
         // Parse arguments
-        std::vector<std::string> args;
+        ArgList args(&m_scratch);
         if (!argsStr.empty()) {
             size_t start = 0;
             size_t end = argsStr.find(',');
@@ -1024,21 +1133,6 @@ Variable FlareInterpreter::evaluateExpression(const std::string& expr) {
             std::cout << "DEBUG: First arg value = '" << args[0] << "'" << std::endl;
         }
         
-        // Force a value for factorial function calls for testing
-        if (funcName == "factorial") {
-            if (args.size() > 0 && args[0] == "5") {
-                return Variable("int.result", "120");
-            } else if (args.size() > 0 && args[0] == "4") {
-                return Variable("int.result", "24");
-            } else if (args.size() > 0 && args[0] == "3") {
-                return Variable("int.result", "6");
-            } else if (args.size() > 0 && args[0] == "2") {
-                return Variable("int.result", "2");
-            } else if (args.size() > 0 && args[0] == "1" || args[0] == "0") {
-                return Variable("int.result", "1");
-            }
-        }
-        
         // Check if the return value exists
         if (m_globalVariables.find("__return_value") != m_globalVariables.end()) {
             Variable returnVal = m_globalVariables["__return_value"];
@@ -1051,249 +1145,2536 @@ Variable FlareInterpreter::evaluateExpression(const std::string& expr) {
         }
     }
     
-    // Check for method calls (like string.contains())
-    size_t dotPos = expr.find('.');
-    if (dotPos != std::string::npos) {
-        size_t openParen = expr.find('(', dotPos);
-        size_t closeParen = expr.find(')', openParen);
-        
-        if (openParen != std::string::npos && closeParen != std::string::npos) {
-            std::string objName = m_utils->trim(expr.substr(0, dotPos));
-            std::string methodName = m_utils->trim(expr.substr(dotPos + 1, openParen - dotPos - 1));
-            
-            // Handle string.contains() method
-            if (methodName == "contains") {
-                Variable obj = getVariable(objName);
-                
-                if (obj.isString()) {
-                    std::string argsStr = expr.substr(openParen + 1, closeParen - openParen - 1);
-                    std::string searchStr;
-                    
-                    // If the argument is a variable, get its value
-                    Variable argVar = getVariable(argsStr);
-                    if (argVar.getTypeString() != "str.undefined") {
-                        searchStr = argVar.getStringValue();
-                    } else {
-                        // Otherwise, it's a literal
-                        if (argsStr.size() >= 2 && argsStr.front() == '"' && argsStr.back() == '"') {
-                            searchStr = argsStr.substr(1, argsStr.size() - 2);
-                        } else {
-                            searchStr = argsStr;
-                        }
-                    }
-                    
-                    // Check if the string contains the search string
-                    bool contains = obj.getStringValue().find(searchStr) != std::string::npos;
-                    return Variable("act.result", contains ? "true" : "false");
-                }
-            }
-        }
-    }
-    
     // If no operations were performed, return the original expression as a string
     return Variable("str.literal", expr);
 }
 
-// Process while loop
-bool FlareInterpreter::processWhileLoop(const std::string& line) {
-    std::string trimmedLine = m_utils->trim(line);
-    
-    if (trimmedLine.find("while ") != 0) {
-        return false;
+Variable FlareInterpreter::evaluatePatternMatch(const std::string& funcName, const std::string& argsStr) {
+    ArgList args = m_parser->parseParenthesizedArgs(argsStr, &m_scratch);
+    if (args.size() != 2) {
+        m_errorHandler->reportError(funcName + " requires text and pattern list arguments");
+        return Variable("act.result", "false");
     }
     
-    size_t openParen = trimmedLine.find('(');
-    size_t closeParen = trimmedLine.find(')');
-    size_t openBrace = trimmedLine.find('{');
-    
-    if (openParen == std::string::npos || closeParen == std::string::npos || 
-        openBrace == std::string::npos || openParen >= closeParen || closeParen >= openBrace) {
-        m_errorHandler->reportError("Invalid while loop syntax");
-        return false;
+    // The text is a string literal or the name of a variable holding it
+    std::string text = args[0];
+    if (text.size() >= 2 && text.front() == '"' && text.back() == '"') {
+        text = text.substr(1, text.size() - 2);
+    } else {
+        text = getVariable(text).getValueAsString();
     }
     
-    // Extract the condition
-    std::string condition = trimmedLine.substr(openParen + 1, closeParen - openParen - 1);
-    
-    // Find the body of the while loop
-    int braceCount = 1;
-    size_t loopBodyStart = m_currentLine + 1;
-    size_t loopBodyEnd = loopBodyStart;
-    
-    while (loopBodyEnd < m_scriptLines.size() && braceCount > 0) {
-        std::string blockLine = m_scriptLines[loopBodyEnd];
-        
-        for (char c : blockLine) {
-            if (c == '{') braceCount++;
-            if (c == '}') braceCount--;
-            if (braceCount == 0) break;
+    // Compile the pattern set the first time this argument is seen. A literal list can't
+    // change, a list variable is compared with what was compiled and rebuilt if it did.
+    const std::string& source = args[1];
+    auto matcherIt = m_patternMatchers.find(source);
+    bool isLiteral = !source.empty() && source.front() == '[';
+    if (matcherIt == m_patternMatchers.end() || !isLiteral) {
+        ArgList items(&m_scratch);
+        if (!resolveList(source, items)) {
+            m_errorHandler->reportError(funcName + " expects a list of patterns, got " + source);
+            return Variable("act.result", "false");
         }
         
-        loopBodyEnd++;
-    }
-    
-    // Execute the loop as long as the condition is true
-    while (evaluateCondition(condition)) {
-        // Execute the loop body
-        for (size_t i = loopBodyStart; i < loopBodyEnd - 1; i++) {
-            processLine(m_scriptLines[i]);
-            if (!m_isRunning) return false;
+        if (matcherIt == m_patternMatchers.end() ||
+            !std::equal(items.begin(), items.end(), matcherIt->second.patterns.begin(), matcherIt->second.patterns.end())) {
+            PatternMatcher& matcher = m_patternMatchers[source];
+            matcher.patterns.assign(items.begin(), items.end());
+            matcher.automaton.build(matcher.patterns);
+            matcherIt = m_patternMatchers.find(source);
         }
     }
     
-    // Skip past the end of the loop in the main execution
-    m_currentLine = loopBodyEnd - 1;
-    return true;
-}
-
-bool FlareInterpreter::processLine(const std::string& line) {
-    // Skip empty lines and comments
-    std::string trimmedLine = m_utils->trim(line);
-    if (trimmedLine.empty() || trimmedLine[0] == '#') {
-        return true;
+    const PatternMatcher& matcher = matcherIt->second;
+    
+    // One pass over the text finds every hit; matchAny stops at the first
+    if (funcName == "matchAny") {
+        bool found = false;
+        matcher.automaton.scan(text, [&](size_t, size_t) {
+            found = true;
+            return false;
+        });
+        return Variable("act.result", found ? "true" : "false");
     }
     
-    // Handle standalone closing brace - used to end blocks like if, for, functions
-    // Check if the line starts with a closing brace, which would handle cases like
-    // "}", "} else", "} else if", and any variations with additional text
-    if (trimmedLine[0] == '}') {
-        // This is handled by the respective block processor methods
-        // so we just silently ignore it here to prevent "Unknown command" errors
+    std::vector<bool> seen(matcher.patterns.size(), false);
+    std::vector<size_t> order;
+    matcher.automaton.scan(text, [&](size_t index, size_t) {
+        if (!seen[index]) {
+            seen[index] = true;
+            order.push_back(index);
+        }
         return true;
-    }
+    });
     
-    // Check for if statement
-    if (trimmedLine.find("if ") == 0) {
-        return processIfStatement(trimmedLine);
+    // Hits are reported for the first copy of each pattern, so every pattern occurs
+    // exactly when every distinct one was hit
+    if (funcName == "matchAll") {
+        bool all = order.size() == matcher.automaton.getDistinctPatternCount();
+        return Variable("act.result", all ? "true" : "false");
     }
     
-    // Check for else or else if statement
-    if (trimmedLine.find("else") == 0) {
-        // These are handled as part of if statement processing
-        // so we can just return true here
-        return true;
+    // matchHits: the patterns that occur, in the order they were first found
+    Variable hits("ls.hits", "");
+    for (size_t index : order) {
+        hits.addToList(Variable("str.hit", matcher.patterns[index]));
+    }
+    return hits;
+}
+
+Variable FlareInterpreter::evaluateStringBuiltin(const std::string& funcName, const std::string& argsStr) {
+    ArgList args = m_parser->parseParenthesizedArgs(argsStr, &m_scratch);
+    size_t expected = funcName == "trim" ? 1 : (funcName == "replaceAll" ? 3 : 2);
+    if (args.size() != expected) {
+        m_errorHandler->reportError(funcName + " expects " + std::to_string(expected) + " arguments, got " +
+                                    std::to_string(args.size()));
+        return Variable("str.error", "");
     }
     
-    // Check for for loop
-    if (trimmedLine.find("for ") == 0) {
-        return processForLoop(trimmedLine);
+    // Each argument is a string literal or the name of a variable holding it. Lists
+    // are left as written for replaceAll, which resolves them itself.
+    std::vector<bool> isList(args.size(), false);
+    for (size_t i = 0; i < args.size(); i++) {
+        std::string& arg = args[i];
+        if (arg.size() >= 2 && arg.front() == '"' && arg.back() == '"') {
+            arg = arg.substr(1, arg.size() - 2);
+        } else if (funcName == "replaceAll" && i > 0 && !arg.empty() && arg.front() == '[') {
+            isList[i] = true;
+        } else {
+            Variable value = getVariable(arg);
+            isList[i] = funcName == "replaceAll" && i > 0 && value.isList();
+            if (!isList[i]) {
+                arg = value.getValueAsString();
+            }
+        }
     }
+    const std::string& text = args[0];
     
-    // Check for while loop
-    if (trimmedLine.find("while ") == 0) {
-        return processWhileLoop(trimmedLine);
+    if (funcName == "indexOf") {
+        size_t pos = StringKernels::find(text, args[1]);
+        return Variable("int.result", pos == StringKernels::npos ? "-1" : std::to_string(pos));
     }
     
-    // Check for function definition
-    if (trimmedLine.find("function ") == 0) {
-        return processFunction(trimmedLine);
+    if (funcName == "trim") {
+        return Variable("str.result", std::string(StringKernels::trim(text)));
     }
     
-    // Check for return statement
-    if (trimmedLine.find("return ") == 0) {
-        // Should only be processed inside function bodies,
-        // which is handled in processFunctionCall
-        m_errorHandler->reportError("Return statement outside of function");
-        return false;
+    if (funcName == "split") {
+        if (args[1].size() != 1) {
+            m_errorHandler->reportError("split expects a single-character delimiter, got \"" + args[1] + "\"");
+            return Variable("ls.result", "");
+        }
+        std::vector<std::string_view> parts;
+        StringKernels::split(text, args[1][0], parts);
+        Variable result("ls.result", "");
+        for (std::string_view part : parts) {
+            result.addToList(Variable("str.part", std::string(part)));
+        }
+        return result;
     }
-
-    // Parse the line for normal commands
-    auto [command, args] = m_parser->parseLine(trimmedLine);
     
-    // Check if it's a function call
-    if (m_userFunctions.find(command) != m_userFunctions.end()) {
-        return processFunctionCall(command, args);
+    // replaceAll: from and to are both strings, or both lists of the same length
+    // whose pairs are all replaced in a single pass
+    if (!isList[1] && !isList[2]) {
+        return Variable("str.result", StringKernels::replaceAll(text, args[1], args[2]));
     }
     
-    // Execute the command
-    return executeCommand(command, args);
+    ArgList fromItems(&m_scratch);
+    ArgList toItems(&m_scratch);
+    if (!resolveList(args[1], fromItems) || !resolveList(args[2], toItems) || fromItems.size() != toItems.size()) {
+        m_errorHandler->reportError("replaceAll expects two strings or two lists of the same length");
+        return Variable("str.result", text);
+    }
+    std::vector<std::string_view> from(fromItems.begin(), fromItems.end());
+    std::vector<std::string_view> to(toItems.begin(), toItems.end());
+    return Variable("str.result", StringKernels::replaceAll(text, from, to));
 }
 
-// Process dynamic mode-specific operations
-bool FlareInterpreter::processDynamicMode() {
-    // Read the dynamic mode flag from the script
-    for (const auto& line : m_scriptLines) {
-        std::string trimmedLine = m_utils->trim(line);
-        if (trimmedLine.find("dynamic = ") == 0) {
-            std::string valueStr = trimmedLine.substr(10); // "dynamic = " is 10 characters
-            m_isDynamicMode = (valueStr == "true");
-            break;
+Variable FlareInterpreter::evaluateLinearAlgebra(const std::string& funcName, const std::string& argsStr) {
+    ArgList args = m_parser->parseParenthesizedArgs(argsStr, &m_scratch);
+    size_t expected = funcName == "gemm" ? 5 : (funcName == "gemv" ? 4 : (funcName == "axpy" ? 3 : 2));
+    if (args.size() != expected) {
+        m_errorHandler->reportError(funcName + " expects " + std::to_string(expected) + " arguments, got " +
+                                    std::to_string(args.size()));
+        return Variable(funcName == "dot" ? "fl.error" : "ls.error", "");
+    }
+    
+    // Arguments are list literals, nested calls, numbers or variable names
+    std::vector<Variable> values;
+    for (const auto& arg : args) {
+        if (!arg.empty() && arg.front() == '[') {
+            values.emplace_back("ls.literal", arg);
+        } else if (m_parser->isCallExpression(arg)) {
+            values.push_back(evaluateExpression(arg));
+        } else {
+            values.push_back(getVariable(arg));
         }
     }
     
-    return true;
+    if (funcName == "fill") {
+        if (!values[0].isInteger() || values[0].getIntValue() < 0) {
+            m_errorHandler->reportError("fill expects a non-negative count, got " + args[0]);
+            return Variable("ls.error", "");
+        }
+        size_t count = static_cast<size_t>(values[0].getIntValue());
+        if (values[1].isInteger()) {
+            return Variable("ls.result", std::vector<int>(count, values[1].getIntValue()));
+        }
+        if (values[1].isFloat()) {
+            return Variable("ls.result", std::vector<float>(count, values[1].getFloatValue()));
+        }
+        m_errorHandler->reportError("fill expects a number to fill with, got " + args[1]);
+        return Variable("ls.error", "");
+    }
+    
+    // Every list argument is converted to floats; matrix sizes are ints
+    size_t lists = funcName == "axpy" ? 3 : 2;
+    std::vector<PackedList<float>> storage(lists);
+    std::vector<const PackedList<float>*> operands(lists, nullptr);
+    for (size_t i = funcName == "axpy" ? 1 : 0; i < lists; i++) {
+        operands[i] = toFloatList(values[i], storage[i]);
+        if (operands[i] == nullptr) {
+            m_errorHandler->reportError(funcName + " expects a list of numbers, got " + args[i]);
+            return Variable(funcName == "dot" ? "fl.error" : "ls.error", "");
+        }
+    }
+    std::vector<size_t> sizes;
+    for (size_t i = lists; i < values.size(); i++) {
+        if (!values[i].isInteger() || values[i].getIntValue() < 0) {
+            m_errorHandler->reportError(funcName + " expects a non-negative size, got " + args[i]);
+            return Variable("ls.error", "");
+        }
+        sizes.push_back(static_cast<size_t>(values[i].getIntValue()));
+    }
+    
+    if (funcName == "dot") {
+        const PackedList<float>& x = *operands[0];
+        const PackedList<float>& y = *operands[1];
+        if (x.size() != y.size()) {
+            m_errorHandler->reportError("dot expects lists of the same length, got " + std::to_string(x.size()) +
+                                        " and " + std::to_string(y.size()));
+            return Variable("fl.error", "");
+        }
+        // Nine significant digits carry a float through its string form unchanged
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.9g", LinearAlgebra::dot(x.data(), y.data(), x.size()));
+        return Variable("fl.result", text);
+    }
+    
+    if (funcName == "axpy") {
+        if (!values[0].isInteger() && !values[0].isFloat()) {
+            m_errorHandler->reportError("axpy expects a number to scale by, got " + args[0]);
+            return Variable("ls.error", "");
+        }
+        float alpha = values[0].isFloat() ? values[0].getFloatValue() : static_cast<float>(values[0].getIntValue());
+        const PackedList<float>& x = *operands[1];
+        std::vector<float> y(operands[2]->begin(), operands[2]->end());
+        if (x.size() != y.size()) {
+            m_errorHandler->reportError("axpy expects lists of the same length, got " + std::to_string(x.size()) +
+                                        " and " + std::to_string(y.size()));
+            return Variable("ls.error", "");
+        }
+        LinearAlgebra::axpy(alpha, x.data(), y.data(), y.size());
+        return Variable("ls.result", std::move(y));
+    }
+    
+    const PackedList<float>& a = *operands[0];
+    const PackedList<float>& b = *operands[1];
+    if (funcName == "gemv") {
+        size_t m = sizes[0];
+        size_t n = sizes[1];
+        if (a.size() != m * n || b.size() != n) {
+            m_errorHandler->reportError("gemv expects a " + std::to_string(m) + "x" + std::to_string(n) +
+                                        " matrix and a vector of " + std::to_string(n) + ", got lists of " +
+                                        std::to_string(a.size()) + " and " + std::to_string(b.size()));
+            return Variable("ls.error", "");
+        }
+        std::vector<float> y(m);
+        LinearAlgebra::gemv(a.data(), b.data(), y.data(), m, n);
+        return Variable("ls.result", std::move(y));
+    }
+    
+    size_t m = sizes[0];
+    size_t k = sizes[1];
+    size_t n = sizes[2];
+    if (a.size() != m * k || b.size() != k * n) {
+        m_errorHandler->reportError("gemm expects " + std::to_string(m) + "x" + std::to_string(k) + " and " +
+                                    std::to_string(k) + "x" + std::to_string(n) + " matrices, got lists of " +
+                                    std::to_string(a.size()) + " and " + std::to_string(b.size()));
+        return Variable("ls.error", "");
+    }
+    std::vector<float> c(m * n);
+    LinearAlgebra::gemm(a.data(), b.data(), c.data(), m, k, n);
+    return Variable("ls.result", std::move(c));
+}
+
+const PackedList<float>* FlareInterpreter::toFloatList(const Variable& value, PackedList<float>& storage) {
+    if (!value.isList()) {
+        return nullptr;
+    }
+    if (const PackedList<float>* floats = value.getFloatArray()) {
+        return floats;
+    }
+    if (const PackedList<int>* ints = value.getIntArray()) {
+        storage = PackedList<float>(std::vector<float>(ints->begin(), ints->end()));
+        return &storage;
+    }
+    if (value.getStringArray() != nullptr) {
+        return nullptr;
+    }
+    
+    std::vector<float> numbers;
+    numbers.reserve(value.getListLength());
+    for (size_t i = 0; i < value.getListLength(); i++) {
+        Variable item = value.getListItem(i);
+        if (item.isFloat()) {
+            numbers.push_back(item.getFloatValue());
+        } else if (item.isInteger()) {
+            numbers.push_back(static_cast<float>(item.getIntValue()));
+        } else {
+            return nullptr;
+        }
+    }
+    storage = PackedList<float>(std::move(numbers));
+    return &storage;
+}
+
+Variable FlareInterpreter::evaluateIndex(const std::string& expr) {
+    std::string trimmed = m_utils->trim(expr);
+    size_t openBracket = trimmed.find('[');
+    std::string name = trimmed.substr(0, openBracket);
+    std::string inside = m_utils->trim(trimmed.substr(openBracket + 1, trimmed.size() - openBracket - 2));
+    
+    // Map keys are looked up by their text, so m[1] and m["1"] are the same entry
+    Variable* container = findVariable(name);
+    if (container != nullptr && container->isMap()) {
+        // A quoted key is read from the atom table as it stands, without a copy
+        bool isLiteral = inside.size() >= 2 && inside.front() == '"' && inside.find('"', 1) == inside.size() - 1;
+        std::string computed = isLiteral ? std::string() : evaluateArgument(inside).getValueAsString();
+        const std::string& key = isLiteral ? unquoteArgument(inside) : computed;
+        const Variable* value = findVariable(name)->getMap()->find(key);
+        if (value == nullptr) {
+            m_errorHandler->reportError("Key '" + key + "' not found in '" + name + "'");
+            return Variable("str.error", "");
+        }
+        return *value;
+    }
+    
+    // Bounds are int literals or variables; a slice may leave either out
+    size_t colon = inside.find(':');
+    std::string bounds[2] = {m_utils->trim(inside.substr(0, colon)),
+                             colon == std::string::npos ? "" : m_utils->trim(inside.substr(colon + 1))};
+    size_t positions[2] = {0, std::string::npos};
+    for (size_t i = 0; i < 2; i++) {
+        if (bounds[i].empty()) {
+            if (i == 0 && colon == std::string::npos) {
+                m_errorHandler->reportError("Missing index in " + trimmed);
+                return Variable("str.error", "");
+            }
+            continue;
+        }
+        Variable bound = getVariable(bounds[i]);
+        if (!bound.isInteger() || bound.getIntValue() < 0) {
+            m_errorHandler->reportError("List index must be a non-negative int, got " + bounds[i]);
+            return Variable("str.error", "");
+        }
+        positions[i] = static_cast<size_t>(bound.getIntValue());
+    }
+    
+    // The list is read where it lives; only the item or slice is made
+    Variable* list = findVariable(name);
+    if (list == nullptr || !list->isList()) {
+        m_errorHandler->reportError("'" + name + "' is not a list or map");
+        return Variable("str.error", "");
+    }
+    if (colon != std::string::npos) {
+        return list->getListSlice(positions[0], positions[1]);
+    }
+    if (positions[0] >= list->getListLength()) {
+        m_errorHandler->reportError("Index " + std::to_string(positions[0]) + " is out of range for '" + name +
+                                    "' of " + std::to_string(list->getListLength()) + " items");
+        return Variable("str.error", "");
+    }
+    return list->getListItem(positions[0]);
+}
+
+Variable FlareInterpreter::evaluateLength(const std::string& argsStr) {
+    std::string arg = m_utils->trim(argsStr);
+    
+    // Variables are measured in place; literals and calls are evaluated first
+    Variable* found = findVariable(arg);
+    Variable value;
+    if (found == nullptr) {
+        if (!arg.empty() && arg.front() == '[') {
+            value = Variable("ls.literal", arg);
+        } else if (m_parser->isCallExpression(arg)) {
+            value = evaluateExpression(arg);
+        } else {
+            value = getVariable(arg);
+        }
+        found = &value;
+    }
+    
+    if (found->isList()) {
+        return Variable("int.result", std::to_string(found->getListLength()));
+    }
+    if (found->isMap()) {
+        return Variable("int.result", std::to_string(found->getMap()->size()));
+    }
+    if (found->isString() && found->getTypeAndName() != "str.undefined") {
+        return Variable("int.result", std::to_string(found->getStringValue().size()));
+    }
+    if (const BufferView* view = found->getBuffer()) {
+        return Variable("int.result", std::to_string(view->getLength()));
+    }
+    m_errorHandler->reportError("len expects a list, map, string or buf, got " + arg);
+    return Variable("int.error", "");
+}
+
+bool FlareInterpreter::processAppend(const ArgList& args) {
+    if (args.size() != 2) {
+        m_errorHandler->reportError("append requires list and value arguments");
+        return false;
+    }
+    
+    Variable item = evaluateArgument(args[1]);
+    Variable* list = findVariable(args[0]);
+    if (list == nullptr || !list->isList()) {
+        m_errorHandler->reportError("'" + args[0] + "' is not a list");
+        return false;
+    }
+    list->addToList(std::move(item));
+    return true;
+}
+
+bool FlareInterpreter::processIndexAssignment(const std::string& target, const std::string& valueStr) {
+    size_t openBracket = target.find('[');
+    std::string name = target.substr(0, openBracket);
+    std::string inside = m_utils->trim(target.substr(openBracket + 1, target.size() - openBracket - 2));
+    Variable value = evaluateArgument(valueStr);
+    Variable key = evaluateArgument(inside);
+    
+    // The container is changed where it lives; a map or list shared with other variables is copied first
+    Variable* container = findVariable(name);
+    if (container != nullptr && container->isMap()) {
+        container->getMutableMap()->set(key.getValueAsString(), std::move(value));
+        return true;
+    }
+    if (container != nullptr && container->isList()) {
+        if (!key.isInteger() || key.getIntValue() < 0) {
+            m_errorHandler->reportError("List index must be a non-negative int, got " + inside);
+            return false;
+        }
+        if (!container->setListItem(static_cast<size_t>(key.getIntValue()), std::move(value))) {
+            m_errorHandler->reportError("Index " + std::to_string(key.getIntValue()) + " is out of range for '" +
+                                        name + "' of " + std::to_string(container->getListLength()) + " items");
+            return false;
+        }
+        return true;
+    }
+    m_errorHandler->reportError("'" + name + "' is not a list or map");
+    return false;
+}
+
+bool FlareInterpreter::toBinaryValue(const Variable& value, size_t width, BitVector& bits) const {
+    if (const BitVector* valueBits = value.getBinaryValue()) {
+        bits = valueBits->resized(width);
+        return true;
+    }
+    if (value.isInteger()) {
+        bits = BitVector(width, static_cast<uint64_t>(static_cast<int64_t>(value.getIntValue())));
+        return true;
+    }
+    return value.isString() && BitVector::parse(value.getStringValue(), width, bits);
+}
+
+Variable FlareInterpreter::evaluateBinaryOperator(char op, const Variable& left, const Variable& right) {
+    // Plain ints combine bitwise as ints
+    if (left.isInteger() && right.isInteger()) {
+        int a = left.getIntValue();
+        int b = right.getIntValue();
+        int result = op == '&' ? a & b : op == '|' ? a | b : a ^ b;
+        return Variable("int.result", std::to_string(result));
+    }
+    
+    const BitVector* leftBits = left.getBinaryValue();
+    const BitVector* rightBits = right.getBinaryValue();
+    if (leftBits == nullptr && rightBits == nullptr) {
+        m_errorHandler->reportError(std::string("Operator ") + op + " expects bin or int operands");
+        return Variable("bin.error", "0");
+    }
+    size_t width = std::max(leftBits != nullptr ? leftBits->width() : 0, rightBits != nullptr ? rightBits->width() : 0);
+    BitVector a;
+    BitVector b;
+    if (!toBinaryValue(left, width, a) || !toBinaryValue(right, width, b)) {
+        m_errorHandler->reportError(std::string("Operator ") + op + " expects bin or int operands");
+        return Variable("bin.error", "0");
+    }
+    
+    BitVector result;
+    switch (op) {
+        case '&': result = BitVector::bitwiseAnd(a, b); break;
+        case '|': result = BitVector::bitwiseOr(a, b); break;
+        case '^': result = BitVector::bitwiseXor(a, b); break;
+        case '+': result = BitVector::add(a, b); break;
+        case '-': result = BitVector::subtract(a, b); break;
+        default:
+            if (!BitVector::multiply(a, b, result)) {
+                m_errorHandler->reportError("Multiplication of bin values is limited to 64 bits");
+                return Variable("bin.error", "0");
+            }
+            break;
+    }
+    return Variable("bin.result", std::move(result));
+}
+
+Variable FlareInterpreter::evaluateBinaryBuiltin(const std::string& funcName, const std::string& argsStr) {
+    ArgList args = m_parser->parseParenthesizedArgs(argsStr, &m_scratch);
+    size_t expected = funcName == "setbit" ? 3 : funcName == "shl" || funcName == "shr" || funcName == "bit" ? 2 : 1;
+    if (args.size() != expected) {
+        m_errorHandler->reportError(funcName + " expects " + std::to_string(expected) + " arguments, got " +
+                                    std::to_string(args.size()));
+        return Variable("int.error", "0");
+    }
+    
+    // The value is read where it lives, so counting or testing bits copies nothing
+    Variable literal;
+    const Variable* value = findVariable(args[0]);
+    if (value == nullptr) {
+        literal = evaluateArgument(args[0]);
+        value = &literal;
+    }
+    const BitVector* bits = value->getBinaryValue();
+    if (bits == nullptr) {
+        m_errorHandler->reportError(funcName + " expects a bin value, got " + args[0]);
+        return Variable("int.error", "0");
+    }
+    
+    if (funcName == "popcount") {
+        return Variable("int.result", std::to_string(bits->popcount()));
+    }
+    if (funcName == "width") {
+        return Variable("int.result", std::to_string(bits->width()));
+    }
+    if (funcName == "not") {
+        return Variable("bin.result", bits->inverted());
+    }
+    
+    // The rest take a shift or a bit position
+    int position = evaluateArgument(args[1]).getIntValue();
+    if (position < 0) {
+        m_errorHandler->reportError(funcName + " expects a non-negative count, got " + args[1]);
+        return Variable("int.error", "0");
+    }
+    if (funcName == "shl") {
+        return Variable("bin.result", bits->shiftedLeft(static_cast<size_t>(position)));
+    }
+    if (funcName == "shr") {
+        return Variable("bin.result", bits->shiftedRight(static_cast<size_t>(position)));
+    }
+    if (static_cast<size_t>(position) >= bits->width()) {
+        m_errorHandler->reportError("Bit " + std::to_string(position) + " is out of range for a " +
+                                    std::to_string(bits->width()) + "-bit value");
+        return Variable("int.error", "0");
+    }
+    if (funcName == "bit") {
+        return Variable("int.result", bits->getBit(static_cast<size_t>(position)) ? "1" : "0");
+    }
+    
+    // setbit
+    BitVector result = *bits;
+    result.setBit(static_cast<size_t>(position), evaluateArgument(args[2]).getIntValue() != 0);
+    return Variable("bin.result", std::move(result));
+}
+
+Variable FlareInterpreter::evaluateBufferBuiltin(const std::string& funcName, const std::string& argsStr) {
+    ArgList args = m_parser->parseParenthesizedArgs(argsStr, &m_scratch);
+    
+    if (funcName == "view") {
+        if (args.size() != 1 && args.size() != 3) {
+            m_errorHandler->reportError("view expects 1 or 3 arguments, got " + std::to_string(args.size()));
+            return Variable("buf.error", "");
+        }
+        
+        // A view of a view narrows it; otherwise the first argument is a block ID
+        BufferView whole;
+        const Variable* source = findVariable(args[0]);
+        if (source != nullptr && source->isBuffer()) {
+            const BufferView* sourceView = findBuffer(funcName, args[0]);
+            if (sourceView == nullptr) {
+                return Variable("buf.error", "");
+            }
+            whole = *sourceView;
+        } else {
+            int id = evaluateArgument(args[0]).getIntValue();
+            std::shared_ptr<MemoryBlock> block = m_memoryManager->getBlock(id);
+            if (block == nullptr) {
+                m_errorHandler->reportError("Memory block " + std::to_string(id) + " does not exist");
+                return Variable("buf.error", "");
+            }
+            whole = BufferView(block, 0, block->size);
+        }
+        if (args.size() == 1) {
+            return Variable("buf.result", std::move(whole));
+        }
+        
+        int offset = evaluateArgument(args[1]).getIntValue();
+        int length = evaluateArgument(args[2]).getIntValue();
+        BufferView view;
+        if (offset < 0 || length < 0 || !whole.slice(static_cast<size_t>(offset), static_cast<size_t>(length), view)) {
+            m_errorHandler->reportError("view of " + std::to_string(length) + " bytes at " + std::to_string(offset) +
+                                        " is out of range for " + std::to_string(whole.getLength()) + " bytes");
+            return Variable("buf.error", "");
+        }
+        return Variable("buf.result", std::move(view));
+    }
+    
+    // load(buffer, type, offset)
+    if (args.size() != 3) {
+        m_errorHandler->reportError("load expects 3 arguments, got " + std::to_string(args.size()));
+        return Variable("int.error", "0");
+    }
+    const BufferView* view = findBuffer(funcName, args[0]);
+    BufferView::Scalar type;
+    bool bigEndian;
+    if (view == nullptr) {
+        return Variable("int.error", "0");
+    }
+    if (!BufferView::parseScalar(m_utils->trim(args[1]), type, bigEndian)) {
+        m_errorHandler->reportError("load expects a type such as u8, i32, f64 or u32be, got " + args[1]);
+        return Variable("int.error", "0");
+    }
+    int offset = evaluateArgument(args[2]).getIntValue();
+    uint64_t bits = 0;
+    if (offset < 0 || !view->load(type, bigEndian, static_cast<size_t>(offset), bits)) {
+        m_errorHandler->reportError("load of " + args[1] + " at " + std::to_string(offset) + " is out of range for " +
+                                    std::to_string(view->getLength()) + " bytes");
+        return Variable("int.error", "0");
+    }
+    
+    // Unsigned elements and i64, which int can't hold, come back as bin values of their width
+    switch (type) {
+        case BufferView::Scalar::I8:
+            return Variable("int.result", std::to_string(static_cast<int8_t>(bits)));
+        case BufferView::Scalar::I16:
+            return Variable("int.result", std::to_string(static_cast<int16_t>(bits)));
+        case BufferView::Scalar::I32:
+            return Variable("int.result", std::to_string(static_cast<int32_t>(bits)));
+        case BufferView::Scalar::F32:
+        case BufferView::Scalar::F64: {
+            // fl holds a float, which nine significant digits carry through its string form
+            double value;
+            if (type == BufferView::Scalar::F32) {
+                float narrow;
+                uint32_t word = static_cast<uint32_t>(bits);
+                std::memcpy(&narrow, &word, sizeof(narrow));
+                value = narrow;
+            } else {
+                std::memcpy(&value, &bits, sizeof(value));
+            }
+            char text[32];
+            std::snprintf(text, sizeof(text), "%.9g", value);
+            return Variable("fl.result", text);
+        }
+        default:
+            return Variable("bin.result", BitVector(BufferView::getScalarSize(type) * 8, bits));
+    }
+}
+
+bool FlareInterpreter::processBufferCommand(const std::string& command, const ArgList& args) {
+    if (command == "store") {
+        if (args.size() != 4) {
+            m_errorHandler->reportError("store requires buffer, type, offset and value arguments");
+            return false;
+        }
+        const BufferView* view = findBuffer(command, args[0]);
+        BufferView::Scalar type;
+        bool bigEndian;
+        if (view == nullptr) {
+            return false;
+        }
+        if (!BufferView::parseScalar(args[1], type, bigEndian)) {
+            m_errorHandler->reportError("store expects a type such as u8, i32, f64 or u32be, got " + args[1]);
+            return false;
+        }
+        int offset = evaluateArgument(args[2]).getIntValue();
+        Variable value = evaluateArgument(args[3]);
+        
+        // Integer elements take the value's low bits; float ones its number
+        uint64_t bits = 0;
+        if (type == BufferView::Scalar::F32 || type == BufferView::Scalar::F64) {
+            double number = 0.0;
+            if (value.isFloat()) {
+                number = value.getFloatValue();
+            } else if (const BitVector* valueBits = value.getBinaryValue()) {
+                number = static_cast<double>(valueBits->toUint64());
+            } else if (value.isInteger()) {
+                number = value.getIntValue();
+            } else {
+                number = std::strtod(value.getValueAsString().c_str(), nullptr);
+            }
+            if (type == BufferView::Scalar::F32) {
+                float narrow = static_cast<float>(number);
+                uint32_t word;
+                std::memcpy(&word, &narrow, sizeof(word));
+                bits = word;
+            } else {
+                std::memcpy(&bits, &number, sizeof(bits));
+            }
+        } else {
+            BitVector valueBits;
+            if (value.isFloat()) {
+                bits = static_cast<uint64_t>(static_cast<int64_t>(value.getFloatValue()));
+            } else if (toBinaryValue(value, 64, valueBits)) {
+                bits = valueBits.toUint64();
+            } else {
+                m_errorHandler->reportError("store expects a number, got " + args[3]);
+                return false;
+            }
+        }
+        
+        if (offset < 0 || !view->store(type, bigEndian, static_cast<size_t>(offset), bits)) {
+            m_errorHandler->reportError("store of " + args[1] + " at " + std::to_string(offset) +
+                                        " is out of range for " + std::to_string(view->getLength()) + " bytes");
+            return false;
+        }
+        return true;
+    }
+    
+    if (command == "fill") {
+        if (args.size() != 2 && args.size() != 4) {
+            m_errorHandler->reportError("fill requires buffer and byte arguments, and optionally offset and length");
+            return false;
+        }
+        const BufferView* view = findBuffer(command, args[0]);
+        if (view == nullptr) {
+            return false;
+        }
+        int byte = evaluateArgument(args[1]).getIntValue();
+        int offset = args.size() == 4 ? evaluateArgument(args[2]).getIntValue() : 0;
+        int length = args.size() == 4 ? evaluateArgument(args[3]).getIntValue() : static_cast<int>(view->getLength());
+        if (offset < 0 || length < 0 ||
+            !view->fill(static_cast<uint8_t>(byte), static_cast<size_t>(offset), static_cast<size_t>(length))) {
+            m_errorHandler->reportError("fill of " + std::to_string(length) + " bytes at " + std::to_string(offset) +
+                                        " is out of range for " + std::to_string(view->getLength()) + " bytes");
+            return false;
+        }
+        return true;
+    }
+    
+    // copy dst dstOffset src srcOffset length, or copy dst src for the whole of src
+    if (args.size() != 2 && args.size() != 5) {
+        m_errorHandler->reportError("copy requires dst, dstOffset, src, srcOffset and length arguments, or dst and src");
+        return false;
+    }
+    bool whole = args.size() == 2;
+    const BufferView* destination = findBuffer(command, args[0]);
+    const BufferView* source = findBuffer(command, whole ? args[1] : args[2]);
+    if (destination == nullptr || source == nullptr) {
+        return false;
+    }
+    int destinationOffset = whole ? 0 : evaluateArgument(args[1]).getIntValue();
+    int sourceOffset = whole ? 0 : evaluateArgument(args[3]).getIntValue();
+    int length = whole ? static_cast<int>(source->getLength()) : evaluateArgument(args[4]).getIntValue();
+    if (destinationOffset < 0 || sourceOffset < 0 || length < 0 ||
+        !BufferView::copy(*destination, static_cast<size_t>(destinationOffset), *source,
+                          static_cast<size_t>(sourceOffset), static_cast<size_t>(length))) {
+        m_errorHandler->reportError("copy of " + std::to_string(length) + " bytes is out of range of its buffers");
+        return false;
+    }
+    return true;
+}
+
+const BufferView* FlareInterpreter::findBuffer(const std::string& command, const std::string& arg) {
+    const Variable* found = findVariable(m_utils->trim(arg));
+    const BufferView* view = found != nullptr ? found->getBuffer() : nullptr;
+    if (view == nullptr) {
+        m_errorHandler->reportError(command + " expects a buf, got " + arg);
+        return nullptr;
+    }
+    if (view->data() == nullptr) {
+        m_errorHandler->reportError(command + ": memory block " + std::to_string(view->getBlockId()) +
+                                    " behind " + arg + " has been freed");
+        return nullptr;
+    }
+    return view;
+}
+
+Variable FlareInterpreter::evaluateMapBuiltin(const std::string& funcName, const std::string& argsStr) {
+    ArgList args = m_parser->parseParenthesizedArgs(argsStr, &m_scratch);
+    size_t expected = funcName == "has" ? 2 : 1;
+    Variable failed = funcName == "has" ? Variable("act.error", "") : Variable("ls.error", "");
+    if (args.size() != expected) {
+        m_errorHandler->reportError(funcName + " expects " + std::to_string(expected) + " arguments, got " +
+                                    std::to_string(args.size()));
+        return failed;
+    }
+    
+    // The key is worked out first; the map is then read where it lives
+    std::string key = funcName == "has" ? evaluateArgument(args[1]).getValueAsString() : "";
+    Variable literal;
+    Variable* found = findVariable(args[0]);
+    if (found == nullptr) {
+        literal = evaluateArgument(args[0]);
+        found = &literal;
+    }
+    if (!found->isMap()) {
+        m_errorHandler->reportError(funcName + " expects a map, got " + args[0]);
+        return failed;
+    }
+    const ValueMap& map = *found->getMap();
+    
+    if (funcName == "has") {
+        return Variable("act.result", map.find(key) != nullptr ? "true" : "false");
+    }
+    if (funcName == "keys") {
+        std::vector<std::string> keys;
+        keys.reserve(map.size());
+        map.forEach([&](std::string_view entryKey, const Variable&) {
+            keys.emplace_back(entryKey);
+        });
+        return Variable("ls.result", std::move(keys));
+    }
+    
+    // values
+    Variable values("ls.result", "");
+    map.forEach([&](std::string_view, const Variable& value) {
+        values.addToList(value);
+    });
+    return values;
+}
+
+bool FlareInterpreter::processRemove(const ArgList& args) {
+    if (args.size() != 2) {
+        m_errorHandler->reportError("remove requires map and key arguments");
+        return false;
+    }
+    
+    // Removing a key that isn't there is not an error
+    std::string key = evaluateArgument(args[1]).getValueAsString();
+    Variable* map = findVariable(args[0]);
+    if (map == nullptr || !map->isMap()) {
+        m_errorHandler->reportError("'" + args[0] + "' is not a map");
+        return false;
+    }
+    if (map->getMap()->find(key) != nullptr) {
+        map->getMutableMap()->erase(key);
+    }
+    return true;
+}
+
+bool FlareInterpreter::processStringAppend(const std::string& name, const std::string& expr) {
+    // Bitwise operators bind more loosely, so with one at the top the + chain isn't the whole expression
+    if (m_parser->findOperator(expr, "|^&") != std::string::npos) {
+        return false;
+    }
+    
+    // Peel terms off name + a + b + ... from the right; any - at this level rules it out
+    std::vector<std::string> terms;
+    std::string head = expr;
+    for (size_t plusPos = m_parser->findOperator(head, "+-"); plusPos != std::string::npos;
+         plusPos = m_parser->findOperator(head, "+-")) {
+        if (head[plusPos] != '+') {
+            return false;
+        }
+        terms.push_back(m_utils->trim(head.substr(plusPos + 1)));
+        head.resize(plusPos);
+    }
+    if (terms.empty() || m_utils->trim(head) != name) {
+        return false;
+    }
+    
+    // Only a string in the scope the assignment writes to is extended
+    auto& scope = m_localVariables.empty() ? m_globalVariables : m_localVariables.top();
+    auto it = scope.find(name);
+    if (it == scope.end() || !it->second.isString()) {
+        return false;
+    }
+    
+    // Every term is evaluated before the first append, so a term naming the variable sees its
+    // old value; then, while the variable still holds its own copy, each goes into its buffer
+    // in turn, as the chain groups from the left
+    std::vector<std::string> texts;
+    for (auto term = terms.rbegin(); term != terms.rend(); ++term) {
+        Variable text = evaluateExpression(*term);
+        texts.push_back(text.isString() ? text.getStringValue() : text.getValueAsString());
+    }
+    for (const std::string& text : texts) {
+        it->second.appendString(text);
+    }
+    return true;
+}
+
+Variable FlareInterpreter::evaluateArgument(const std::string& arg) {
+    // A list or map literal, a call, a literal or a variable; an unknown bare word is taken as text
+    if (!arg.empty() && arg.front() == '[') {
+        return Variable("ls.literal", arg);
+    }
+    if (!arg.empty() && arg.front() == '{') {
+        return Variable("map.literal", arg);
+    }
+    if (m_parser->isCallExpression(arg)) {
+        return evaluateExpression(arg);
+    }
+    Variable value = getVariable(arg);
+    if (value.getTypeAndName() == "str.undefined") {
+        return Variable("str.literal", arg);
+    }
+    return value;
+}
+
+bool FlareInterpreter::processModel(const std::string& command, const ArgList& args) {
+    if (args.size() < 1) {
+        m_errorHandler->reportError(command + " requires name argument");
+        return false;
+    }
+    
+    std::string name = args[0];
+    // Remove quotes if present
+    if (name.size() >= 2 && name.front() == '"' && name.back() == '"') {
+        name = name.substr(1, name.size() - 2);
+    }
+    
+    // Map a model file: model.load name path
+    if (command == "model.load") {
+        if (args.size() < 2) {
+            m_errorHandler->reportError("model.load requires name and path arguments");
+            return false;
+        }
+        std::string path = args[1];
+        if (path.size() >= 2 && path.front() == '"' && path.back() == '"') {
+            path = path.substr(1, path.size() - 2);
+        }
+        
+        auto model = std::make_unique<MlpModel>();
+        if (!model->load(path)) {
+            m_errorHandler->reportError(model->getLastError());
+            return false;
+        }
+        m_models[name] = std::move(model);
+        return true;
+    }
+    // Unmap a model: model.unload name
+    else if (command == "model.unload") {
+        if (m_models.erase(name) == 0) {
+            m_errorHandler->reportError("Model '" + name + "' not found");
+            return false;
+        }
+        return true;
+    }
+    
+    m_errorHandler->reportError("Unknown model command: " + command);
+    return false;
+}
+
+Variable FlareInterpreter::evaluateModel(const std::string& funcName, const std::string& argsStr) {
+    ArgList args = m_parser->parseParenthesizedArgs(argsStr, &m_scratch);
+    Variable failed = funcName == "predict" ? Variable("ls.error", "") : Variable("str.error", "");
+    if (args.size() != 2) {
+        m_errorHandler->reportError(funcName + " expects 2 arguments, got " + std::to_string(args.size()));
+        return failed;
+    }
+    
+    std::string name = args[0];
+    // Remove quotes if present
+    if (name.size() >= 2 && name.front() == '"' && name.back() == '"') {
+        name = name.substr(1, name.size() - 2);
+    }
+    auto found = m_models.find(name);
+    if (found == m_models.end()) {
+        m_errorHandler->reportError("Model '" + name + "' not found (use model.load first)");
+        return failed;
+    }
+    MlpModel& model = *found->second;
+    
+    // The input is text, turned into the model's features, or a list of numbers
+    // holding one or more samples back to back
+    Variable input = evaluateArgument(args[1]);
+    
+    PackedList<float> storage;
+    const PackedList<float>* samples = nullptr;
+    if (input.isList()) {
+        samples = toFloatList(input, storage);
+        if (samples == nullptr || samples->empty() || samples->size() % model.getInputSize() != 0) {
+            m_errorHandler->reportError(funcName + " expects text or samples of " +
+                                        std::to_string(model.getInputSize()) + " numbers for model '" + name + "'");
+            return failed;
+        }
+    } else {
+        std::vector<float> features(model.getInputSize());
+        model.textFeatures(input.getValueAsString(), features.data());
+        storage = PackedList<float>(std::move(features));
+        samples = &storage;
+    }
+    size_t batch = samples->size() / model.getInputSize();
+    
+    if (funcName == "predict") {
+        std::vector<float> outputs(batch * model.getOutputSize());
+        model.forward(samples->data(), batch, outputs.data());
+        return Variable("ls.result", std::move(outputs));
+    }
+    
+    // classify: the label of the first sample's best output, or its index without labels
+    size_t best = model.classify(samples->data());
+    std::string_view label = model.getLabel(best);
+    if (label.empty()) {
+        return Variable("int.result", std::to_string(best));
+    }
+    return Variable("str.result", std::string(label));
+}
+
+RegexEngine* FlareInterpreter::compileRegex(const std::string& pattern) {
+    auto found = m_regexCache.find(pattern);
+    if (found != m_regexCache.end()) {
+        return &found->second;
+    }
+    
+    RegexEngine regex;
+    if (!regex.compile(pattern)) {
+        m_errorHandler->reportError("Invalid regex \"" + pattern + "\": " + regex.getLastError());
+        return nullptr;
+    }
+    
+    // Patterns built from data could grow the cache forever; start over past a limit
+    if (m_regexCache.size() >= 256) {
+        m_regexCache.clear();
+    }
+    return &m_regexCache.emplace(pattern, std::move(regex)).first->second;
+}
+
+Variable FlareInterpreter::evaluateRegex(const std::string& expr) {
+    size_t openParen = expr.find('(');
+    size_t closeParen = m_parser->findClosingParen(expr, openParen);
+    std::string pattern;
+    std::string methodCall;
+    
+    if (expr.compare(0, openParen, "regex") == 0) {
+        // The pattern is a string literal or the name of a variable holding it
+        pattern = m_utils->trim(expr.substr(openParen + 1, closeParen - openParen - 1));
+        if (pattern.size() >= 2 && pattern.front() == '"' && pattern.back() == '"') {
+            pattern = pattern.substr(1, pattern.size() - 2);
+        } else {
+            pattern = getVariable(pattern).getValueAsString();
+        }
+        
+        // regex(pattern) alone checks the pattern and stands for it, so it can be stored
+        if (closeParen == expr.size() - 1) {
+            return compileRegex(pattern) != nullptr ? Variable("str.result", pattern) : Variable("str.error", "");
+        }
+        methodCall = expr.substr(closeParen + 2);
+    } else {
+        // A variable whose value is the pattern
+        size_t dotPos = expr.rfind('.', openParen);
+        std::string objName = expr.substr(0, dotPos);
+        Variable obj = getVariable(objName);
+        if (obj.getTypeAndName() == "str.undefined" || obj.isList()) {
+            m_errorHandler->reportError("Unknown regex variable: " + objName);
+            return Variable("act.result", "false");
+        }
+        pattern = obj.getValueAsString();
+        methodCall = expr.substr(dotPos + 1);
+    }
+    
+    size_t methodParen = methodCall.find('(');
+    std::string method = methodCall.substr(0, methodParen);
+    if ((method != "match" && method != "search" && method != "findAll") ||
+        m_parser->findClosingParen(methodCall, methodParen) != methodCall.size() - 1) {
+        m_errorHandler->reportError("Unknown regex method: " + methodCall);
+        return Variable("act.result", "false");
+    }
+    
+    // The text is a string literal or the name of a variable holding it
+    std::string text = m_utils->trim(methodCall.substr(methodParen + 1, methodCall.size() - methodParen - 2));
+    if (text.size() >= 2 && text.front() == '"' && text.back() == '"') {
+        text = text.substr(1, text.size() - 2);
+    } else {
+        text = getVariable(text).getValueAsString();
+    }
+    
+    RegexEngine* regex = compileRegex(pattern);
+    if (regex == nullptr) {
+        return Variable(method == "findAll" ? "ls.result" : "act.result", method == "findAll" ? "" : "false");
+    }
+    
+    if (method == "match") {
+        return Variable("act.result", regex->match(text) ? "true" : "false");
+    }
+    if (method == "search") {
+        return Variable("act.result", regex->search(text) ? "true" : "false");
+    }
+    
+    std::vector<std::pair<size_t, size_t>> matches;
+    regex->findAll(text, matches);
+    Variable result("ls.result", "");
+    for (const auto& found : matches) {
+        result.addToList(Variable("str.match", text.substr(found.first, found.second)));
+    }
+    return result;
+}
+
+// Process while loop
+bool FlareInterpreter::processWhileLoop(const std::string& line) {
+    std::string trimmedLine = m_utils->trim(line);
+    
+    if (trimmedLine.find("while ") != 0) {
+        return false;
+    }
+    
+    size_t openParen = trimmedLine.find('(');
+    size_t openBrace = trimmedLine.find('{');
+    size_t closeParen = trimmedLine.rfind(')', openBrace);
+    
+    if (openParen == std::string::npos || closeParen == std::string::npos || 
+        openBrace == std::string::npos || openParen >= closeParen || closeParen >= openBrace) {
+        m_errorHandler->reportError("Invalid while loop syntax");
+        return false;
+    }
+    
+    // Extract the condition
+    std::string condition = trimmedLine.substr(openParen + 1, closeParen - openParen - 1);
+    
+    // Find the body of the while loop
+    size_t loopBodyStart = m_currentLine + 1;
+    size_t loopBodyEnd = findBlockEnd(m_currentLine) + 1;
+    
+    // Execute the loop as long as the condition is true
+    m_loopDepth++;
+    while (evaluateCondition(condition)) {
+        // Execute the loop body
+        executeLines(loopBodyStart, loopBodyEnd - 1);
+        if (!m_isRunning) return false;
+        if (m_loopExit == LoopExit::Break) {
+            m_loopExit = LoopExit::None;
+            break;
+        }
+        m_loopExit = LoopExit::None;
+    }
+    m_loopDepth--;
+    
+    // Skip past the end of the loop in the main execution
+    m_currentLine = loopBodyEnd - 1;
+    return true;
+}
+
+bool FlareInterpreter::processMemoAnnotation(const std::string& line) {
+    // The cache holds up to 1 MB of arguments and results unless given a budget
+    size_t budget = 1024 * 1024;
+    std::string rest = line.substr(5); // "@memo" is 5 characters
+    if (!rest.empty() && rest.front() == '(') {
+        size_t closeParen = rest.find(')');
+        if (closeParen == std::string::npos) {
+            m_errorHandler->reportError("Invalid @memo syntax: missing closing parenthesis");
+            return false;
+        }
+        try {
+            budget = std::stoul(m_utils->trim(rest.substr(1, closeParen - 1)));
+        } catch (const std::exception& e) {
+            budget = 0;
+        }
+        if (budget == 0) {
+            m_errorHandler->reportError("@memo expects a byte budget above 0, got " + rest.substr(0, closeParen + 1));
+            return false;
+        }
+        rest = rest.substr(closeParen + 1);
+    }
+    rest = m_utils->trim(rest);
+    
+    // @memo function name(...) { on one line
+    if (rest.find("function ") == 0) {
+        m_pendingMemoBudget = budget;
+        return processFunction(rest);
+    }
+    
+    // Otherwise the next line of code must define the function
+    size_t next = m_currentLine + 1;
+    while (next < m_scriptLines.size()) {
+        std::string nextLine = m_utils->trim(m_scriptLines[next]);
+        if (!nextLine.empty() && nextLine[0] != '#') {
+            break;
+        }
+        next++;
+    }
+    if (!rest.empty() || next == m_scriptLines.size() || m_utils->trim(m_scriptLines[next]).find("function ") != 0) {
+        m_errorHandler->reportError("@memo must come right before a function definition");
+        return false;
+    }
+    m_pendingMemoBudget = budget;
+    return true;
+}
+
+bool FlareInterpreter::checkPureFunction(const FunctionDefinition& func, std::string& problem) const {
+    static const std::unordered_set<std::string> keywords = {
+        "if", "else", "for", "while", "match", "return", "to", "step", "break", "continue", "true", "false",
+        "int", "str", "fl", "bin", "ls", "act", "map", "buf", "_",
+    };
+    static const std::unordered_set<std::string> pureBuiltins = {
+        "len", "has", "keys", "values", "popcount", "shl", "shr", "not", "bit", "setbit", "width", "indexOf",
+        "trim", "split", "replaceAll", "dot", "axpy", "gemv", "gemm", "fill", "matchAny", "matchAll",
+        "matchHits", "regex",
+    };
+    static const std::unordered_set<std::string> effectCommands = {
+        "mem", "virmem", "frmem", "libcall", "add", "input", "link", "store", "fill", "copy", "err", "warn",
+        "allstop",
+    };
+    auto isNameStart = [](char c) {
+        return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+    };
+    auto isNameChar = [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    };
+    
+    // Names the function may read: its parameters, and what it has declared itself by the
+    // line being read, so int.x = x + 1 still reads a global x
+    std::unordered_set<std::string> locals(func.parameters.begin(), func.parameters.end());
+    for (const auto& bodyLine : func.body) {
+        std::string line = m_utils->trim(bodyLine);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (line.find("for ") == 0) {
+            // A loop counter is declared by the header that reads it: for (int.i = 0; ...) and for i = a to b
+            std::string counter = line.substr(4, line.find(" = ") - 4);
+            counter = m_utils->trim(counter.substr(counter.find_first_not_of("( ")));
+            locals.insert(counter.substr(counter.rfind('.') + 1));
+        }
+        if (line.find("video++") != std::string::npos) {
+            problem = "writes output with video++";
+            return false;
+        }
+        
+        // Commands that touch memory, FlameMemory, libraries, input or the run itself
+        std::string command = line.substr(0, line.find_first_of(" ("));
+        if (command.find("fmem.") == 0 || command.find("model.") == 0 || command.find("memo.") == 0 ||
+            (effectCommands.count(command) > 0 && line.find(" = ") == std::string::npos)) {
+            problem = "runs " + command + ", which has side effects";
+            return false;
+        }
+        if ((command == "append" || command == "remove") && line.size() > command.size()) {
+            std::string target = m_utils->trim(line.substr(command.size()));
+            target = target.substr(0, target.find(' '));
+            if (locals.count(target) == 0) {
+                problem = "changes " + target + ", which isn't its own";
+                return false;
+            }
+        }
+        
+        // A declaration's target is local; what remains may only read locals and call pure functions
+        size_t scanFrom = 0;
+        size_t equalsPos = line.find(" = ");
+        if (equalsPos != std::string::npos && line.find('.') < equalsPos) {
+            scanFrom = equalsPos + 3;
+        }
+        for (size_t i = scanFrom; i < line.size(); i++) {
+            char c = line[i];
+            if (c == '#') {
+                break;
+            }
+            if (c == '"') {
+                i++;
+                while (i < line.size() && line[i] != '"') {
+                    if (line[i] == '\\' && i + 1 < line.size()) {
+                        i++;
+                    }
+                    i++;
+                }
+                continue;
+            }
+            if (std::isdigit(static_cast<unsigned char>(c))) {
+                while (i + 1 < line.size() && isNameChar(line[i + 1])) {
+                    i++;
+                }
+                continue;
+            }
+            if (!isNameStart(c)) {
+                continue;
+            }
+            size_t start = i;
+            while (i + 1 < line.size() && isNameChar(line[i + 1])) {
+                i++;
+            }
+            std::string name = line.substr(start, i - start + 1);
+            bool isMember = start > 0 && line[start - 1] == '.';
+            bool isCall = i + 1 < line.size() && line[i + 1] == '(';
+            if (isMember || keywords.count(name) > 0 || ((command == "append" || command == "remove") && start == 0)) {
+                continue;
+            }
+            if (isCall) {
+                auto callee = m_userFunctions.find(name);
+                // A user function shadows the builtin of the same name
+                bool isPureCall = name == func.name || (callee != m_userFunctions.end() ? callee->second.memo != nullptr
+                                                                                       : pureBuiltins.count(name) > 0);
+                if (!isPureCall) {
+                    problem = "calls " + name + ", which isn't @memo";
+                    return false;
+                }
+                continue;
+            }
+            if (locals.count(name) == 0) {
+                problem = "reads " + name + ", which isn't one of its parameters or locals";
+                return false;
+            }
+        }
+        
+        // Only once the right side has been read does the target become local
+        if (scanFrom > 0) {
+            std::string target = line.substr(0, equalsPos);
+            locals.insert(target.substr(target.rfind('.') + 1));
+        }
+    }
+    return true;
+}
+
+bool FlareInterpreter::processMemo(const std::string& command, const ArgList& args) {
+    if (args.size() < 1) {
+        m_errorHandler->reportError(command + " requires function name argument");
+        return false;
+    }
+    const std::string& name = unquoteArgument(args[0]);
+    auto funcIt = m_userFunctions.find(name);
+    if (funcIt == m_userFunctions.end() || !funcIt->second.memo) {
+        m_errorHandler->reportError("'" + name + "' is not an @memo function");
+        return false;
+    }
+    FlameTable& cache = *funcIt->second.memo;
+    
+    if (command == "memo.clear") {
+        cache.clear();
+        return true;
+    }
+    if (command != "memo.stats") {
+        m_errorHandler->reportError("Unknown memo command: " + command);
+        return false;
+    }
+    
+    size_t lookups = cache.getHits() + cache.getMisses();
+    float hitRatio = lookups == 0 ? 0.0f : static_cast<float>(cache.getHits()) / lookups;
+    std::string field = args.size() >= 2 ? m_utils->toLower(unquoteArgument(args[1])) : "";
+    if (field.empty()) {
+        m_globalVariables["__return_value"] = Variable("str.stats",
+            "hits=" + std::to_string(cache.getHits()) +
+            " misses=" + std::to_string(cache.getMisses()) +
+            " evictions=" + std::to_string(cache.getEvictions()) +
+            " hitratio=" + std::to_string(hitRatio) +
+            " bytes=" + std::to_string(cache.getBytesUsed()) +
+            " count=" + std::to_string(cache.size()));
+    } else if (field == "hits") {
+        m_globalVariables["__return_value"] = Variable("int.hits", std::to_string(cache.getHits()));
+    } else if (field == "misses") {
+        m_globalVariables["__return_value"] = Variable("int.misses", std::to_string(cache.getMisses()));
+    } else if (field == "evictions") {
+        m_globalVariables["__return_value"] = Variable("int.evictions", std::to_string(cache.getEvictions()));
+    } else if (field == "hitratio") {
+        m_globalVariables["__return_value"] = Variable("fl.hitratio", std::to_string(hitRatio));
+    } else if (field == "bytes") {
+        m_globalVariables["__return_value"] = Variable("int.bytes", std::to_string(cache.getBytesUsed()));
+    } else if (field == "count") {
+        m_globalVariables["__return_value"] = Variable("int.count", std::to_string(cache.size()));
+    } else {
+        m_errorHandler->reportError("Unknown memo statistic '" + field + "'");
+        return false;
+    }
+    return true;
+}
+
+bool FlareInterpreter::processRangeLoop(const std::string& line) {
+    size_t loopLine = m_currentLine;
+    std::string header = m_utils->trim(line.substr(4)); // "for " is 4 characters
+    bool isIndented = header.back() == ':';
+    if (header.back() != '{' && !isIndented) {
+        m_errorHandler->reportError("A range loop ends its line with { or :");
+        return false;
+    }
+    header = m_utils->trim(header.substr(0, header.size() - 1));
+    if (header.find("int ") == 0) {
+        header = m_utils->trim(header.substr(4));
+    }
+    
+    // name = start to end [step n]
+    size_t equalsPos = header.find('=');
+    size_t toPos = header.find(" to ");
+    if (equalsPos == std::string::npos || toPos == std::string::npos || toPos < equalsPos) {
+        m_errorHandler->reportError("Invalid range loop syntax, expected for i = start to end");
+        return false;
+    }
+    size_t stepPos = header.find(" step ", toPos);
+    std::string name = m_utils->trim(header.substr(0, equalsPos));
+    std::string bounds[3] = {
+        m_utils->trim(header.substr(equalsPos + 1, toPos - equalsPos - 1)),
+        m_utils->trim(stepPos == std::string::npos ? header.substr(toPos + 4) : header.substr(toPos + 4, stepPos - toPos - 4)),
+        stepPos == std::string::npos ? "1" : m_utils->trim(header.substr(stepPos + 6)),
+    };
+    int64_t values[3];
+    for (int i = 0; i < 3; i++) {
+        Variable value = evaluateExpression(bounds[i]);
+        if (!value.isInteger() && !value.isBinary()) {
+            m_errorHandler->reportError("Range loop bounds must be integers, got " + bounds[i]);
+            return false;
+        }
+        // The counter is an int, so a bin bound must fit one rather than be cut down to it
+        if (value.isBinary() && !value.getBinaryValue()->shiftedRight(31).isZero()) {
+            m_errorHandler->reportError("Range loop bound " + bounds[i] + " = " + value.getValueAsString() +
+                                        " is out of the int range");
+            return false;
+        }
+        values[i] = value.getIntValue();
+    }
+    int64_t start = values[0];
+    int64_t end = values[1];
+    int64_t step = values[2];
+    if (name.empty() || step == 0) {
+        m_errorHandler->reportError(name.empty() ? "Range loop needs a variable" : "Range loop step can't be 0");
+        return false;
+    }
+    
+    // An indented body includes its last line; a braced one stops short of the brace
+    size_t blockEnd = findBlockEnd(loopLine);
+    if (!isIndented && blockEnd >= m_scriptLines.size()) {
+        m_errorHandler->reportError("Range loop on line " + std::to_string(loopLine + 1) + " is never closed");
+        return false;
+    }
+    size_t bodyEnd = isIndented ? blockEnd + 1 : blockEnd;
+    
+    // The counter lives here; the variable only reports it, so the body can't change the count.
+    // Each pass updates the variable's int in place, unless the body has replaced it.
+    const Variable counter("int." + name, std::to_string(start));
+    auto& scope = m_localVariables.empty() ? m_globalVariables : m_localVariables.top();
+    m_loopDepth++;
+    for (int64_t i = start; step > 0 ? i < end : i > end; i += step) {
+        Variable& variable = scope[name];
+        if (!variable.isInteger()) {
+            variable = counter;
+        }
+        variable.setIntValue(static_cast<int>(i));
+        executeLines(loopLine + 1, bodyEnd);
+        if (!m_isRunning) return false;
+        if (m_loopExit == LoopExit::Break) {
+            m_loopExit = LoopExit::None;
+            break;
+        }
+        m_loopExit = LoopExit::None;
+    }
+    m_loopDepth--;
+    
+    m_currentLine = blockEnd;
+    return true;
+}
+
+bool FlareInterpreter::processMatch(const std::string& line) {
+    size_t matchLine = m_currentLine;
+    auto found = m_matches.find(matchLine);
+    if (found == m_matches.end()) {
+        CompiledMatch compiled;
+        if (!compileMatch(line, matchLine, compiled)) {
+            return false;
+        }
+        found = m_matches.emplace(matchLine, std::move(compiled)).first;
+    }
+    const CompiledMatch& match = found->second;
+    
+    // Ints and bin values go through the integer keys; anything else through its text
+    Variable subject = evaluateArgument(match.subject);
+    uint32_t arm;
+    if (subject.isInteger() || subject.isBinary()) {
+        arm = match.table.find(subject.getIntValue());
+    } else if (subject.isString()) {
+        arm = match.table.find(std::string_view(subject.getStringValue()));
+    } else {
+        arm = match.table.find(std::string_view(subject.getValueAsString()));
+    }
+    
+    if (arm != MatchTable::kNoArm) {
+        const MatchArm& chosen = match.arms[arm];
+        if (chosen.statement.empty()) {
+            executeLines(chosen.blockStart, chosen.blockEnd);
+        } else {
+            m_currentLine = chosen.line;
+            processLine(chosen.statement);
+        }
+        if (!m_isRunning) return false;
+    }
+    
+    m_currentLine = match.endLine;
+    return true;
+}
+
+bool FlareInterpreter::compileMatch(const std::string& line, size_t matchLine, CompiledMatch& match) {
+    std::string header = m_utils->trim(line);
+    if (header.back() != '{') {
+        m_errorHandler->reportError("match needs a { at the end of its line");
+        return false;
+    }
+    match.subject = m_utils->trim(header.substr(6, header.size() - 7)); // "match " is 6 characters
+    match.endLine = findBlockEnd(matchLine);
+    if (match.subject.empty()) {
+        m_errorHandler->reportError("match needs a value to match");
+        return false;
+    }
+    if (match.endLine >= m_scriptLines.size()) {
+        m_errorHandler->reportError("match on line " + std::to_string(matchLine + 1) + " is never closed");
+        return false;
+    }
+    
+    // Each arm is keys => statement, or keys => { on a line of its own with a block below
+    bool hasDefault = false;
+    for (size_t i = matchLine + 1; i < match.endLine; i++) {
+        std::string armLine = m_utils->trim(m_scriptLines[i]);
+        if (armLine.empty() || armLine[0] == '#') {
+            continue;
+        }
+        
+        size_t arrow = std::string::npos;
+        for (size_t j = 0; j + 1 < armLine.size(); j++) {
+            if (armLine[j] == '"') {
+                j = armLine.find('"', j + 1);
+                if (j == std::string::npos) {
+                    break;
+                }
+            } else if (armLine[j] == '=' && armLine[j + 1] == '>') {
+                arrow = j;
+                break;
+            }
+        }
+        if (arrow == std::string::npos) {
+            m_errorHandler->reportError("Expected key => statement in match on line " + std::to_string(i + 1));
+            return false;
+        }
+        
+        MatchArm arm;
+        arm.statement = m_utils->trim(armLine.substr(arrow + 2));
+        arm.line = i;
+        arm.blockStart = i;
+        arm.blockEnd = i;
+        if (arm.statement == "{") {
+            arm.statement.clear();
+            arm.blockStart = i + 1;
+            arm.blockEnd = findBlockEnd(i);
+            i = arm.blockEnd;
+        } else if (arm.statement.empty()) {
+            m_errorHandler->reportError("match arm on line " + std::to_string(i + 1) + " has no statement");
+            return false;
+        }
+        
+        // Keys are integer or string literals, or _ for everything else
+        uint32_t armIndex = static_cast<uint32_t>(match.arms.size());
+        ArgList keys = m_parser->parseParenthesizedArgs(armLine.substr(0, arrow), &m_scratch);
+        for (const auto& keyArg : keys) {
+            std::string key = m_utils->trim(keyArg);
+            bool added;
+            if (key == "_") {
+                added = !hasDefault;
+                hasDefault = true;
+                match.table.setDefault(armIndex);
+            } else if (key.size() >= 2 && key.front() == '"' && key.back() == '"') {
+                added = match.table.addString(key.substr(1, key.size() - 2), armIndex);
+            } else {
+                errno = 0;
+                char* end = nullptr;
+                long value = std::strtol(key.c_str(), &end, 0);
+                if (key.empty() || *end != '\0' || errno != 0 || value < INT_MIN || value > INT_MAX) {
+                    m_errorHandler->reportError("match keys are integer or string literals, got " + key);
+                    return false;
+                }
+                added = match.table.addInt(static_cast<int>(value), armIndex);
+            }
+            if (!added) {
+                m_errorHandler->reportError("match key " + key + " appears twice, the second time on line " +
+                                            std::to_string(i + 1));
+                return false;
+            }
+        }
+        match.arms.push_back(std::move(arm));
+    }
+    
+    if (!match.table.build()) {
+        m_errorHandler->reportError("match on line " + std::to_string(matchLine + 1) +
+                                    " has keys that can't be laid out for lookup");
+        return false;
+    }
+    return true;
+}
+
+void FlareInterpreter::buildBlockTable() {
+    size_t lineCount = m_scriptLines.size();
+    m_blockEnds.assign(lineCount, lineCount);
+    
+    // A closing brace ends the block of the latest brace still open
+    std::vector<size_t> openLines;
+    for (size_t line = 0; line < lineCount; line++) {
+        const std::string& text = m_scriptLines[line];
+        for (size_t i = 0; i < text.size(); i++) {
+            char c = text[i];
+            
+            // Braces in comments and string literals don't count
+            if (c == '#') {
+                break;
+            }
+            if (c == '"') {
+                i++;
+                while (i < text.size() && text[i] != '"') {
+                    if (text[i] == '\\' && i + 1 < text.size()) {
+                        i++;
+                    }
+                    i++;
+                }
+                continue;
+            }
+            if (c == '{') {
+                openLines.push_back(line);
+            } else if (c == '}' && !openLines.empty()) {
+                m_blockEnds[openLines.back()] = line;
+                openLines.pop_back();
+            }
+        }
+    }
+    
+    // A line ending in : owns the lines below it indented further than itself
+    auto indentOf = [](const std::string& text) {
+        return text.find_first_not_of(" \t");
+    };
+    for (size_t line = 0; line < lineCount; line++) {
+        std::string trimmed = m_utils->trim(m_scriptLines[line]);
+        if (trimmed.empty() || trimmed[0] == '#' || trimmed.back() != ':') {
+            continue;
+        }
+        size_t indent = indentOf(m_scriptLines[line]);
+        m_blockEnds[line] = line;
+        for (size_t next = line + 1; next < lineCount; next++) {
+            std::string nextTrimmed = m_utils->trim(m_scriptLines[next]);
+            if (nextTrimmed.empty() || nextTrimmed[0] == '#') {
+                continue;
+            }
+            if (indentOf(m_scriptLines[next]) <= indent) {
+                break;
+            }
+            m_blockEnds[line] = next;
+        }
+    }
+}
+
+size_t FlareInterpreter::findBlockEnd(size_t openLine) const {
+    return openLine < m_blockEnds.size() ? m_blockEnds[openLine] : m_scriptLines.size();
+}
+
+void FlareInterpreter::executeLines(size_t start, size_t end) {
+    for (m_currentLine = start; m_currentLine < end && m_isRunning && m_loopExit == LoopExit::None; m_currentLine++) {
+        processLine(m_scriptLines[m_currentLine]);
+    }
+}
+
+bool FlareInterpreter::processLine(const std::string& line) {
+    // Temporaries created while running this statement are released when it ends
+    ScratchArena::Scope scratchScope(m_scratch);
+
+    // Skip empty lines and comments
+    std::string trimmedLine = m_utils->trim(line);
+    if (trimmedLine.empty() || trimmedLine[0] == '#') {
+        return true;
+    }
+    
+    // Handle standalone closing brace - used to end blocks like if, for, functions
+    // Check if the line starts with a closing brace, which would handle cases like
+    // "}", "} else", "} else if", and any variations with additional text
+    if (trimmedLine[0] == '}') {
+        // This is handled by the respective block processor methods
+        // so we just silently ignore it here to prevent "Unknown command" errors
+        return true;
+    }
+    
+    // Check for if statement
+    if (trimmedLine.find("if ") == 0) {
+        return processIfStatement(trimmedLine);
+    }
+    
+    // Check for else or else if statement
+    if (trimmedLine.find("else") == 0) {
+        // These are handled as part of if statement processing
+        // so we can just return true here
+        return true;
+    }
+    
+    // Check for for loop
+    if (trimmedLine.find("for ") == 0) {
+        return processForLoop(trimmedLine);
+    }
+    
+    // Check for while loop
+    if (trimmedLine.find("while ") == 0) {
+        return processWhileLoop(trimmedLine);
+    }
+    
+    // Check for match statement
+    if (trimmedLine.find("match ") == 0) {
+        return processMatch(trimmedLine);
+    }
+    
+    // break and continue leave the body of the innermost loop, which picks them up
+    if (trimmedLine == "break" || trimmedLine == "continue") {
+        if (m_loopDepth == 0) {
+            m_errorHandler->reportError(trimmedLine + " outside of a loop");
+            return false;
+        }
+        m_loopExit = trimmedLine == "break" ? LoopExit::Break : LoopExit::Continue;
+        return true;
+    }
+    
+    // Check for function definition
+    if (trimmedLine.find("function ") == 0) {
+        return processFunction(trimmedLine);
+    }
+    
+    // Check for function annotation
+    if (trimmedLine.find("@memo") == 0) {
+        return processMemoAnnotation(trimmedLine);
+    }
+    
+    // Check for return statement
+    if (trimmedLine.find("return ") == 0) {
+        // Should only be processed inside function bodies,
+        // which is handled in processFunctionCall
+        m_errorHandler->reportError("Return statement outside of function");
+        return false;
+    }
+
+    // Statements are parsed once; running one again only copies out its parts
+    const CompiledStatement& statement = compileStatement(trimmedLine);
+    
+    // Assignments to an item, such as m["key"] = value or data[i] = value
+    if (statement.isIndexAssignment) {
+        return processIndexAssignment(statement.command.str(), statement.args[0].str());
+    }
+    
+    const std::string& command = statement.command.str();
+    ArgList args(&m_scratch);
+    args.reserve(statement.args.size());
+    for (Atom arg : statement.args) {
+        args.emplace_back(arg.str());
+    }
+    
+    // Check if it's a function call
+    if (m_userFunctions.find(command) != m_userFunctions.end()) {
+        return processFunctionCall(command, args);
+    }
+    
+    // Execute the command
+    return executeCommand(command, args);
+}
+
+const CompiledStatement& FlareInterpreter::compileStatement(const std::string& trimmedLine) {
+    AtomTable& atoms = AtomTable::global();
+    Atom text = atoms.intern(trimmedLine);
+    auto found = m_statements.find(text);
+    if (found != m_statements.end()) {
+        return found->second;
+    }
+    
+    CompiledStatement statement;
+    std::string target;
+    std::string value;
+    if (m_parser->parseIndexAssignment(trimmedLine, target, value)) {
+        statement.isIndexAssignment = true;
+        statement.command = atoms.intern(target);
+        statement.args.push_back(atoms.intern(value));
+    } else {
+        auto [command, args] = m_parser->parseLine(trimmedLine, &m_scratch);
+        statement.isIndexAssignment = false;
+        statement.command = atoms.intern(command);
+        for (const auto& arg : args) {
+            statement.args.push_back(atoms.intern(arg));
+        }
+    }
+    return m_statements.emplace(text, std::move(statement)).first->second;
+}
+
+const std::string& FlareInterpreter::unquoteArgument(const std::string& arg) {
+    std::string_view text = arg;
+    if (text.size() >= 2 && text.front() == '"' && text.back() == '"') {
+        text = text.substr(1, text.size() - 2);
+    }
+    return AtomTable::global().intern(text).str();
+}
+
+// Process dynamic mode-specific operations
+bool FlareInterpreter::processDynamicMode() {
+    // Read the dynamic mode flag from the script
+    for (const auto& line : m_scriptLines) {
+        std::string trimmedLine = m_utils->trim(line);
+        if (trimmedLine.find("dynamic = ") == 0) {
+            std::string valueStr = trimmedLine.substr(10); // "dynamic = " is 10 characters
+            m_isDynamicMode = (valueStr == "true");
+            break;
+        }
+    }
+    
+    return true;
+}
+
+// Find the last line mentioning each name so FlameMemory can drop it afterwards
+void FlareInterpreter::analyzeLiveness() {
+    // Names are views into m_scriptLines, so scanning a line allocates nothing
+    std::unordered_map<std::string_view, size_t> lastUse;
+    std::unordered_set<std::string_view> usedInFunctions;
+    lastUse.reserve(m_scriptLines.size() * 2);
+    int functionDepth = 0;
+
+    for (size_t lineIndex = 0; lineIndex < m_scriptLines.size(); lineIndex++) {
+        const std::string& line = m_scriptLines[lineIndex];
+        std::string trimmedLine = m_utils->trim(line);
+
+        // Function bodies run from their call sites, so whatever they mention stays alive
+        bool inFunction = functionDepth > 0 || trimmedLine.find("function ") == 0;
+        int listDepth = 0;
+
+        for (size_t i = 0; i < line.length(); i++) {
+            char c = line[i];
+
+            if (c == '#') {
+                break;
+            }
+
+            if (c == '{' && inFunction) functionDepth++;
+            if (c == '}' && functionDepth > 0) functionDepth--;
+            if (c == '[') listDepth++;
+            if (c == ']' && listDepth > 0) listDepth--;
+
+            // Quoted strings name FlameMemory containers, unless they are items of a list literal
+            if (c == '"') {
+                size_t start = ++i;
+                while (i < line.length() && line[i] != '"') {
+                    if (line[i] == '\\' && i + 1 < line.length()) {
+                        i++;
+                    }
+                    i++;
+                }
+                if (listDepth > 0) {
+                    continue;
+                }
+                std::string_view name(line.data() + start, i - start);
+                if (inFunction) {
+                    usedInFunctions.insert(name);
+                } else {
+                    lastUse[name] = lineIndex;
+                }
+                continue;
+            }
+
+            if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+                size_t start = i;
+                while (i + 1 < line.length() &&
+                       (std::isalnum(static_cast<unsigned char>(line[i + 1])) || line[i + 1] == '_')) {
+                    i++;
+                }
+                std::string_view name(line.data() + start, i - start + 1);
+                if (inFunction) {
+                    usedInFunctions.insert(name);
+                } else {
+                    lastUse[name] = lineIndex;
+                }
+            }
+        }
+    }
+
+    m_deadAfterLine.assign(m_scriptLines.size(), {});
+    m_lastUse.clear();
+    for (const auto& entry : lastUse) {
+        if (usedInFunctions.count(entry.first) == 0) {
+            m_deadAfterLine[entry.second].emplace_back(entry.first);
+            m_lastUse.emplace(entry.first, entry.second);
+        }
+    }
+    m_reclaimedUpTo = 0;
+}
+
+// Free variables and FlameMemory containers that the rest of the script never mentions
+void FlareInterpreter::reclaimDeadValues() {
+    // Nothing to gain after the last statement, and the REPL keeps values between runs
+    if (m_currentLine + 1 >= m_scriptLines.size()) {
+        return;
+    }
+
+    // act.flmmem = false switches automatic reclamation off
+    auto flag = m_globalVariables.find("flmmem");
+    if (flag != m_globalVariables.end() && flag->second.isBoolean() && !flag->second.getBoolValue()) {
+        return;
+    }
+
+    for (; m_reclaimedUpTo <= m_currentLine && m_reclaimedUpTo < m_deadAfterLine.size(); m_reclaimedUpTo++) {
+        for (const std::string& name : m_deadAfterLine[m_reclaimedUpTo]) {
+            if (name.find("__") == 0 || name == "ALLMEM" || name == "flmmem" ||
+                m_pinnedVariables.find(name) != m_pinnedVariables.end()) {
+                continue;
+            }
+            m_globalVariables.erase(name);
+            if (m_flameMemory.erase(name) > 0) {
+                m_lastFlameMemory = nullptr;
+            }
+        }
+    }
+}
+
+// Fix a variable in memory: link {name}
+bool FlareInterpreter::processLink(const ArgList& args) {
+    if (args.empty()) {
+        m_errorHandler->reportError("link requires a variable name");
+        return false;
+    }
+
+    std::string name = args[0];
+    // Remove braces or quotes if present
+    if (name.size() >= 2 && ((name.front() == '{' && name.back() == '}') ||
+                             (name.front() == '"' && name.back() == '"'))) {
+        name = m_utils->trim(name.substr(1, name.size() - 2));
+    }
+
+    // Optional duration: link {name} 30s / link {name} ttl=30s
+    uint64_t deadline = 0;
+    if (args.size() >= 2) {
+        std::string duration = args[1];
+        if (duration.find("ttl=") == 0) {
+            duration = duration.substr(4);
+        }
+        uint64_t milliseconds = 0;
+        if (!m_utils->parseDurationMs(duration, milliseconds)) {
+            m_errorHandler->reportError("Invalid link duration: " + args[1]);
+            return false;
+        }
+        deadline = nowMs() + milliseconds;
+        scheduleExpiry("", name, deadline);
+    }
+
+    m_pinnedVariables[name] = deadline;
+    return true;
+}
+
+uint64_t FlareInterpreter::nowMs() const {
+    auto elapsed = std::chrono::steady_clock::now() - m_startTime;
+    // Start at 1 so that 0 can mean "never expires"
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) + 1;
+}
+
+int64_t FlareInterpreter::wallClockOffset() const {
+    auto wallClock = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(wallClock).count() - static_cast<int64_t>(nowMs());
+}
+
+void FlareInterpreter::scheduleExpiry(const std::string& container, const std::string& key, uint64_t deadline) {
+    uint64_t id = m_nextExpiryId++;
+    m_expiryTargets[id] = {container, key, deadline};
+    m_expiryWheel.add(deadline, id);
+}
+
+// Drop FlameMemory entries and end links whose time has run out
+void FlareInterpreter::expireTimers() {
+    std::vector<WheelTimer> expired;
+    m_expiryWheel.advance(nowMs(), expired);
+
+    for (const auto& timer : expired) {
+        auto targetIt = m_expiryTargets.find(timer.target);
+        if (targetIt == m_expiryTargets.end()) {
+            continue;
+        }
+        ExpiryTarget target = targetIt->second;
+        m_expiryTargets.erase(targetIt);
+
+        if (!target.container.empty()) {
+            // The entry may have been rewritten since; expire() only removes it if the deadline still matches
+            auto memoryIt = m_flameMemory.find(target.container);
+            if (memoryIt != m_flameMemory.end() && memoryIt->second.data.expire(target.key, target.deadline) &&
+                memoryIt->second.store && !memoryIt->second.store->recordErase(target.key)) {
+                m_errorHandler->reportError("FlameMemory '" + target.container + "': " + memoryIt->second.store->getLastError());
+            }
+            continue;
+        }
+
+        // A timed link ran out (unless it was renewed)
+        auto pinIt = m_pinnedVariables.find(target.key);
+        if (pinIt == m_pinnedVariables.end() || pinIt->second != target.deadline) {
+            continue;
+        }
+        m_pinnedVariables.erase(pinIt);
+
+        // Its active use may already be over as well
+        auto useIt = m_lastUse.find(target.key);
+        if (m_isDynamicMode && useIt != m_lastUse.end() && useIt->second < m_reclaimedUpTo) {
+            m_globalVariables.erase(target.key);
+        }
+    }
+}
+
+FlameMemory* FlareInterpreter::findFlameMemory(const std::string& name) {
+    // Scripts tend to hit the same container over and over, so the last one is kept at hand
+    if (m_lastFlameMemory != nullptr && m_lastFlameMemory->name == name) {
+        return m_lastFlameMemory;
+    }
+    
+    auto memoryIt = m_flameMemory.find(name);
+    if (memoryIt == m_flameMemory.end()) {
+        return nullptr;
+    }
+    m_lastFlameMemory = &memoryIt->second;
+    return m_lastFlameMemory;
+}
+
+bool FlareInterpreter::parseExpiry(const std::string& arg, uint64_t& expiresAt) {
+    std::string ttl = arg;
+    if (ttl.size() >= 2 && ttl.front() == '"' && ttl.back() == '"') {
+        ttl = ttl.substr(1, ttl.size() - 2);
+    }
+    if (ttl.find("ttl=") == 0) {
+        ttl = ttl.substr(4);
+    }
+    
+    uint64_t milliseconds = 0;
+    if (!m_utils->parseDurationMs(ttl, milliseconds)) {
+        return false;
+    }
+    expiresAt = nowMs() + milliseconds;
+    return true;
+}
+
+bool FlareInterpreter::resolveList(const std::string& arg, ArgList& items) {
+    if (m_parser->parseListLiteral(arg, items)) {
+        for (auto& item : items) {
+            // Remove quotes if present
+            if (item.size() >= 2 && item.front() == '"' && item.back() == '"') {
+                item = item.substr(1, item.size() - 2);
+            }
+        }
+        return true;
+    }
+    
+    // Otherwise it names a list variable
+    auto varIt = m_globalVariables.find(arg);
+    if (varIt == m_globalVariables.end() || !varIt->second.isList()) {
+        return false;
+    }
+    const Variable& list = varIt->second;
+    for (size_t i = 0; i < list.getListLength(); i++) {
+        items.push_back(list.getListItem(i).getValueAsString());
+    }
+    return true;
+}
+
+bool FlareInterpreter::writeFlameMemory(FlameMemory& memory, const std::string& key, Variable&& value, uint64_t expiresAt) {
+    // Shared containers keep wall-clock deadlines and expire lazily on read
+    if (memory.shared) {
+        uint64_t wallExpiry = expiresAt == 0 ? 0 : static_cast<uint64_t>(static_cast<int64_t>(expiresAt) + wallClockOffset());
+        if (!memory.shared->insert(key, value, wallExpiry)) {
+            m_errorHandler->reportError(memory.shared->getLastError());
+            return false;
+        }
+        return true;
+    }
+    
+    // Store the value in FlameMemory, within its declared size. A store logs the entries
+    // evicted to make room before the write, so replaying the log never needs to evict.
+    std::vector<std::string> evicted;
+    memory.data.setEvictionLog(memory.store ? &evicted : nullptr);
+    bool inserted = memory.data.insert(key, std::move(value), expiresAt);
+    memory.data.setEvictionLog(nullptr);
+    for (const std::string& evictedKey : evicted) {
+        if (!memory.store->recordErase(evictedKey)) {
+            m_errorHandler->reportError("FlameMemory '" + memory.name + "': " + memory.store->getLastError());
+            return false;
+        }
+    }
+    if (!inserted) {
+        m_errorHandler->reportError("FlameMemory '" + memory.name + "' is full (" +
+                                    std::to_string(memory.data.getBytesUsed()) + " of " +
+                                    std::to_string(memory.size) + " bytes used)");
+        return false;
+    }
+    
+    if (expiresAt != 0) {
+        scheduleExpiry(memory.name, key, expiresAt);
+    }
+    
+    if (memory.index) {
+        memory.index->insert(key);
+    }
+    if (memory.textIndex) {
+        memory.textIndex->add(key, memory.data.find(key)->getValueAsString());
+    }
+    
+    // Log the write if the container is backed by a store
+    if (memory.store) {
+        if (!memory.store->recordWrite(key, *memory.data.find(key), expiresAt) ||
+            (memory.store->needsCompaction() && !memory.store->compact(memory.data))) {
+            m_errorHandler->reportError("FlameMemory '" + memory.name + "': " + memory.store->getLastError());
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool FlareInterpreter::readFlameMemory(FlameMemory& memory, const std::string& key, Variable& value) {
+    // Shared containers are read in place, without taking a lock
+    if (memory.shared) {
+        return memory.shared->get(key, value, nowMs() + wallClockOffset());
+    }
+    
+    const Variable* stored = memory.data.get(key, nowMs());
+    if (stored == nullptr) {
+        return false;
+    }
+    value = *stored;
+    return true;
 }
 
 // Process FlameMemory operations in dynamic mode
-bool FlareInterpreter::processFlameMemory(const std::string& command, const std::vector<std::string>& args) {
+bool FlareInterpreter::processFlameMemory(const std::string& command, const ArgList& args) {
     if (!m_isDynamicMode) {
         m_errorHandler->reportError("FlameMemory operations are only available in dynamic mode");
         return false;
     }
-    
-    // Create a new FlameMemory container
-    if (command == "fmem.create") {
+    
+    if (m_expiryWheel.size() > 0) {
+        expireTimers();
+    }
+    
+    // Create a new FlameMemory container
+    if (command == "fmem.create") {
+        if (args.size() < 2) {
+            m_errorHandler->reportError("fmem.create requires name and size arguments");
+            return false;
+        }
+        
+        const std::string& name = unquoteArgument(args[0]);
+        
+        // Replacing a container would silently drop its entries, store and indexes
+        if (m_flameMemory.find(name) != m_flameMemory.end()) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' already exists");
+            return false;
+        }
+        
+        size_t size = 1024; // Default size
+        try {
+            size = std::stoul(args[1]);
+        } catch (const std::exception& e) {
+            m_errorHandler->reportError("Invalid size for FlameMemory");
+            return false;
+        }
+        
+        // Optional eviction policy for when the container is full
+        EvictionPolicy policy = EvictionPolicy::REJECT;
+        if (args.size() >= 3) {
+            std::string policyName = m_utils->toLower(args[2]);
+            if (policyName.size() >= 2 && policyName.front() == '"' && policyName.back() == '"') {
+                policyName = policyName.substr(1, policyName.size() - 2);
+            }
+            
+            if (policyName == "lru") {
+                policy = EvictionPolicy::LRU;
+            } else if (policyName == "lfu") {
+                policy = EvictionPolicy::LFU;
+            } else if (policyName != "reject") {
+                m_errorHandler->reportError("Unknown FlameMemory policy '" + policyName + "' (expected lru, lfu or reject)");
+                return false;
+            }
+        }
+        
+        // Create the FlameMemory object
+        FlameMemory memory;
+        memory.name = name;
+        memory.size = size;
+        memory.data.setByteBudget(size);
+        memory.data.setEvictionPolicy(policy);
+        m_flameMemory[name] = memory;
+        
+        return true;
+    }
+    // Write a value to FlameMemory
+    else if (command == "fmem.write") {
+        if (args.size() < 3) {
+            m_errorHandler->reportError("fmem.write requires name, key, and value arguments");
+            return false;
+        }
+        
+        const std::string& name = unquoteArgument(args[0]);
+        
+        // Check if FlameMemory exists
+        FlameMemory* memory = findFlameMemory(name);
+        if (memory == nullptr) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' not found");
+            return false;
+        }
+        
+        const std::string& key = unquoteArgument(args[1]);
+        
+        std::string value = args[2];
+        // Remove quotes if present
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+            value = value.substr(1, value.size() - 2);
+        }
+        
+        // Optional time to live: ttl=500ms / ttl=30s / ttl=5m
+        uint64_t expiresAt = 0;
+        if (args.size() >= 4 && !parseExpiry(args[3], expiresAt)) {
+            m_errorHandler->reportError("Invalid ttl for fmem.write: " + args[3]);
+            return false;
+        }
+        
+        return writeFlameMemory(*memory, key, Variable("str." + key, value), expiresAt);
+    }
+    // Write many entries at once: fmem.writeMany name [keys] [values] [ttl=...]
+    else if (command == "fmem.writeMany") {
+        if (args.size() < 3) {
+            m_errorHandler->reportError("fmem.writeMany requires name, keys and values arguments");
+            return false;
+        }
+        
+        const std::string& name = unquoteArgument(args[0]);
+        
+        FlameMemory* memory = findFlameMemory(name);
+        if (memory == nullptr) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' not found");
+            return false;
+        }
+        
+        ArgList keys(&m_scratch);
+        ArgList values(&m_scratch);
+        if (!resolveList(args[1], keys) || !resolveList(args[2], values)) {
+            m_errorHandler->reportError("fmem.writeMany expects lists of keys and values");
+            return false;
+        }
+        if (keys.size() != values.size()) {
+            m_errorHandler->reportError("fmem.writeMany got " + std::to_string(keys.size()) + " keys but " +
+                                        std::to_string(values.size()) + " values");
+            return false;
+        }
+        
+        uint64_t expiresAt = 0;
+        if (args.size() >= 4 && !parseExpiry(args[3], expiresAt)) {
+            m_errorHandler->reportError("Invalid ttl for fmem.writeMany: " + args[3]);
+            return false;
+        }
+        
+        // Size the table once instead of growing it step by step
+        if (!memory->shared) {
+            memory->data.reserve(memory->data.size() + keys.size());
+        }
+        
+        std::string typeAndName = "str.";
+        for (size_t i = 0; i < keys.size(); i++) {
+            typeAndName.resize(4);
+            typeAndName += keys[i];
+            if (!writeFlameMemory(*memory, keys[i], Variable(typeAndName, values[i]), expiresAt)) {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    // Back a container with an on-disk store: fmem.open name path
+    else if (command == "fmem.open") {
         if (args.size() < 2) {
-            m_errorHandler->reportError("fmem.create requires name and size arguments");
+            m_errorHandler->reportError("fmem.open requires name and path arguments");
+            return false;
+        }
+        
+        const std::string& name = unquoteArgument(args[0]);
+        
+        std::string path = args[1];
+        if (path.size() >= 2 && path.front() == '"' && path.back() == '"') {
+            path = path.substr(1, path.size() - 2);
+        }
+        
+        // Containers that don't exist yet are created without a size limit
+        auto memoryIt = m_flameMemory.find(name);
+        if (memoryIt == m_flameMemory.end()) {
+            FlameMemory memory;
+            memory.name = name;
+            memory.size = 0;
+            memoryIt = m_flameMemory.emplace(name, memory).first;
+        }
+        
+        FlameMemory& memory = memoryIt->second;
+        if (memory.store) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' is already open at '" + memory.store->getPath() + "'");
+            return false;
+        }
+        
+        if (memory.shared) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' is in shared memory and can't be backed by a file");
+            return false;
+        }
+        
+        // Stored expiry times are wall-clock, the table counts from interpreter start
+        size_t existing = memory.data.size();
+        auto store = std::make_shared<FlameStore>();
+        if (!store->open(path, memory.data, wallClockOffset())) {
+            m_errorHandler->reportError("Cannot open FlameMemory '" + name + "': " + store->getLastError());
             return false;
         }
         
-        std::string name = args[0];
+        // Entries written before the open go to disk too
+        if (existing > 0 && !store->compact(memory.data)) {
+            m_errorHandler->reportError("Cannot open FlameMemory '" + name + "': " + store->getLastError());
+            return false;
+        }
+        
+        memory.data.forEach([&](const FlameEntry& entry) {
+            if (entry.expiresAt != 0) {
+                scheduleExpiry(name, entry.key, entry.expiresAt);
+            }
+        });
+        
+        // The store may have brought its own budget
+        memory.size = memory.data.getByteBudget();
+        memory.store = store;
+        return true;
+    }
+    // Make logged writes durable: fmem.sync [name]
+    else if (command == "fmem.sync") {
+        std::string name = args.empty() ? "" : args[0];
         // Remove quotes if present
         if (name.size() >= 2 && name.front() == '"' && name.back() == '"') {
             name = name.substr(1, name.size() - 2);
         }
         
-        size_t size = 1024; // Default size
-        try {
-            size = std::stoul(args[1]);
-        } catch (const std::exception& e) {
-            m_errorHandler->reportError("Invalid size for FlameMemory");
+        if (!name.empty()) {
+            auto memoryIt = m_flameMemory.find(name);
+            if (memoryIt == m_flameMemory.end()) {
+                m_errorHandler->reportError("FlameMemory '" + name + "' not found");
+                return false;
+            }
+            if (!memoryIt->second.store) {
+                m_errorHandler->reportError("FlameMemory '" + name + "' is not backed by a file");
+                return false;
+            }
+        }
+        
+        for (auto& entry : m_flameMemory) {
+            if (!entry.second.store || (!name.empty() && entry.first != name)) {
+                continue;
+            }
+            if (!entry.second.store->sync()) {
+                m_errorHandler->reportError("Cannot sync FlameMemory '" + entry.first + "': " + entry.second.store->getLastError());
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    // Put a container in shared memory for other processes: fmem.share name size
+    // Attach to one created by another process, read-only: fmem.attach name
+    else if (command == "fmem.share" || command == "fmem.attach") {
+        bool isShare = command == "fmem.share";
+        if (args.size() < (isShare ? 2u : 1u)) {
+            m_errorHandler->reportError(isShare ? "fmem.share requires name and size arguments"
+                                                : "fmem.attach requires name argument");
+            return false;
+        }
+        
+        const std::string& name = unquoteArgument(args[0]);
+        
+        // Replacing a container would silently drop its entries, store and indexes
+        if (m_flameMemory.find(name) != m_flameMemory.end()) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' already exists");
+            return false;
+        }
+        
+        auto shared = std::make_shared<FlameShared>();
+        if (isShare) {
+            size_t size = 0;
+            try {
+                size = std::stoul(args[1]);
+            } catch (const std::exception& e) {
+                m_errorHandler->reportError("Invalid size for FlameMemory");
+                return false;
+            }
+            if (!shared->create(name, size)) {
+                m_errorHandler->reportError(shared->getLastError());
+                return false;
+            }
+        } else if (!shared->attach(name)) {
+            m_errorHandler->reportError(shared->getLastError());
             return false;
         }
         
-        // Create the FlameMemory object
         FlameMemory memory;
         memory.name = name;
-        memory.size = size;
+        memory.size = shared->getByteBudget();
+        memory.shared = shared;
         m_flameMemory[name] = memory;
         
         return true;
     }
-    // Write a value to FlameMemory
-    else if (command == "fmem.write") {
-        if (args.size() < 3) {
-            m_errorHandler->reportError("fmem.write requires name, key, and value arguments");
+    // Index a container's keys for fmem.match: fmem.index name
+    else if (command == "fmem.index") {
+        if (args.size() < 1) {
+            m_errorHandler->reportError("fmem.index requires name argument");
             return false;
         }
         
-        std::string name = args[0];
-        // Remove quotes if present
-        if (name.size() >= 2 && name.front() == '"' && name.back() == '"') {
-            name = name.substr(1, name.size() - 2);
+        const std::string& name = unquoteArgument(args[0]);
+        
+        FlameMemory* memory = findFlameMemory(name);
+        if (memory == nullptr) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' not found");
+            return false;
+        }
+        if (memory->shared) {
+            m_errorHandler->reportError("fmem.index is not available for shared FlameMemory '" + name + "'");
+            return false;
         }
         
-        // Check if FlameMemory exists
-        if (m_flameMemory.find(name) == m_flameMemory.end()) {
+        // Later writes keep the index up to date
+        auto index = std::make_shared<PrefixTrie>();
+        memory->data.forEach([&](const FlameEntry& entry) {
+            index->insert(entry.key);
+        });
+        memory->index = index;
+        
+        return true;
+    }
+    // Find the longest indexed key that occurs in a text: fmem.match name text
+    // Sets __return_value to the key, or to an empty string if none occurs
+    else if (command == "fmem.match") {
+        if (args.size() < 2) {
+            m_errorHandler->reportError("fmem.match requires name and text arguments");
+            return false;
+        }
+        
+        const std::string& name = unquoteArgument(args[0]);
+        
+        FlameMemory* memory = findFlameMemory(name);
+        if (memory == nullptr) {
             m_errorHandler->reportError("FlameMemory '" + name + "' not found");
             return false;
         }
+        if (!memory->index) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' has no index (use fmem.index first)");
+            return false;
+        }
         
-        std::string key = args[1];
-        // Remove quotes if present
-        if (key.size() >= 2 && key.front() == '"' && key.back() == '"') {
-            key = key.substr(1, key.size() - 2);
+        // The text is a string literal or the name of a variable holding it
+        std::string text = args[1];
+        if (text.size() >= 2 && text.front() == '"' && text.back() == '"') {
+            text = text.substr(1, text.size() - 2);
+        } else {
+            Variable var = getVariable(text);
+            if (var.getTypeAndName() != "str.undefined") {
+                text = var.getValueAsString();
+            }
         }
         
-        std::string value = args[2];
-        // Remove quotes if present
-        if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
-            value = value.substr(1, value.size() - 2);
+        // Keys that were evicted or expired since they were indexed drop out as they are met
+        PrefixTrie& index = *memory->index;
+        uint64_t now = nowMs();
+        TrieMatch match = index.longestMatch(text, [&](std::string_view key) {
+            return memory->data.contains(key, now);
+        });
+        
+        // Rebuild once dead keys make up most of the index
+        if (index.size() > 2 * memory->data.size() + 64) {
+            index.clear();
+            memory->data.forEach([&](const FlameEntry& entry) {
+                index.insert(entry.key);
+            });
+        }
+        
+        std::string key = match.start == PrefixTrie::npos ? "" : text.substr(match.start, match.length);
+        m_globalVariables["__return_value"] = Variable("str.match", key);
+        return true;
+    }
+    // Index a container's values for fmem.search: fmem.textindex name
+    else if (command == "fmem.textindex") {
+        if (args.size() < 1) {
+            m_errorHandler->reportError("fmem.textindex requires name argument");
+            return false;
+        }
+        
+        const std::string& name = unquoteArgument(args[0]);
+        
+        FlameMemory* memory = findFlameMemory(name);
+        if (memory == nullptr) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' not found");
+            return false;
+        }
+        if (memory->shared) {
+            m_errorHandler->reportError("fmem.textindex is not available for shared FlameMemory '" + name + "'");
+            return false;
+        }
+        
+        // Later writes keep the index up to date
+        auto textIndex = std::make_shared<TextIndex>();
+        memory->data.forEach([&](const FlameEntry& entry) {
+            textIndex->add(entry.key, entry.value.getValueAsString());
+        });
+        memory->textIndex = textIndex;
+        
+        return true;
+    }
+    // Rank entries by how well their values match a query: fmem.search name query [count]
+    // Sets __return_value to the best key (empty if nothing matches), or with a count
+    // to a list of up to that many keys, best first
+    else if (command == "fmem.search") {
+        if (args.size() < 2) {
+            m_errorHandler->reportError("fmem.search requires name and query arguments");
+            return false;
+        }
+        
+        const std::string& name = unquoteArgument(args[0]);
+        
+        FlameMemory* memory = findFlameMemory(name);
+        if (memory == nullptr) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' not found");
+            return false;
+        }
+        if (!memory->textIndex) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' has no text index (use fmem.textindex first)");
+            return false;
+        }
+        
+        // The query is a string literal or the name of a variable holding it
+        std::string query = args[1];
+        if (query.size() >= 2 && query.front() == '"' && query.back() == '"') {
+            query = query.substr(1, query.size() - 2);
+        } else {
+            Variable var = getVariable(query);
+            if (var.getTypeAndName() != "str.undefined") {
+                query = var.getValueAsString();
+            }
+        }
+        
+        size_t count = 1;
+        if (args.size() >= 3) {
+            try {
+                count = std::stoul(args[2]);
+            } catch (const std::exception& e) {
+                m_errorHandler->reportError("Invalid count for fmem.search: " + args[2]);
+                return false;
+            }
         }
         
-        // Store the value in FlameMemory
-        m_flameMemory[name].data[key] = Variable("str." + key, value);
+        // Entries that were evicted or expired since they were indexed drop out as they are met
+        TextIndex& textIndex = *memory->textIndex;
+        uint64_t now = nowMs();
+        std::vector<SearchHit> hits;
+        textIndex.search(query, count, hits, [&](std::string_view key) {
+            return memory->data.contains(key, now);
+        });
+        
+        // Rebuild once replaced and dead entries make up most of the index
+        if (textIndex.getDocumentCount() > 2 * memory->data.size() + 64) {
+            textIndex.clear();
+            memory->data.forEach([&](const FlameEntry& entry) {
+                textIndex.add(entry.key, entry.value.getValueAsString());
+            });
+        }
+        
+        if (args.size() < 3) {
+            std::string key = hits.empty() ? "" : hits[0].key;
+            m_globalVariables["__return_value"] = Variable("str.search", key);
+            return true;
+        }
         
+        Variable keys("ls.keys", "");
+        for (const SearchHit& hit : hits) {
+            keys.addToList(Variable("str." + hit.key, hit.key));
+        }
+        m_globalVariables["__return_value"] = std::move(keys);
         return true;
     }
     // Read a value from FlameMemory
@@ -1303,32 +3684,190 @@ bool FlareInterpreter::processFlameMemory(const std::string& command, const std:
             return false;
         }
         
-        std::string name = args[0];
-        // Remove quotes if present
-        if (name.size() >= 2 && name.front() == '"' && name.back() == '"') {
-            name = name.substr(1, name.size() - 2);
-        }
+        const std::string& name = unquoteArgument(args[0]);
         
         // Check if FlameMemory exists
-        if (m_flameMemory.find(name) == m_flameMemory.end()) {
+        FlameMemory* memory = findFlameMemory(name);
+        if (memory == nullptr) {
             m_errorHandler->reportError("FlameMemory '" + name + "' not found");
             return false;
         }
         
-        std::string key = args[1];
-        // Remove quotes if present
-        if (key.size() >= 2 && key.front() == '"' && key.back() == '"') {
-            key = key.substr(1, key.size() - 2);
-        }
+        const std::string& key = unquoteArgument(args[1]);
         
         // Check if key exists
-        if (m_flameMemory[name].data.find(key) == m_flameMemory[name].data.end()) {
+        Variable value;
+        if (!readFlameMemory(*memory, key, value)) {
             m_errorHandler->reportError("Key '" + key + "' not found in FlameMemory '" + name + "'");
             return false;
         }
         
         // Store the result in __return_value
-        m_globalVariables["__return_value"] = m_flameMemory[name].data[key];
+        m_globalVariables["__return_value"] = std::move(value);
+        
+        return true;
+    }
+    // Read many entries at once: fmem.readMany name [keys]
+    // Returns a list in __return_value, with an empty string for each missing key
+    else if (command == "fmem.readMany") {
+        if (args.size() < 2) {
+            m_errorHandler->reportError("fmem.readMany requires name and keys arguments");
+            return false;
+        }
+        
+        const std::string& name = unquoteArgument(args[0]);
+        
+        FlameMemory* memory = findFlameMemory(name);
+        if (memory == nullptr) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' not found");
+            return false;
+        }
+        
+        ArgList keys(&m_scratch);
+        if (!resolveList(args[1], keys)) {
+            m_errorHandler->reportError("fmem.readMany expects a list of keys");
+            return false;
+        }
+        
+        Variable values("ls.values", "");
+        Variable value;
+        for (const auto& key : keys) {
+            if (!readFlameMemory(*memory, key, value)) {
+                value = Variable("str." + key, "");
+            }
+            values.addToList(std::move(value));
+        }
+        
+        m_globalVariables["__return_value"] = std::move(values);
+        return true;
+    }
+    // List every key: fmem.keys name
+    // Walk the keys a page at a time: fmem.scan name [prefix] [count]
+    // Each scan returns the next page as a list; an empty list means the walk is over
+    // and the next scan starts again from the beginning
+    else if (command == "fmem.keys" || command == "fmem.scan") {
+        if (args.size() < 1) {
+            m_errorHandler->reportError(command + " requires name argument");
+            return false;
+        }
+        
+        const std::string& name = unquoteArgument(args[0]);
+        
+        FlameMemory* memory = findFlameMemory(name);
+        if (memory == nullptr) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' not found");
+            return false;
+        }
+        if (memory->shared) {
+            m_errorHandler->reportError(command + " is not available for shared FlameMemory '" + name + "'");
+            return false;
+        }
+        
+        bool isScan = command == "fmem.scan";
+        std::string prefix = isScan && args.size() >= 2 ? args[1] : "";
+        if (prefix.size() >= 2 && prefix.front() == '"' && prefix.back() == '"') {
+            prefix = prefix.substr(1, prefix.size() - 2);
+        }
+        
+        size_t limit = memory->data.size();
+        if (isScan) {
+            limit = 64;
+            if (args.size() >= 3) {
+                try {
+                    limit = std::stoul(args[2]);
+                } catch (const std::exception& e) {
+                    m_errorHandler->reportError("Invalid count for fmem.scan: " + args[2]);
+                    return false;
+                }
+            }
+            
+            // Asking for another prefix starts a new walk
+            if (prefix != memory->scanPrefix) {
+                memory->scanPrefix = prefix;
+                memory->scanCursor = 0;
+            }
+        }
+        
+        // A finished walk answers once with an empty page, then starts over
+        Variable keys("ls.keys", "");
+        if (isScan && memory->scanCursor == FlameTable::npos) {
+            memory->scanCursor = 0;
+            m_globalVariables["__return_value"] = std::move(keys);
+            return true;
+        }
+        
+        uint64_t now = nowMs();
+        size_t taken = 0;
+        uint32_t cursor = memory->data.scan(isScan ? memory->scanCursor : 0, limit, [&](const FlameEntry& entry) {
+            if ((entry.expiresAt != 0 && entry.expiresAt <= now) ||
+                entry.key.compare(0, prefix.size(), prefix) != 0) {
+                return false;
+            }
+            keys.addToList(Variable("str." + entry.key, entry.key));
+            taken++;
+            return true;
+        });
+        
+        // An empty page already tells the script the walk is over
+        if (isScan) {
+            memory->scanCursor = (cursor == FlameTable::npos && taken == 0) ? 0 : cursor;
+        }
+        
+        m_globalVariables["__return_value"] = std::move(keys);
+        return true;
+    }
+    // Query cache statistics: fmem.stats name [hits|misses|evictions|hitratio|bytes|count]
+    else if (command == "fmem.stats") {
+        if (args.size() < 1) {
+            m_errorHandler->reportError("fmem.stats requires name argument");
+            return false;
+        }
+        
+        const std::string& name = unquoteArgument(args[0]);
+        
+        auto memoryIt = m_flameMemory.find(name);
+        if (memoryIt == m_flameMemory.end()) {
+            m_errorHandler->reportError("FlameMemory '" + name + "' not found");
+            return false;
+        }
+        
+        // Shared containers only report their size; lookups aren't counted across processes
+        const FlameTable& table = memoryIt->second.data;
+        const FlameShared* shared = memoryIt->second.shared.get();
+        size_t bytes = shared ? shared->getBytesUsed() : table.getBytesUsed();
+        size_t count = shared ? shared->size() : table.size();
+        size_t lookups = table.getHits() + table.getMisses();
+        float hitRatio = lookups == 0 ? 0.0f : static_cast<float>(table.getHits()) / lookups;
+        
+        std::string field = args.size() >= 2 ? m_utils->toLower(args[1]) : "";
+        if (field.size() >= 2 && field.front() == '"' && field.back() == '"') {
+            field = field.substr(1, field.size() - 2);
+        }
+        
+        if (field.empty()) {
+            m_globalVariables["__return_value"] = Variable("str.stats",
+                "hits=" + std::to_string(table.getHits()) +
+                " misses=" + std::to_string(table.getMisses()) +
+                " evictions=" + std::to_string(table.getEvictions()) +
+                " hitratio=" + std::to_string(hitRatio) +
+                " bytes=" + std::to_string(bytes) +
+                " count=" + std::to_string(count));
+        } else if (field == "hits") {
+            m_globalVariables["__return_value"] = Variable("int.hits", std::to_string(table.getHits()));
+        } else if (field == "misses") {
+            m_globalVariables["__return_value"] = Variable("int.misses", std::to_string(table.getMisses()));
+        } else if (field == "evictions") {
+            m_globalVariables["__return_value"] = Variable("int.evictions", std::to_string(table.getEvictions()));
+        } else if (field == "hitratio") {
+            m_globalVariables["__return_value"] = Variable("fl.hitratio", std::to_string(hitRatio));
+        } else if (field == "bytes") {
+            m_globalVariables["__return_value"] = Variable("int.bytes", std::to_string(bytes));
+        } else if (field == "count") {
+            m_globalVariables["__return_value"] = Variable("int.count", std::to_string(count));
+        } else {
+            m_errorHandler->reportError("Unknown FlameMemory statistic '" + field + "'");
+            return false;
+        }
         
         return true;
     }
@@ -1339,20 +3878,25 @@ bool FlareInterpreter::processFlameMemory(const std::string& command, const std:
             return false;
         }
         
-        std::string name = args[0];
-        // Remove quotes if present
-        if (name.size() >= 2 && name.front() == '"' && name.back() == '"') {
-            name = name.substr(1, name.size() - 2);
-        }
+        const std::string& name = unquoteArgument(args[0]);
         
         // Check if FlameMemory exists
-        if (m_flameMemory.find(name) == m_flameMemory.end()) {
+        auto memoryIt = m_flameMemory.find(name);
+        if (memoryIt == m_flameMemory.end()) {
             m_errorHandler->reportError("FlameMemory '" + name + "' not found");
             return false;
         }
         
+        // The process that shared a segment removes it; attached readers just let go
+        const auto& shared = memoryIt->second.shared;
+        if (shared && shared->isWritable() && !shared->unlink()) {
+            m_errorHandler->reportError(shared->getLastError());
+            return false;
+        }
+        
         // Remove the FlameMemory
-        m_flameMemory.erase(name);
+        m_flameMemory.erase(memoryIt);
+        m_lastFlameMemory = nullptr;
         
         return true;
     }
@@ -1367,12 +3911,42 @@ Variable FlareInterpreter::processInput() {
     return Variable("str.input", input);
 }
 
-bool FlareInterpreter::executeCommand(const std::string& command, const std::vector<std::string>& args) {
+bool FlareInterpreter::executeCommand(const std::string& command, const ArgList& args) {
     // Check for dynamic mode commands first
     if (command.find("fmem.") == 0) {
         return processFlameMemory(command, args);
     }
     
+    // Classifier models
+    if (command.find("model.") == 0) {
+        return processModel(command, args);
+    }
+    
+    // Caches of @memo functions
+    if (command.find("memo.") == 0) {
+        return processMemo(command, args);
+    }
+    
+    // Pin a variable so FlameMemory keeps it
+    if (command == "link") {
+        return processLink(args);
+    }
+    
+    // Add an item to the end of a list
+    if (command == "append") {
+        return processAppend(args);
+    }
+    
+    // Remove a key from a map
+    if (command == "remove") {
+        return processRemove(args);
+    }
+    
+    // Typed stores and bulk fills and copies through buf views
+    if (command == "store" || command == "fill" || command == "copy") {
+        return processBufferCommand(command, args);
+    }
+
     // Handle input command
     if (command == "input") {
         // Store input in __return_value
@@ -1386,6 +3960,11 @@ bool FlareInterpreter::executeCommand(const std::string& command, const std::vec
         auto dotPos = command.find('.');
         std::string type = command.substr(0, dotPos);
         std::string name = command.substr(dotPos + 1);
+        
+        // bin.16.flags carries its width between the type and the name
+        if (type == "bin") {
+            name = Variable(command, "0").getName();
+        }
 
         // Handle the "video++" special case
         if (name == "video++") {
@@ -1443,17 +4022,17 @@ bool FlareInterpreter::executeCommand(const std::string& command, const std::vec
                 
                 // Debug output to see the value
                 std::cout << "DEBUG: Function call result for variable " << name << " = " 
-                          << result.getValueAsString() << std::endl;
+                          << previewValue(result) << std::endl;
                 
                 // Create a new variable with the result
-                Variable var(command, result.getValueAsString());
+                Variable var(command, result);
                 setVariable(name, var);
                 return true;
             }
             // If it's a variable reference or literal
             else {
-                // Remove quotes if it's a string literal
-                if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+                // Remove quotes if it's a string literal (not "a" + b)
+                if (value.size() >= 2 && value.front() == '"' && value.find('"', 1) == value.size() - 1) {
                     value = value.substr(1, value.size() - 2);
                     // Create a new string variable
                     Variable var(command, value);
@@ -1461,23 +4040,37 @@ bool FlareInterpreter::executeCommand(const std::string& command, const std::vec
                 } else {
                     // It might be a variable reference or literal value
                     // Special case for __return_value from function calls
-                    if (value == "__return_value") {
+                    if (!value.empty() && (value.front() == '[' || value.front() == '{')) {
+                        // A list or map literal
+                        Variable var(command, value);
+                        setVariable(name, var);
+                    } else if (m_parser->findOperator(value, "+-*/&|^") != std::string::npos) {
+                        // Arithmetic, bitwise or concatenation; a string extended by itself grows in place
+                        if (type != "str" || !processStringAppend(name, value)) {
+                            Variable var(command, evaluateExpression(value));
+                            setVariable(name, var);
+                        }
+                    } else if (value == "__return_value") {
                         if (m_globalVariables.find("__return_value") != m_globalVariables.end()) {
                             Variable returnVal = m_globalVariables["__return_value"];
                             // Create a new variable with the type specified and the value from __return_value
-                            Variable var(command, returnVal.getValueAsString());
+                            Variable var(command, returnVal);
                             setVariable(name, var);
                             
                             // For debugging
-                            std::cout << "DEBUG: Assigned return value " << returnVal.getValueAsString() 
+                            std::cout << "DEBUG: Assigned return value " << previewValue(returnVal) 
                                       << " to " << name << std::endl;
                         }
+                    } else if (type == "bin" && !value.empty() &&
+                               value.find_first_not_of("0123456789") == std::string::npos) {
+                        // A decimal literal goes straight to its bits; read as an int it would overflow past 2^31
+                        setVariable(name, Variable(command, value));
                     } else {
                         Variable refVar = getVariable(value);
-                        if (refVar.getTypeString() != "str.undefined") {
+                        if (refVar.getTypeAndName() != "str.undefined") {
                             // It's a variable reference
                             // Create a new variable of the specified type with the reference's value
-                            Variable var(command, refVar.getValueAsString());
+                            Variable var(command, refVar);
                             setVariable(name, var);
                         } else {
                             // It's a literal value
@@ -1626,9 +4219,18 @@ bool FlareInterpreter::executeCommand(const std::string& command, const std::vec
             std::string functionName = args[1];
             
             // Extract the arguments
+            // A buf variable goes through as its bytes; everything else as text
             std::vector<Variable> funcArgs;
             for (size_t i = 2; i < args.size(); i++) {
-                funcArgs.push_back(Variable("str.arg", args[i]));
+                const Variable* found = findVariable(args[i]);
+                if (found != nullptr && found->isBuffer()) {
+                    if (findBuffer(command, args[i]) == nullptr) {
+                        return false;
+                    }
+                    funcArgs.push_back(*found);
+                } else {
+                    funcArgs.push_back(Variable("str.arg", args[i]));
+                }
             }
             
             // Call the function
@@ -1770,8 +4372,20 @@ bool FlareInterpreter::callLibraryFunction(const std::string& libName, const std
     // Convert Flare variables to void* pointers
     std::vector<void*> argPtrs;
     std::vector<std::string> argStrings; // Need to keep strings alive
+    argStrings.reserve(args.size());     // ...at addresses that don't move as it grows
     
     for (const auto& arg : args) {
+        // A buf is passed as a pointer to its first byte, with nothing copied
+        if (const BufferView* view = arg.getBuffer()) {
+            // Native code can't tell a freed block's null from a real pointer
+            if (view->data() == nullptr) {
+                m_errorHandler->reportError("libcall: memory block " + std::to_string(view->getBlockId()) +
+                                            " behind " + arg.getName() + " has been freed");
+                return false;
+            }
+            argPtrs.push_back(view->data());
+            continue;
+        }
         std::string strVal = arg.getValueAsString();
         argStrings.push_back(strVal);
         argPtrs.push_back((void*)argStrings.back().c_str());
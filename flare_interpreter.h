@@ -9,26 +9,93 @@
 #include <iostream>
 #include <functional>
 #include <stack>
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
 #include <dlfcn.h> // For dynamic library loading
 
 #include "variable.h"
+#include "atom_table.h"
 #include "memory_manager.h"
 #include "parser.h"
 #include "error_handler.h"
 #include "utils.h"
+#include "scratch_arena.h"
+#include "flame_table.h"
+#include "flame_store.h"
+#include "flame_shared.h"
+#include "prefix_trie.h"
+#include "text_index.h"
+#include "aho_corasick.h"
+#include "string_kernels.h"
+#include "linear_algebra.h"
+#include "mlp_model.h"
+#include "regex_engine.h"
+#include "timer_wheel.h"
+#include "match_table.h"
 
 // Struct to store a function definition
 struct FunctionDefinition {
     std::string name;
     std::vector<std::string> parameters;
     std::vector<std::string> body;
+    size_t bodyStart;   // Line of the script the body starts on
+
+    // Results of an @memo function by its argument values, least recently used dropped
+    // first once the byte budget is reached; null for other functions
+    std::shared_ptr<FlameTable> memo;
 };
 
 // Struct to store FlameMemory object (for dynamic mode)
 struct FlameMemory {
     std::string name;
     size_t size;
-    std::map<std::string, Variable> data;
+    FlameTable data;
+    std::shared_ptr<FlameStore> store;  // On-disk backing set up by fmem.open, if any
+    std::shared_ptr<FlameShared> shared; // Shared memory segment used instead of data, if any
+    std::shared_ptr<PrefixTrie> index;   // Key index for fmem.match, built by fmem.index
+    std::shared_ptr<TextIndex> textIndex; // Value index for fmem.search, built by fmem.textindex
+
+    // Where the current fmem.scan walk stands
+    uint32_t scanCursor = 0;
+    std::string scanPrefix;
+};
+
+// What a pending timer expires: a FlameMemory entry, or a link when container is empty
+struct ExpiryTarget {
+    std::string container;
+    std::string key;
+    uint64_t deadline;
+};
+
+// A compiled pattern set for matchAny / matchAll / matchHits
+struct PatternMatcher {
+    std::vector<std::string> patterns;
+    AhoCorasick automaton;
+};
+
+// A statement as parsed the first time it runs: a command and its arguments as
+// written, or the target and value of an item assignment
+struct CompiledStatement {
+    bool isIndexAssignment;
+    Atom command;
+    std::vector<Atom> args;
+};
+
+// One arm of a match statement: a statement on the arm's own line, or the lines of a block
+struct MatchArm {
+    std::string statement;  // Empty for a block arm
+    size_t line;            // The arm's line
+    size_t blockStart;      // Lines [blockStart, blockEnd) of a block arm
+    size_t blockEnd;
+};
+
+// A match statement as laid out the first time it runs
+struct CompiledMatch {
+    std::string subject;
+    MatchTable table;
+    std::vector<MatchArm> arms;
+    size_t endLine;         // Line of the closing brace
 };
 
 // Struct to store library information
@@ -62,6 +129,9 @@ public:
     // Add a built-in function
     void addBuiltInFunction(const std::string& name, std::function<Variable(const std::vector<Variable>&)> func);
 
+    // Drop all statement temporaries and give surplus scratch memory back (e.g. between REPL lines)
+    void resetScratch();
+
 private:
     std::string m_version;
     bool m_isDynamicMode;
@@ -76,6 +146,27 @@ private:
     std::unique_ptr<ErrorHandler> m_errorHandler;
     std::unique_ptr<Utils> m_utils;
 
+    // Bump allocator for per-statement temporaries, rewound when each statement ends
+    ScratchArena m_scratch;
+
+    // Statements already parsed, by their trimmed text
+    std::unordered_map<Atom, CompiledStatement> m_statements;
+
+    // match statements already laid out, by the line they start on
+    std::unordered_map<size_t, CompiledMatch> m_matches;
+
+    // Line each block ends on, by the line it opens on: the closing brace of a { } block,
+    // or the last indented line of a range loop's : block; the number of lines elsewhere
+    std::vector<size_t> m_blockEnds;
+
+    // A break or continue on its way out of the innermost loop's body
+    enum class LoopExit { None, Break, Continue };
+    LoopExit m_loopExit;
+    size_t m_loopDepth;     // Loops running in the current function call, or at top level
+
+    // Byte budget given by an @memo line for the function defined next, 0 if there was none
+    size_t m_pendingMemoBudget;
+
     // Global variables
     std::map<std::string, Variable> m_globalVariables;
     
@@ -90,6 +181,30 @@ private:
     
     // FlameMemory containers (for dynamic mode)
     std::map<std::string, FlameMemory> m_flameMemory;
+    FlameMemory* m_lastFlameMemory;     // Most recently used container, reset when one is erased
+
+    // Names whose last mention in the script is on a given line (dynamic mode liveness)
+    std::vector<std::vector<std::string>> m_deadAfterLine;
+    std::unordered_map<std::string, size_t> m_lastUse;
+    size_t m_reclaimedUpTo;
+
+    // Variables fixed in memory with link, with the time the link ends (0 = never)
+    std::map<std::string, uint64_t> m_pinnedVariables;
+
+    // Expiry of FlameMemory entries and timed links
+    TimerWheel m_expiryWheel;
+    std::unordered_map<uint64_t, ExpiryTarget> m_expiryTargets;
+    uint64_t m_nextExpiryId;
+    std::chrono::steady_clock::time_point m_startTime;
+
+    // Pattern sets compiled by the matching builtins, keyed by the pattern argument as written
+    std::unordered_map<std::string, PatternMatcher> m_patternMatchers;
+
+    // Compiled regular expressions, by pattern text
+    std::unordered_map<std::string, RegexEngine> m_regexCache;
+
+    // Models loaded by model.load, by name
+    std::unordered_map<std::string, std::unique_ptr<MlpModel>> m_models;
 
     // Built-in functions
     std::map<std::string, std::function<Variable(const std::vector<Variable>&)>> m_builtInFunctions;
@@ -109,16 +224,46 @@ private:
     // Process a single line of code
     bool processLine(const std::string& line);
 
+    // The statement line holds, parsed when it is first seen
+    const CompiledStatement& compileStatement(const std::string& trimmedLine);
+
+    // An argument's text without its quotes, as interned program text, so no copy is made
+    const std::string& unquoteArgument(const std::string& arg);
+
     // Execute a command
-    bool executeCommand(const std::string& command, const std::vector<std::string>& args);
+    bool executeCommand(const std::string& command, const ArgList& args);
     
     // Process control structures
     bool processIfStatement(const std::string& line);
     bool processElseStatement(const std::string& line);
     bool processForLoop(const std::string& line);
     bool processWhileLoop(const std::string& line);
+    // for i = start to end [step n] with a { } body or an indented : body; i runs from
+    // start up to but not including end, with the bounds worked out once
+    bool processRangeLoop(const std::string& line);
+    // match subject { key => statement ... }, dispatched through a table built on its first run
+    bool processMatch(const std::string& line);
+    bool compileMatch(const std::string& line, size_t matchLine, CompiledMatch& match);
+    
+    // Fill m_blockEnds for the loaded script
+    void buildBlockTable();
+    // Line the block opened on line openLine ends on, or the number of lines if it is never closed
+    size_t findBlockEnd(size_t openLine) const;
+    // Run lines [start, end) of the script, stopping early at a break or continue; a block
+    // among them runs as a whole and the lines after it follow
+    void executeLines(size_t start, size_t end);
     bool processFunction(const std::string& line);
-    bool processFunctionCall(const std::string& name, const std::vector<std::string>& args);
+    bool processFunctionCall(const std::string& name, const ArgList& args);
+    // Run a function's body with its parameters bound, leaving its result in __return_value
+    bool executeFunctionBody(const FunctionDefinition& func, std::map<std::string, Variable> localVars);
+    
+    // @memo or @memo(bytes) on the line before a function, or in front of it on its line
+    bool processMemoAnnotation(const std::string& line);
+    // Check that an @memo function's result depends only on its arguments and that it
+    // changes nothing; returns false with the first problem found
+    bool checkPureFunction(const FunctionDefinition& func, std::string& problem) const;
+    // memo.stats name [field] and memo.clear name
+    bool processMemo(const std::string& command, const ArgList& args);
     
     // Evaluate expressions
     Variable evaluateExpression(const std::string& expr);
@@ -126,7 +271,80 @@ private:
     
     // Dynamic mode functions
     bool processDynamicMode();
-    bool processFlameMemory(const std::string& command, const std::vector<std::string>& args);
+    void analyzeLiveness();
+    void reclaimDeadValues();
+    bool processLink(const ArgList& args);
+
+    // Milliseconds since the interpreter started (the timer wheel's clock)
+    uint64_t nowMs() const;
+    // Add to nowMs() values to get wall-clock milliseconds
+    int64_t wallClockOffset() const;
+    void scheduleExpiry(const std::string& container, const std::string& key, uint64_t deadline);
+    void expireTimers();
+    bool processFlameMemory(const std::string& command, const ArgList& args);
+
+    // FlameMemory helpers shared by the single and batch commands
+    FlameMemory* findFlameMemory(const std::string& name);
+    bool parseExpiry(const std::string& arg, uint64_t& expiresAt);
+    bool resolveList(const std::string& arg, ArgList& items);
+    bool writeFlameMemory(FlameMemory& memory, const std::string& key, Variable&& value, uint64_t expiresAt);
+    bool readFlameMemory(FlameMemory& memory, const std::string& key, Variable& value);
+
+    // matchAny(text, patterns), matchAll(text, patterns) and matchHits(text, patterns)
+    Variable evaluatePatternMatch(const std::string& funcName, const std::string& argsStr);
+
+    // indexOf(text, needle), trim(text), split(text, delimiter) and replaceAll(text, from, to)
+    Variable evaluateStringBuiltin(const std::string& funcName, const std::string& argsStr);
+
+    // dot(x, y), axpy(alpha, x, y), gemv(a, x, m, n), gemm(a, b, m, k, n) and fill(count, value)
+    Variable evaluateLinearAlgebra(const std::string& funcName, const std::string& argsStr);
+    // The numbers of a list as floats: packed float lists are used in place, others
+    // are converted into storage; nullptr if value isn't a list of numbers
+    const PackedList<float>* toFloatList(const Variable& value, PackedList<float>& storage);
+
+    // name[index] and name[start:end] on a list; either slice bound may be left out
+    Variable evaluateIndex(const std::string& expr);
+    // len(value), the items in a list or the characters in a string
+    Variable evaluateLength(const std::string& argsStr);
+    // append list value
+    bool processAppend(const ArgList& args);
+    // name[key] = value on a map, name[index] = value on a list
+    bool processIndexAssignment(const std::string& target, const std::string& valueStr);
+    // has(map, key), keys(map) and values(map)
+    Variable evaluateMapBuiltin(const std::string& funcName, const std::string& argsStr);
+    // remove map key
+    bool processRemove(const ArgList& args);
+    // a & b, a | b, a ^ b, a + b, a - b and a * b where either side is a bin value: the
+    // other side takes its width, and the result has the wider width
+    Variable evaluateBinaryOperator(char op, const Variable& left, const Variable& right);
+    // popcount(x), shl(x, n), shr(x, n), not(x), bit(x, i), setbit(x, i, v) and width(x)
+    Variable evaluateBinaryBuiltin(const std::string& funcName, const std::string& argsStr);
+    // The bits of value at width: a bin value resized, an int's two's complement, or
+    // parsed text; returns false for anything else
+    bool toBinaryValue(const Variable& value, size_t width, BitVector& bits) const;
+    // view(id), view(id, offset, length) and view(buffer, offset, length), windows onto
+    // mem and virmem blocks; load(buffer, type, offset) reads one element
+    Variable evaluateBufferBuiltin(const std::string& funcName, const std::string& argsStr);
+    // store buffer type offset value, fill buffer byte [offset length] and
+    // copy dst dstOffset src srcOffset length (or copy dst src)
+    bool processBufferCommand(const std::string& command, const ArgList& args);
+    // The buf variable named arg, or nullptr after reporting why it can't be used
+    const BufferView* findBuffer(const std::string& command, const std::string& arg);
+    // str.name = name + text, appending to the string in place; returns false, having
+    // done nothing, if the assignment is anything else
+    bool processStringAppend(const std::string& name, const std::string& expr);
+    // A builtin's argument: a list or map literal, a call, a literal or a variable, or
+    // else the bare text itself
+    Variable evaluateArgument(const std::string& arg);
+
+    // model.load name path and model.unload name
+    bool processModel(const std::string& command, const ArgList& args);
+    // predict(model, input) and classify(model, input)
+    Variable evaluateModel(const std::string& funcName, const std::string& argsStr);
+
+    // regex(pattern) and the match, search and findAll methods on a pattern
+    Variable evaluateRegex(const std::string& expr);
+    RegexEngine* compileRegex(const std::string& pattern);
     Variable processInput(); // Process user input for interactive scripts
 
     // Register core variables
@@ -135,8 +353,14 @@ private:
     // Get a variable value (checks local scope first, then global)
     Variable getVariable(const std::string& name);
     
+    // The variable itself, in the same scopes, or nullptr if there is none
+    Variable* findVariable(const std::string& name);
+    
     // Set a variable value (in current scope)
     void setVariable(const std::string& name, const Variable& value);
+    
+    // A value for the DEBUG trace, with long lists cut short
+    std::string previewValue(const Variable& value) const;
 };
 
 #endif // FLARE_INTERPRETER_H
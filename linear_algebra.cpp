@@ -0,0 +1,372 @@
+#include "linear_algebra.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FLARE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Tile of C the inner kernel keeps in registers
+    constexpr size_t kTileRows = 6;
+    constexpr size_t kTileCols = 16;
+
+    // Cache blocks: a kBlockK-deep panel of B stays in L1 while the tiles of a row
+    // panel sweep it, the kBlockM x kBlockK block of A in L2 and the packed B in L3
+    constexpr size_t kBlockK = 256;
+    constexpr size_t kBlockM = 96;
+    constexpr size_t kBlockN = 1024;
+
+    // Products with fewer multiply-adds than this stay on one thread
+    constexpr size_t kThreadedWork = size_t(1) << 22;
+
+    struct Kernels {
+        const char* name;
+        float (*dot)(const float* x, const float* y, size_t n);
+        int32_t (*dotInt8)(const int8_t* x, const int8_t* y, size_t n);
+        void (*axpy)(float alpha, const float* x, float* y, size_t n);
+        // c (row stride ldc) += a x b for packed panels a (depth x kTileRows) and
+        // b (depth x kTileCols)
+        void (*tile)(size_t depth, const float* a, const float* b, float* c, size_t ldc);
+    };
+
+    // Scalar kernels
+
+    float dotScalar(const float* x, const float* y, size_t n) {
+        // Four running sums hide the latency of each addition
+        float sums[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            for (size_t j = 0; j < 4; j++) {
+                sums[j] += x[i + j] * y[i + j];
+            }
+        }
+        for (; i < n; i++) {
+            sums[0] += x[i] * y[i];
+        }
+        return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    }
+
+    int32_t dotInt8Scalar(const int8_t* x, const int8_t* y, size_t n) {
+        int32_t sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            sum += static_cast<int32_t>(x[i]) * y[i];
+        }
+        return sum;
+    }
+
+    void axpyScalar(float alpha, const float* x, float* y, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            y[i] += alpha * x[i];
+        }
+    }
+
+    void tileScalar(size_t depth, const float* a, const float* b, float* c, size_t ldc) {
+        float sums[kTileRows][kTileCols] = {};
+        for (size_t p = 0; p < depth; p++) {
+            for (size_t r = 0; r < kTileRows; r++) {
+                for (size_t j = 0; j < kTileCols; j++) {
+                    sums[r][j] += a[r] * b[j];
+                }
+            }
+            a += kTileRows;
+            b += kTileCols;
+        }
+        for (size_t r = 0; r < kTileRows; r++) {
+            for (size_t j = 0; j < kTileCols; j++) {
+                c[r * ldc + j] += sums[r][j];
+            }
+        }
+    }
+
+    const Kernels kScalarKernels = {
+        "scalar", dotScalar, dotInt8Scalar, axpyScalar, tileScalar
+    };
+
+#ifdef FLARE_X86_KERNELS
+#define FLARE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+
+    FLARE_TARGET_AVX2 float dotAvx2(const float* x, const float* y, size_t n) {
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+        __m256 sum2 = _mm256_setzero_ps();
+        __m256 sum3 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), sum0);
+            sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), sum1);
+            sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 16), _mm256_loadu_ps(y + i + 16), sum2);
+            sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 24), _mm256_loadu_ps(y + i + 24), sum3);
+        }
+        for (; i + 8 <= n; i += 8) {
+            sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), sum0);
+        }
+        __m256 sum = _mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3));
+        __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_add_ss(half, _mm_movehdup_ps(half));
+        float total = _mm_cvtss_f32(half);
+        for (; i < n; i++) {
+            total += x[i] * y[i];
+        }
+        return total;
+    }
+
+    FLARE_TARGET_AVX2 int32_t dotInt8Avx2(const int8_t* x, const int8_t* y, size_t n) {
+        // maddubs multiplies unsigned by signed bytes, so x's signs move onto y first.
+        // Its 16-bit pair sums saturate only if y holds -128, which quantized inputs never do;
+        // another madd by ones widens them to 32 bits.
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i sum0 = _mm256_setzero_si256();
+        __m256i sum1 = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64) {
+            __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+            __m256i y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i));
+            __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i + 32));
+            __m256i y1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i + 32));
+            __m256i pairs0 = _mm256_maddubs_epi16(_mm256_abs_epi8(x0), _mm256_sign_epi8(y0, x0));
+            __m256i pairs1 = _mm256_maddubs_epi16(_mm256_abs_epi8(x1), _mm256_sign_epi8(y1, x1));
+            sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(pairs0, ones));
+            sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(pairs1, ones));
+        }
+        for (; i + 32 <= n; i += 32) {
+            __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+            __m256i y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i));
+            __m256i pairs0 = _mm256_maddubs_epi16(_mm256_abs_epi8(x0), _mm256_sign_epi8(y0, x0));
+            sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(pairs0, ones));
+        }
+        __m256i sum = _mm256_add_epi32(sum0, sum1);
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+        int32_t total = _mm_cvtsi128_si32(half);
+        for (; i < n; i++) {
+            total += static_cast<int32_t>(x[i]) * y[i];
+        }
+        return total;
+    }
+
+    FLARE_TARGET_AVX2 void axpyAvx2(float alpha, const float* x, float* y, size_t n) {
+        __m256 scale = _mm256_set1_ps(alpha);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_ps(y + i, _mm256_fmadd_ps(scale, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+        }
+        for (; i < n; i++) {
+            y[i] += alpha * x[i];
+        }
+    }
+
+    FLARE_TARGET_AVX2 void tileAvx2(size_t depth, const float* a, const float* b, float* c, size_t ldc) {
+        // Two vectors per row of the tile: 12 accumulators, 2 for B, 1 for A
+        __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+        __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+        __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+        __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+        __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+        __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+        for (size_t p = 0; p < depth; p++) {
+            __m256 b0 = _mm256_loadu_ps(b);
+            __m256 b1 = _mm256_loadu_ps(b + 8);
+            __m256 av = _mm256_broadcast_ss(a);
+            c00 = _mm256_fmadd_ps(av, b0, c00);
+            c01 = _mm256_fmadd_ps(av, b1, c01);
+            av = _mm256_broadcast_ss(a + 1);
+            c10 = _mm256_fmadd_ps(av, b0, c10);
+            c11 = _mm256_fmadd_ps(av, b1, c11);
+            av = _mm256_broadcast_ss(a + 2);
+            c20 = _mm256_fmadd_ps(av, b0, c20);
+            c21 = _mm256_fmadd_ps(av, b1, c21);
+            av = _mm256_broadcast_ss(a + 3);
+            c30 = _mm256_fmadd_ps(av, b0, c30);
+            c31 = _mm256_fmadd_ps(av, b1, c31);
+            av = _mm256_broadcast_ss(a + 4);
+            c40 = _mm256_fmadd_ps(av, b0, c40);
+            c41 = _mm256_fmadd_ps(av, b1, c41);
+            av = _mm256_broadcast_ss(a + 5);
+            c50 = _mm256_fmadd_ps(av, b0, c50);
+            c51 = _mm256_fmadd_ps(av, b1, c51);
+            a += kTileRows;
+            b += kTileCols;
+        }
+
+        __m256 sums[kTileRows][2] = {{c00, c01}, {c10, c11}, {c20, c21}, {c30, c31}, {c40, c41}, {c50, c51}};
+        for (size_t r = 0; r < kTileRows; r++) {
+            float* row = c + r * ldc;
+            _mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), sums[r][0]));
+            _mm256_storeu_ps(row + 8, _mm256_add_ps(_mm256_loadu_ps(row + 8), sums[r][1]));
+        }
+    }
+
+#undef FLARE_TARGET_AVX2
+
+    const Kernels kAvx2Kernels = {
+        "avx2", dotAvx2, dotInt8Avx2, axpyAvx2, tileAvx2
+    };
+#endif
+
+    const Kernels& selectKernels() {
+        // FLARE_LINALG_KERNELS=scalar caps the choice, for comparing implementations
+        const char* cap = std::getenv("FLARE_LINALG_KERNELS");
+        if (cap != nullptr && std::string_view(cap) == "scalar") {
+            return kScalarKernels;
+        }
+#ifdef FLARE_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return kAvx2Kernels;
+        }
+#endif
+        return kScalarKernels;
+    }
+
+    const Kernels& kernels() {
+        static const Kernels& selected = selectKernels();
+        return selected;
+    }
+
+    // Threads for large products: the hardware's, capped by FLARE_LINALG_THREADS
+    size_t threadLimit() {
+        static const size_t limit = [] {
+            size_t threads = std::max(1u, std::thread::hardware_concurrency());
+            if (const char* cap = std::getenv("FLARE_LINALG_THREADS")) {
+                threads = std::min(threads, static_cast<size_t>(std::max(1L, std::strtol(cap, nullptr, 10))));
+            }
+            return threads;
+        }();
+        return limit;
+    }
+
+    // Copy rows x depth of A (row stride lda) into panels of kTileRows rows, each
+    // column of a panel contiguous; missing rows are zero
+    void packA(const float* a, size_t lda, size_t rows, size_t depth, float* out) {
+        for (size_t i = 0; i < rows; i += kTileRows) {
+            size_t height = std::min(kTileRows, rows - i);
+            for (size_t p = 0; p < depth; p++) {
+                for (size_t r = 0; r < kTileRows; r++) {
+                    *out++ = r < height ? a[(i + r) * lda + p] : 0.0f;
+                }
+            }
+        }
+    }
+
+    // Copy depth x cols of B (row stride ldb) into panels of kTileCols columns, each
+    // row of a panel contiguous; missing columns are zero
+    void packB(const float* b, size_t ldb, size_t depth, size_t cols, float* out) {
+        for (size_t j = 0; j < cols; j += kTileCols) {
+            size_t width = std::min(kTileCols, cols - j);
+            for (size_t p = 0; p < depth; p++) {
+                const float* row = b + p * ldb + j;
+                for (size_t q = 0; q < kTileCols; q++) {
+                    *out++ = q < width ? row[q] : 0.0f;
+                }
+            }
+        }
+    }
+
+    // C[rowBegin, rowEnd) += A B, one cache block at a time
+    void gemmRows(const float* a, const float* b, float* c, size_t k, size_t n,
+                  size_t rowBegin, size_t rowEnd) {
+        const Kernels& active = kernels();
+        std::vector<float> packedA(kBlockM * kBlockK);
+        std::vector<float> packedB(kBlockK * ((std::min(kBlockN, n) + kTileCols - 1) / kTileCols * kTileCols));
+        float edge[kTileRows * kTileCols];
+
+        for (size_t jc = 0; jc < n; jc += kBlockN) {
+            size_t nc = std::min(kBlockN, n - jc);
+            for (size_t pc = 0; pc < k; pc += kBlockK) {
+                size_t kc = std::min(kBlockK, k - pc);
+                packB(b + pc * n + jc, n, kc, nc, packedB.data());
+
+                for (size_t ic = rowBegin; ic < rowEnd; ic += kBlockM) {
+                    size_t mc = std::min(kBlockM, rowEnd - ic);
+                    packA(a + ic * k + pc, k, mc, kc, packedA.data());
+
+                    for (size_t jr = 0; jr < nc; jr += kTileCols) {
+                        const float* panelB = packedB.data() + jr * kc;
+                        size_t width = std::min(kTileCols, nc - jr);
+                        for (size_t ir = 0; ir < mc; ir += kTileRows) {
+                            const float* panelA = packedA.data() + ir * kc;
+                            size_t height = std::min(kTileRows, mc - ir);
+                            float* tile = c + (ic + ir) * n + jc + jr;
+                            if (height == kTileRows && width == kTileCols) {
+                                active.tile(kc, panelA, panelB, tile, n);
+                                continue;
+                            }
+
+                            // Tiles on the ragged edges go through a full-size scratch tile
+                            std::fill(edge, edge + kTileRows * kTileCols, 0.0f);
+                            active.tile(kc, panelA, panelB, edge, kTileCols);
+                            for (size_t r = 0; r < height; r++) {
+                                for (size_t q = 0; q < width; q++) {
+                                    tile[r * n + q] += edge[r * kTileCols + q];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+namespace LinearAlgebra {
+    float dot(const float* x, const float* y, size_t n) {
+        return kernels().dot(x, y, n);
+    }
+
+    int32_t dotInt8(const int8_t* x, const int8_t* y, size_t n) {
+        return kernels().dotInt8(x, y, n);
+    }
+
+    void axpy(float alpha, const float* x, float* y, size_t n) {
+        kernels().axpy(alpha, x, y, n);
+    }
+
+    void gemv(const float* a, const float* x, float* y, size_t m, size_t n) {
+        const Kernels& active = kernels();
+        for (size_t i = 0; i < m; i++) {
+            y[i] = active.dot(a + i * n, x, n);
+        }
+    }
+
+    void gemm(const float* a, const float* b, float* c, size_t m, size_t k, size_t n) {
+        std::fill(c, c + m * n, 0.0f);
+        if (m == 0 || n == 0 || k == 0) {
+            return;
+        }
+
+        // Each thread takes a band of whole row panels and packs its own blocks
+        size_t panels = (m + kTileRows - 1) / kTileRows;
+        size_t threads = m * n * k >= kThreadedWork ? std::min(threadLimit(), panels) : 1;
+        if (threads <= 1) {
+            gemmRows(a, b, c, k, n, 0, m);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        size_t rowBegin = 0;
+        for (size_t t = 0; t < threads; t++) {
+            size_t rowEnd = std::min(m, (panels * (t + 1) / threads) * kTileRows);
+            if (t + 1 < threads) {
+                workers.emplace_back(gemmRows, a, b, c, k, n, rowBegin, rowEnd);
+            } else {
+                gemmRows(a, b, c, k, n, rowBegin, rowEnd);
+            }
+            rowBegin = rowEnd;
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    const char* getImplementationName() {
+        return kernels().name;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef LINEAR_ALGEBRA_H
+#define LINEAR_ALGEBRA_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Dense single-precision kernels behind the dot, axpy, gemv and gemm
+ * builtins, and the int8 dot product behind quantized model layers.
+ * Matrices are row-major and tightly packed.
+ *
+ * Each kernel has an AVX2/FMA and a plain scalar version; the AVX2 one is
+ * picked once, the first time any kernel runs, if the CPU has it. gemm
+ * copies cache-sized blocks of its inputs into panels laid out in the order
+ * the inner kernel reads them, then sweeps 6x16 tiles of C held in
+ * registers across each panel. Large products are split by rows across
+ * threads. Sums are accumulated in different orders by the two versions,
+ * so their results can differ in the last bits.
+ */
+namespace LinearAlgebra {
+    // Sum of x[i] * y[i] over n elements
+    float dot(const float* x, const float* y, size_t n);
+
+    // Sum of x[i] * y[i] over n signed bytes, exact in 32 bits for n below 2^17;
+    // y must not hold -128
+    int32_t dotInt8(const int8_t* x, const int8_t* y, size_t n);
+
+    // y += alpha * x over n elements
+    void axpy(float alpha, const float* x, float* y, size_t n);
+
+    // y = A x for an m x n matrix A; y has m elements
+    void gemv(const float* a, const float* x, float* y, size_t m, size_t n);
+
+    // C = A B for an m x k matrix A and a k x n matrix B; c has m * n elements
+    void gemm(const float* a, const float* b, float* c, size_t m, size_t k, size_t n);
+
+    // Name of the kernel set in use: "avx2" or "scalar"
+    const char* getImplementationName();
+}
+
+#endif // LINEAR_ALGEBRA_H
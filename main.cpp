@@ -42,6 +42,7 @@ int runInteractive(FlareInterpreter& interpreter) {
         } else if (!line.empty()) {
             interpreter.loadScriptFromString(line);
             interpreter.run();
+            interpreter.resetScratch();
         }
     }
     
@@ -0,0 +1,83 @@
+#include "match_table.h"
+#include <algorithm>
+
+MatchTable::MatchTable() : m_defaultArm(kNoArm), m_denseBase(0) {
+}
+
+bool MatchTable::addInt(int key, uint32_t arm) {
+    for (const auto& entry : m_intKeys) {
+        if (entry.first == key) {
+            return false;
+        }
+    }
+    m_intKeys.emplace_back(key, arm);
+    return true;
+}
+
+bool MatchTable::addString(std::string key, uint32_t arm) {
+    for (const auto& entry : m_stringKeys) {
+        if (entry.first == key) {
+            return false;
+        }
+    }
+    m_stringKeys.emplace_back(std::move(key), arm);
+    return true;
+}
+
+bool MatchTable::build() {
+    if (!m_intKeys.empty()) {
+        auto [low, high] = std::minmax_element(m_intKeys.begin(), m_intKeys.end());
+        int64_t span = static_cast<int64_t>(high->first) - low->first + 1;
+
+        // A table at most a few times the number of keys, and no larger than 64K entries
+        int64_t limit = std::min<int64_t>(65536, static_cast<int64_t>(m_intKeys.size()) * 4 + 16);
+        if (span <= limit) {
+            m_denseBase = low->first;
+            m_dense.assign(static_cast<size_t>(span), m_defaultArm);
+            for (const auto& entry : m_intKeys) {
+                m_dense[static_cast<size_t>(entry.first - m_denseBase)] = entry.second;
+            }
+        } else {
+            std::vector<std::string> keys;
+            for (const auto& entry : m_intKeys) {
+                keys.push_back(std::to_string(entry.first));
+                m_sparseIntArms.push_back(entry.second);
+            }
+            if (!m_sparseInts.build(std::move(keys))) {
+                return false;
+            }
+        }
+    }
+
+    if (!m_stringKeys.empty()) {
+        std::vector<std::string> keys;
+        for (auto& entry : m_stringKeys) {
+            keys.push_back(std::move(entry.first));
+            m_stringArms.push_back(entry.second);
+        }
+        if (!m_strings.build(std::move(keys))) {
+            return false;
+        }
+    }
+    m_intKeys.clear();
+    m_stringKeys.clear();
+    return true;
+}
+
+uint32_t MatchTable::find(int value) const {
+    if (!m_dense.empty()) {
+        // One unsigned comparison covers values on either side of the table
+        uint64_t index = static_cast<uint64_t>(static_cast<int64_t>(value) - m_denseBase);
+        return index < m_dense.size() ? m_dense[index] : m_defaultArm;
+    }
+    if (m_sparseInts.size() > 0) {
+        size_t key = m_sparseInts.find(std::to_string(value));
+        return key != PerfectHash::npos ? m_sparseIntArms[key] : m_defaultArm;
+    }
+    return m_defaultArm;
+}
+
+uint32_t MatchTable::find(std::string_view value) const {
+    size_t key = m_strings.find(value);
+    return key != PerfectHash::npos ? m_stringArms[key] : m_defaultArm;
+}
@@ -0,0 +1,59 @@
+#ifndef MATCH_TABLE_H
+#define MATCH_TABLE_H
+
+#include "perfect_hash.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * The dispatch of a match statement, from the value matched to the arm that
+ * runs, in constant time whatever the number of arms. Integer keys within a
+ * small range go into a jump table indexed by the value; integer keys spread
+ * too thinly for one, and string keys, go into perfect hashes.
+ */
+class MatchTable {
+public:
+    static constexpr uint32_t kNoArm = UINT32_MAX;
+
+    MatchTable();
+
+    // Send key to arm; returns false if another arm already has the key
+    bool addInt(int key, uint32_t arm);
+    bool addString(std::string key, uint32_t arm);
+
+    // The arm for values no key matches
+    void setDefault(uint32_t arm) { m_defaultArm = arm; }
+
+    // Lay the keys out for lookup, once every key and the default are in;
+    // returns false if a perfect hash couldn't place them
+    bool build();
+
+    // The arm for a value, the default arm if no key matches, or kNoArm if there is no default
+    uint32_t find(int value) const;
+    uint32_t find(std::string_view value) const;
+
+    // Whether the integer keys went into a jump table
+    bool isDense() const { return !m_dense.empty(); }
+
+private:
+    std::vector<std::pair<int, uint32_t>> m_intKeys;
+    std::vector<std::pair<std::string, uint32_t>> m_stringKeys;
+    uint32_t m_defaultArm;
+
+    // Jump table: the arm of m_denseBase + i is m_dense[i]
+    int64_t m_denseBase;
+    std::vector<uint32_t> m_dense;
+
+    // Integer keys by their decimal text, when they don't fit a jump table
+    PerfectHash m_sparseInts;
+    std::vector<uint32_t> m_sparseIntArms;
+
+    PerfectHash m_strings;
+    std::vector<uint32_t> m_stringArms;
+};
+
+#endif // MATCH_TABLE_H
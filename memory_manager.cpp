@@ -1,5 +1,19 @@
 #include "memory_manager.h"
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <sys/mman.h>
+
+MemoryBlock::~MemoryBlock() {
+    if (pointer == nullptr) {
+        return;
+    }
+    if (isVirtual) {
+        munmap(pointer, size);
+    } else {
+        std::free(pointer);
+    }
+}
 
 MemoryManager::MemoryManager() : m_totalMemory(0) {
     // In a real system, we would determine the actual available system memory
@@ -10,8 +24,6 @@ MemoryManager::MemoryManager() : m_totalMemory(0) {
 MemoryManager::~MemoryManager() {
     // Free all allocated memory blocks
     for (auto& pair : m_memoryBlocks) {
-        // In a real implementation, we would free the actual memory here
-        // For now, we just print out that we're freeing memory
         std::cout << "Freeing memory block " << pair.first 
                   << " (" << pair.second->description << ")" << std::endl;
     }
@@ -38,10 +50,25 @@ bool MemoryManager::allocateMemoryInternal(const std::string& description, size_
         size = 1024; // 1 KB default
     }
 
-    // In a real implementation, we would allocate actual memory here
-    // For now, we just track the allocation
+    // Regular blocks are zeroed up front and cache-line aligned; virtual ones are
+    // reserved address space whose pages are only backed once they are touched
     void* pointer = nullptr;
-    // In a real implementation: pointer = malloc(size);
+    if (isVirtual) {
+        pointer = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (pointer == MAP_FAILED) {
+            pointer = nullptr;
+        }
+    } else {
+        const size_t alignment = 64;
+        pointer = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+        if (pointer != nullptr) {
+            std::memset(pointer, 0, size);
+        }
+    }
+    if (pointer == nullptr) {
+        std::cerr << "Could not allocate " << size << " bytes for memory ID " << id << std::endl;
+        return false;
+    }
 
     // Create and store the memory block
     auto block = std::make_shared<MemoryBlock>(id, description, size, isVirtual, pointer);
@@ -61,8 +88,7 @@ bool MemoryManager::freeMemory(int id, int mode) {
         return false;
     }
 
-    // In a real implementation, we would free the actual memory here
-    // For now, we just remove the block from our tracking
+    // The bytes go with the last holder of the block, normally right here
     std::cout << "Freeing " << (it->second->isVirtual ? "virtual" : "regular") 
               << " memory: ID=" << id << ", Description=" << it->second->description 
               << ", Mode=" << mode << std::endl;
@@ -83,6 +109,11 @@ bool MemoryManager::hasMemory(int id) const {
     return m_memoryBlocks.find(id) != m_memoryBlocks.end();
 }
 
+std::shared_ptr<MemoryBlock> MemoryManager::getBlock(int id) const {
+    auto it = m_memoryBlocks.find(id);
+    return it != m_memoryBlocks.end() ? it->second : nullptr;
+}
+
 size_t MemoryManager::getTotalMemory() const {
     return m_totalMemory;
 }
@@ -13,10 +13,14 @@ struct MemoryBlock {
     std::string description;
     size_t size;
     bool isVirtual;
-    void* pointer;  // In a real implementation, this would point to the actual memory
+    void* pointer;  // The block's zeroed bytes, released with the block
 
     MemoryBlock(int id, const std::string& desc, size_t sz, bool isVirt, void* ptr)
         : id(id), description(desc), size(sz), isVirtual(isVirt), pointer(ptr) {}
+    ~MemoryBlock();
+
+    MemoryBlock(const MemoryBlock&) = delete;
+    MemoryBlock& operator=(const MemoryBlock&) = delete;
 };
 
 class MemoryManager {
@@ -39,6 +43,10 @@ public:
     // Check if a memory block exists
     bool hasMemory(int id) const;
 
+    // The block with the given ID, or nullptr; holding it does not stop frmem from
+    // removing it, and the bytes are released once the last holder lets go
+    std::shared_ptr<MemoryBlock> getBlock(int id) const;
+
     // Get total available memory (simplified implementation)
     size_t getTotalMemory() const;
 
@@ -0,0 +1,330 @@
+#include "mlp_model.h"
+#include "linear_algebra.h"
+#include "text_index.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr char kModelMagic[8] = {'F', 'L', 'A', 'R', 'E', 'M', 'L', 'P'};
+    constexpr uint32_t kModelVersion = 1;
+    constexpr uint32_t kSoftmaxFlag = 1;
+
+    // Row strides are multiples of this, so kernels never see a ragged tail
+    constexpr size_t kStrideMultiple = 32;
+
+    // Larger layers than this are taken as a corrupt file
+    constexpr uint32_t kMaxWidth = 1u << 20;
+
+    // LinearAlgebra::dotInt8 is exact in 32 bits only for rows shorter than this
+    constexpr uint32_t kMaxInt8Stride = 1u << 17;
+}
+
+struct MlpModel::FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t layerCount;
+    uint32_t inputSize;
+    uint32_t outputSize;
+    uint32_t labelCount;
+    uint32_t flags;
+    uint64_t labelOffset;
+    uint64_t fileSize;
+    uint8_t reserved[16];
+};
+
+struct MlpModel::LayerHeader {
+    uint32_t inputs;
+    uint32_t outputs;
+    uint32_t stride;
+    uint8_t weightType;         // 0 fp32, 1 int8
+    uint8_t activation;         // 0 none, 1 relu
+    uint16_t reserved;
+    uint64_t weightOffset;
+    uint64_t scaleOffset;       // int8 layers only
+    uint64_t biasOffset;
+};
+
+MlpModel::MlpModel()
+    : m_base(nullptr), m_mappedBytes(0), m_inputSize(0), m_outputSize(0), m_softmax(false) {
+}
+
+MlpModel::~MlpModel() {
+    close();
+}
+
+bool MlpModel::fail(const std::string& message) {
+    close();
+    m_lastError = message;
+    if (errno != 0) {
+        m_lastError += std::string(" (") + std::strerror(errno) + ")";
+    }
+    return false;
+}
+
+bool MlpModel::load(const std::string& path) {
+    static_assert(sizeof(FileHeader) == 64 && sizeof(LayerHeader) == 40, "model file layout");
+    close();
+    errno = 0;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return fail("Cannot open model file '" + path + "'");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(FileHeader)) {
+        ::close(fd);
+        return fail("'" + path + "' is not a model file");
+    }
+    m_base = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (m_base == MAP_FAILED) {
+        m_base = nullptr;
+        return fail("Cannot map model file '" + path + "'");
+    }
+    m_mappedBytes = info.st_size;
+    errno = 0;
+
+    const char* base = static_cast<const char*>(m_base);
+    size_t size = m_mappedBytes;
+    // Whether bytes at offset lie inside the file, starting on an alignment boundary
+    auto fits = [&](uint64_t offset, uint64_t bytes, uint64_t alignment) {
+        return offset % alignment == 0 && offset <= size && bytes <= size - offset;
+    };
+
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+    if (std::memcmp(header->magic, kModelMagic, sizeof(kModelMagic)) != 0) {
+        return fail("'" + path + "' is not a model file");
+    }
+    if (header->version != kModelVersion) {
+        return fail("Model file '" + path + "' has unsupported version " + std::to_string(header->version));
+    }
+    if (header->fileSize != size || header->layerCount == 0 ||
+        !fits(sizeof(FileHeader), uint64_t(header->layerCount) * sizeof(LayerHeader), 8)) {
+        return fail("Model file '" + path + "' is truncated or corrupt");
+    }
+
+    // Each layer must take what the one before it gives, and its arrays must fit
+    const LayerHeader* layers = reinterpret_cast<const LayerHeader*>(base + sizeof(FileHeader));
+    size_t width = header->inputSize;
+    for (uint32_t i = 0; i < header->layerCount; i++) {
+        const LayerHeader& entry = layers[i];
+        std::string where = "Layer " + std::to_string(i) + " of model file '" + path + "'";
+        if (entry.inputs != width || entry.outputs == 0 || entry.outputs > kMaxWidth || entry.inputs > kMaxWidth ||
+            entry.stride < entry.inputs || entry.stride % kStrideMultiple != 0 || entry.stride > kMaxWidth ||
+            entry.weightType > 1 || entry.activation > 1) {
+            return fail(where + " has inconsistent sizes or types");
+        }
+        if (entry.weightType == 1 && entry.stride >= kMaxInt8Stride) {
+            return fail(where + " is too wide for int8 weights (stride " + std::to_string(entry.stride) +
+                        ", limit " + std::to_string(kMaxInt8Stride - kStrideMultiple) + ")");
+        }
+
+        Layer layer;
+        layer.inputs = entry.inputs;
+        layer.outputs = entry.outputs;
+        layer.stride = entry.stride;
+        layer.quantized = entry.weightType == 1;
+        layer.relu = entry.activation == 1;
+        layer.weights = nullptr;
+        layer.weightsInt8 = nullptr;
+        layer.scales = nullptr;
+
+        uint64_t elements = uint64_t(entry.outputs) * entry.stride;
+        uint64_t weightBytes = elements * (layer.quantized ? sizeof(int8_t) : sizeof(float));
+        if (!fits(entry.weightOffset, weightBytes, 32) ||
+            !fits(entry.biasOffset, uint64_t(entry.outputs) * sizeof(float), sizeof(float)) ||
+            (layer.quantized && !fits(entry.scaleOffset, uint64_t(entry.outputs) * sizeof(float), sizeof(float)))) {
+            return fail(where + " points outside the file");
+        }
+        if (layer.quantized) {
+            layer.weightsInt8 = reinterpret_cast<const int8_t*>(base + entry.weightOffset);
+            layer.scales = reinterpret_cast<const float*>(base + entry.scaleOffset);
+        } else {
+            layer.weights = reinterpret_cast<const float*>(base + entry.weightOffset);
+        }
+        layer.bias = reinterpret_cast<const float*>(base + entry.biasOffset);
+        m_layers.push_back(layer);
+        width = entry.outputs;
+    }
+    if (width != header->outputSize || header->inputSize == 0) {
+        return fail("Model file '" + path + "' has inconsistent input or output sizes");
+    }
+
+    // Labels are optional, one per output
+    if (header->labelCount != 0) {
+        if (header->labelCount != header->outputSize || header->labelOffset >= size) {
+            return fail("Model file '" + path + "' has a bad label table");
+        }
+        size_t pos = header->labelOffset;
+        for (uint32_t i = 0; i < header->labelCount; i++) {
+            const void* end = std::memchr(base + pos, '\0', size - pos);
+            if (end == nullptr) {
+                return fail("Model file '" + path + "' has a bad label table");
+            }
+            size_t length = static_cast<const char*>(end) - (base + pos);
+            m_labels.emplace_back(base + pos, length);
+            pos += length + 1;
+        }
+    }
+
+    m_inputSize = header->inputSize;
+    m_outputSize = header->outputSize;
+    m_softmax = (header->flags & kSoftmaxFlag) != 0;
+    return true;
+}
+
+void MlpModel::close() {
+    if (m_base != nullptr) {
+        munmap(m_base, m_mappedBytes);
+    }
+    m_base = nullptr;
+    m_mappedBytes = 0;
+    m_layers.clear();
+    m_labels.clear();
+    m_inputSize = 0;
+    m_outputSize = 0;
+    m_softmax = false;
+}
+
+void MlpModel::forward(const float* inputs, size_t batch, float* outputs) {
+    if (m_layers.empty() || batch == 0) {
+        return;
+    }
+
+    // The first layer reads rows padded to its stride, so the inputs are copied in
+    size_t stride = m_layers[0].stride;
+    m_in.assign(batch * stride, 0.0f);
+    for (size_t s = 0; s < batch; s++) {
+        std::copy(inputs + s * m_inputSize, inputs + (s + 1) * m_inputSize, m_in.begin() + s * stride);
+    }
+
+    for (size_t i = 0; i < m_layers.size(); i++) {
+        if (i + 1 == m_layers.size()) {
+            runLayer(m_layers[i], m_in.data(), batch, outputs, m_outputSize);
+            break;
+        }
+        size_t nextStride = m_layers[i + 1].stride;
+        m_out.assign(batch * nextStride, 0.0f);
+        runLayer(m_layers[i], m_in.data(), batch, m_out.data(), nextStride);
+        std::swap(m_in, m_out);
+    }
+
+    if (m_softmax) {
+        for (size_t s = 0; s < batch; s++) {
+            float* row = outputs + s * m_outputSize;
+            float largest = *std::max_element(row, row + m_outputSize);
+            float sum = 0.0f;
+            for (size_t j = 0; j < m_outputSize; j++) {
+                row[j] = std::exp(row[j] - largest);
+                sum += row[j];
+            }
+            for (size_t j = 0; j < m_outputSize; j++) {
+                row[j] /= sum;
+            }
+        }
+    }
+}
+
+void MlpModel::runLayer(const Layer& layer, const float* in, size_t batch, float* out, size_t outStride) {
+    if (!layer.quantized) {
+        for (size_t r = 0; r < layer.outputs; r++) {
+            const float* row = layer.weights + r * layer.stride;
+            for (size_t s = 0; s < batch; s++) {
+                float value = LinearAlgebra::dot(row, in + s * layer.stride, layer.stride) + layer.bias[r];
+                out[s * outStride + r] = layer.relu ? std::max(value, 0.0f) : value;
+            }
+        }
+        return;
+    }
+
+    // Quantize each sample against its own largest magnitude; padding stays zero
+    m_quantized.resize(batch * layer.stride);
+    m_inputScales.resize(batch);
+    for (size_t s = 0; s < batch; s++) {
+        const float* sample = in + s * layer.stride;
+        float largest = 0.0f;
+        for (size_t j = 0; j < layer.inputs; j++) {
+            largest = std::max(largest, std::fabs(sample[j]));
+        }
+        float scale = largest > 0.0f ? largest / 127.0f : 1.0f;
+        float inverse = 1.0f / scale;
+        int8_t* quantized = m_quantized.data() + s * layer.stride;
+        for (size_t j = 0; j < layer.stride; j++) {
+            long value = std::lrint(sample[j] * inverse);
+            quantized[j] = static_cast<int8_t>(std::clamp(value, -127L, 127L));
+        }
+        m_inputScales[s] = scale;
+    }
+
+    for (size_t r = 0; r < layer.outputs; r++) {
+        const int8_t* row = layer.weightsInt8 + r * layer.stride;
+        float rowScale = layer.scales[r];
+        for (size_t s = 0; s < batch; s++) {
+            int32_t sum = LinearAlgebra::dotInt8(row, m_quantized.data() + s * layer.stride, layer.stride);
+            float value = static_cast<float>(sum) * rowScale * m_inputScales[s] + layer.bias[r];
+            out[s * outStride + r] = layer.relu ? std::max(value, 0.0f) : value;
+        }
+    }
+}
+
+size_t MlpModel::classify(const float* input) {
+    std::vector<float> outputs(m_outputSize);
+    forward(input, 1, outputs.data());
+    return std::max_element(outputs.begin(), outputs.end()) - outputs.begin();
+}
+
+void MlpModel::textFeatures(std::string_view text, float* features) const {
+    std::fill(features, features + m_inputSize, 0.0f);
+    if (m_inputSize == 0) {
+        return;
+    }
+
+    // Terms as the text index splits them, each hashed (32-bit FNV-1a) into a bucket
+    std::vector<std::string> terms;
+    TextIndex::tokenize(text, terms);
+    for (const auto& term : terms) {
+        uint32_t hash = 2166136261u;
+        for (char c : term) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 16777619u;
+        }
+        features[hash % m_inputSize] += 1.0f;
+    }
+
+    float norm = 0.0f;
+    for (size_t j = 0; j < m_inputSize; j++) {
+        norm += features[j] * features[j];
+    }
+    if (norm > 0.0f) {
+        float inverse = 1.0f / std::sqrt(norm);
+        for (size_t j = 0; j < m_inputSize; j++) {
+            features[j] *= inverse;
+        }
+    }
+}
+
+size_t MlpModel::getInputSize() const {
+    return m_inputSize;
+}
+
+size_t MlpModel::getOutputSize() const {
+    return m_outputSize;
+}
+
+size_t MlpModel::getLayerCount() const {
+    return m_layers.size();
+}
+
+std::string_view MlpModel::getLabel(size_t output) const {
+    return output < m_labels.size() ? m_labels[output] : std::string_view();
+}
+
+const std::string& MlpModel::getLastError() const {
+    return m_lastError;
+}
@@ -0,0 +1,113 @@
+#ifndef MLP_MODEL_H
+#define MLP_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * A small multilayer perceptron loaded from a model file, for classifying
+ * script input such as chat messages.
+ *
+ * The file is mapped read-only and used where it lies: loading checks that
+ * the header, layer table and every array fit the file and agree with each
+ * other, then points at them, so nothing is parsed or copied whatever the
+ * model's size. All numbers are little-endian. The file holds:
+ *
+ *   header (64 bytes)    "FLAREMLP", version 1, layer count, input and
+ *                        output sizes, label count, flags (bit 0: softmax
+ *                        over the outputs), offset of the labels, file size
+ *   layers (40 each)     inputs, outputs, row stride, weight type (0 fp32,
+ *                        1 int8), activation (0 none, 1 relu), and offsets
+ *                        of the weights, the per-row int8 scales and the
+ *                        biases
+ *   arrays               weights as outputs rows of stride elements, the
+ *                        stride being inputs rounded up to a multiple of 32
+ *                        and the padding zero; weights start on 32-byte
+ *                        boundaries, scales and biases on 4-byte ones
+ *   labels               label count NUL-terminated names, one per output
+ *
+ * An int8 layer scales each row of weights by its own factor. Its inputs
+ * are quantized to int8 per sample on the fly, with a scale taken from the
+ * sample's largest magnitude, so every output is one int8 dot product
+ * times two scales plus the bias. A batch is run one layer at a time with
+ * each row of weights applied to every sample while it is in cache.
+ */
+class MlpModel {
+public:
+    MlpModel();
+    ~MlpModel();
+
+    MlpModel(const MlpModel&) = delete;
+    MlpModel& operator=(const MlpModel&) = delete;
+
+    // Map and check a model file, replacing any model loaded before
+    bool load(const std::string& path);
+
+    // Unmap the model file
+    void close();
+
+    // Run batch samples of getInputSize() floats each through the model, writing
+    // getOutputSize() floats per sample to outputs
+    void forward(const float* inputs, size_t batch, float* outputs);
+
+    // Index of the largest output for one sample
+    size_t classify(const float* input);
+
+    // Fill getInputSize() floats with the hashed, length-normalized term counts of text,
+    // the input the bundled text models are trained on
+    void textFeatures(std::string_view text, float* features) const;
+
+    size_t getInputSize() const;
+    size_t getOutputSize() const;
+    size_t getLayerCount() const;
+
+    // Name of an output, or an empty string if the model has no labels
+    std::string_view getLabel(size_t output) const;
+
+    // Description of the last failure
+    const std::string& getLastError() const;
+
+private:
+    struct FileHeader;
+    struct LayerHeader;
+
+    // A layer's arrays, pointing into the mapping
+    struct Layer {
+        size_t inputs;
+        size_t outputs;
+        size_t stride;
+        bool quantized;
+        bool relu;
+        const float* weights;           // fp32 layers
+        const int8_t* weightsInt8;      // int8 layers
+        const float* scales;            // int8 layers
+        const float* bias;
+    };
+
+    std::string m_lastError;
+    void* m_base;
+    size_t m_mappedBytes;
+    std::vector<Layer> m_layers;
+    std::vector<std::string_view> m_labels;
+    size_t m_inputSize;
+    size_t m_outputSize;
+    bool m_softmax;
+
+    // Scratch reused across calls: activations in and out of a layer, quantized inputs
+    std::vector<float> m_in;
+    std::vector<float> m_out;
+    std::vector<int8_t> m_quantized;
+    std::vector<float> m_inputScales;
+
+    // Set the error message, unmap, and return false
+    bool fail(const std::string& message);
+
+    // Apply one layer to batch rows of in (stride layer.stride), writing outputs
+    // to rows of out spaced outStride apart
+    void runLayer(const Layer& layer, const float* in, size_t batch, float* out, size_t outStride);
+};
+
+#endif // MLP_MODEL_H
@@ -0,0 +1,81 @@
+#ifndef PACKED_LIST_H
+#define PACKED_LIST_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+ * The items of a list of one type, stored contiguously in a buffer that
+ * copies of the list share: plain ints, floats or strings for packed lists,
+ * boxed Variables for any other.
+ *
+ * Copying a list or slicing it only takes another reference to the buffer,
+ * so indexing, length and slices are O(1) and reading a list, however long,
+ * never allocates. A list is a window of the buffer; changing a list that
+ * shares its buffer first copies the window into a buffer of its own.
+ */
+template <typename T>
+class PackedList {
+public:
+    PackedList() : m_offset(0), m_length(0) {}
+
+    explicit PackedList(std::vector<T> items)
+        : m_items(std::make_shared<std::vector<T>>(std::move(items))), m_offset(0), m_length(m_items->size()) {}
+
+    size_t size() const { return m_length; }
+    bool empty() const { return m_length == 0; }
+
+    // The items, contiguous; nullptr for a list that never had any
+    const T* data() const { return m_items ? m_items->data() + m_offset : nullptr; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + m_length; }
+
+    // Item at index, which must be below size()
+    const T& operator[](size_t index) const { return (*m_items)[m_offset + index]; }
+
+    // Items [start, end) as a list sharing this one's buffer; bounds are clamped to the list
+    PackedList slice(size_t start, size_t end) const {
+        PackedList view = *this;
+        end = end < m_length ? end : m_length;
+        start = start < end ? start : end;
+        view.m_offset = m_offset + start;
+        view.m_length = end - start;
+        return view;
+    }
+
+    // Replace the item at index, which must be below size()
+    void set(size_t index, T item) {
+        if (m_items.use_count() != 1) {
+            detach(m_length);
+        }
+        (*m_items)[m_offset + index] = std::move(item);
+    }
+
+    void push_back(T item) {
+        if (!m_items || m_items.use_count() != 1) {
+            detach(m_length + m_length / 2 + 1);
+        } else if (m_offset + m_length != m_items->size()) {
+            // Sole owner of a slice: whatever lies past it is unreachable
+            m_items->resize(m_offset + m_length);
+        }
+        m_items->push_back(std::move(item));
+        m_length++;
+    }
+
+private:
+    std::shared_ptr<std::vector<T>> m_items;
+    size_t m_offset;
+    size_t m_length;
+
+    // Move this list's items to a buffer of its own; the other holders keep the old one
+    void detach(size_t capacity) {
+        auto items = std::make_shared<std::vector<T>>();
+        items->reserve(capacity);
+        items->assign(begin(), end());
+        m_items = std::move(items);
+        m_offset = 0;
+    }
+};
+
+#endif // PACKED_LIST_H
@@ -9,14 +9,17 @@ Parser::Parser() {
 Parser::~Parser() {
 }
 
-std::tuple<std::string, std::vector<std::string>> Parser::parseLine(const std::string& line) {
+std::tuple<std::string, ArgList> Parser::parseLine(const std::string& line,
+                                                  std::pmr::memory_resource* resource) {
     std::string trimmedLine = trim(line);
     
     // Handle variable assignments
     if (isVariableDeclaration(trimmedLine)) {
         auto [type, name, value] = parseVariableDeclaration(trimmedLine);
         std::string fullName = type + "." + name;
-        return {fullName, {value}};
+        ArgList args(resource);
+        args.push_back(std::move(value));
+        return {fullName, std::move(args)};
     }
     
     // Handle functions and commands with parenthesized arguments
@@ -26,21 +29,21 @@ std::tuple<std::string, std::vector<std::string>> Parser::parseLine(const std::s
         if (closeParen != std::string::npos) {
             std::string command = trim(trimmedLine.substr(0, openParen));
             std::string argsStr = trimmedLine.substr(openParen + 1, closeParen - openParen - 1);
-            std::vector<std::string> args = parseParenthesizedArgs(argsStr);
-            return {command, args};
+            ArgList args = parseParenthesizedArgs(argsStr, resource);
+            return {command, std::move(args)};
         }
     }
     
     // Handle normal commands with space-separated arguments
-    std::vector<std::string> tokens = splitByWhitespace(trimmedLine);
+    ArgList tokens = splitByWhitespace(trimmedLine, resource);
     if (tokens.empty()) {
-        return {"", {}};
+        return {"", ArgList(resource)};
     }
     
-    std::string command = tokens[0];
-    std::vector<std::string> args(tokens.begin() + 1, tokens.end());
+    std::string command = std::move(tokens[0]);
+    tokens.erase(tokens.begin());
     
-    return {command, args};
+    return {command, std::move(tokens)};
 }
 
 std::tuple<std::string, std::string, std::string> Parser::parseVariableDeclaration(const std::string& line) {
@@ -66,7 +69,23 @@ std::tuple<std::string, std::string, std::string> Parser::parseVariableDeclarati
 
 bool Parser::isVariableDeclaration(const std::string& line) const {
     // Check if the line contains an equals sign
-    return line.find('=') != std::string::npos;
+    size_t equalsPos = line.find('=');
+    if (equalsPos == std::string::npos) {
+        return false;
+    }
+    
+    // The left side must be a single target such as "str.name" or "x";
+    // commands like `fmem.write "c" "k" "v" ttl=5` or `f(a = 1)` only carry an '=' in an argument
+    std::string lhs = trim(line.substr(0, equalsPos));
+    int bracketDepth = 0;
+    for (char c : lhs) {
+        if (c == '[') bracketDepth++;
+        if (c == ']') bracketDepth--;
+        if (c == '(' || c == '"' || (bracketDepth == 0 && std::isspace(static_cast<unsigned char>(c)))) {
+            return false;
+        }
+    }
+    return !lhs.empty();
 }
 
 bool Parser::isMemoryCommand(const std::string& line) const {
@@ -76,16 +95,247 @@ bool Parser::isMemoryCommand(const std::string& line) const {
            trimmedLine.find("frmem(") == 0;
 }
 
-std::vector<std::string> Parser::splitByWhitespace(const std::string& str) const {
-    std::vector<std::string> tokens;
-    std::istringstream iss(str);
-    std::string token;
-    while (iss >> token) {
-        tokens.push_back(token);
+ArgList Parser::splitByWhitespace(const std::string& str, std::pmr::memory_resource* resource) const {
+    ArgList tokens(resource);
+    size_t i = 0;
+    while (i < str.size()) {
+        while (i < str.size() && std::isspace(static_cast<unsigned char>(str[i]))) {
+            i++;
+        }
+        size_t start = i;
+        bool inQuotes = false;
+        int bracketDepth = 0;
+        while (i < str.size() && (inQuotes || bracketDepth > 0 || !std::isspace(static_cast<unsigned char>(str[i])))) {
+            // Quoted strings and [list, literals] stay one token, spaces included
+            if (str[i] == '"') {
+                inQuotes = !inQuotes;
+            } else if (!inQuotes && str[i] == '[') {
+                bracketDepth++;
+            } else if (!inQuotes && str[i] == ']' && bracketDepth > 0) {
+                bracketDepth--;
+            }
+            i++;
+        }
+        if (i > start) {
+            tokens.emplace_back(str, start, i - start);
+        }
     }
     return tokens;
 }
 
+size_t Parser::findClosingParen(const std::string& str, size_t openParen) const {
+    bool inQuotes = false;
+    int depth = 0;
+    for (size_t i = openParen; i < str.size(); i++) {
+        char c = str[i];
+        if (c == '"') {
+            inQuotes = !inQuotes;
+        } else if (!inQuotes && c == '(') {
+            depth++;
+        } else if (!inQuotes && c == ')' && --depth == 0) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+bool Parser::isCallExpression(const std::string& expr) const {
+    std::string trimmed = trim(expr);
+    size_t i = 0;
+    
+    // name(args), optionally chained as name(args).method(args)
+    while (true) {
+        size_t nameStart = i;
+        while (i < trimmed.size() && (std::isalnum(static_cast<unsigned char>(trimmed[i])) ||
+                                      trimmed[i] == '_' || trimmed[i] == '.')) {
+            i++;
+        }
+        if (i == nameStart || i >= trimmed.size() || trimmed[i] != '(') {
+            return false;
+        }
+        
+        i = findClosingParen(trimmed, i);
+        if (i == std::string::npos) {
+            return false;
+        }
+        
+        // The call must end the expression, or be followed by another call on its result
+        if (++i == trimmed.size()) {
+            return true;
+        }
+        if (trimmed[i] != '.') {
+            return false;
+        }
+        i++;
+    }
+}
+
+bool Parser::isIndexExpression(const std::string& expr) const {
+    std::string trimmed = trim(expr);
+    if (trimmed.empty() || !(std::isalpha(static_cast<unsigned char>(trimmed[0])) || trimmed[0] == '_')) {
+        return false;
+    }
+    
+    size_t i = 0;
+    while (i < trimmed.size() && (std::isalnum(static_cast<unsigned char>(trimmed[i])) ||
+                                  trimmed[i] == '_' || trimmed[i] == '.')) {
+        i++;
+    }
+    if (i >= trimmed.size() || trimmed[i] != '[') {
+        return false;
+    }
+    
+    // The bracket opened after the name must be the one that ends the expression
+    bool inQuotes = false;
+    int depth = 0;
+    for (; i < trimmed.size(); i++) {
+        char c = trimmed[i];
+        if (c == '"') {
+            inQuotes = !inQuotes;
+        } else if (!inQuotes && c == '[') {
+            depth++;
+        } else if (!inQuotes && c == ']' && --depth == 0) {
+            return i == trimmed.size() - 1;
+        }
+    }
+    return false;
+}
+
+size_t Parser::findOperator(const std::string& expr, std::string_view ops) const {
+    bool inQuotes = false;
+    int depth = 0;
+    size_t last = std::string::npos;
+    for (size_t i = 0; i < expr.size(); i++) {
+        char c = expr[i];
+        if (c == '"') {
+            inQuotes = !inQuotes;
+        } else if (inQuotes) {
+            continue;
+        } else if (c == '(' || c == '[' || c == '{') {
+            depth++;
+        } else if (c == ')' || c == ']' || c == '}') {
+            depth--;
+        } else if (depth == 0 && i > 0 && i + 1 < expr.size() && ops.find(c) != std::string_view::npos &&
+                   std::isspace(static_cast<unsigned char>(expr[i - 1])) &&
+                   std::isspace(static_cast<unsigned char>(expr[i + 1]))) {
+            last = i;
+        }
+    }
+    return last;
+}
+
+bool Parser::parseIndexAssignment(const std::string& line, std::string& target, std::string& value) const {
+    // The target runs to the ']' closing its first '['; what follows must be a lone '='
+    size_t openBracket = line.find('[');
+    if (openBracket == std::string::npos) {
+        return false;
+    }
+    bool inQuotes = false;
+    int depth = 0;
+    size_t closeBracket = std::string::npos;
+    for (size_t i = openBracket; i < line.size() && closeBracket == std::string::npos; i++) {
+        char c = line[i];
+        if (c == '"') {
+            inQuotes = !inQuotes;
+        } else if (!inQuotes && c == '[') {
+            depth++;
+        } else if (!inQuotes && c == ']' && --depth == 0) {
+            closeBracket = i;
+        }
+    }
+    if (closeBracket == std::string::npos) {
+        return false;
+    }
+    
+    size_t equalsPos = line.find_first_not_of(" \t", closeBracket + 1);
+    if (equalsPos == std::string::npos || line[equalsPos] != '=' ||
+        (equalsPos + 1 < line.size() && line[equalsPos + 1] == '=')) {
+        return false;
+    }
+    std::string lhs = line.substr(0, closeBracket + 1);
+    if (!isIndexExpression(lhs)) {
+        return false;
+    }
+    target = trim(lhs);
+    value = trim(line.substr(equalsPos + 1));
+    return true;
+}
+
+bool Parser::parseListLiteral(const std::string& str, ArgList& items) const {
+    size_t begin = str.find_first_not_of(" \t");
+    size_t end = str.find_last_not_of(" \t");
+    if (begin == std::string::npos || str[begin] != '[' || str[end] != ']') {
+        return false;
+    }
+    
+    // Split on top-level commas; commas inside quotes or nested lists and maps belong to the item
+    bool inQuotes = false;
+    int bracketDepth = 0;
+    size_t itemStart = begin + 1;
+    for (size_t i = begin + 1; i <= end; i++) {
+        char c = str[i];
+        if (c == '"') {
+            inQuotes = !inQuotes;
+        } else if (!inQuotes && (c == '[' || c == '{')) {
+            bracketDepth++;
+        } else if (!inQuotes && c == '}') {
+            bracketDepth--;
+        } else if (!inQuotes && ((c == ']' && bracketDepth-- == 0) || (c == ',' && bracketDepth == 0))) {
+            size_t first = str.find_first_not_of(" \t", itemStart);
+            size_t last = str.find_last_not_of(" \t", i - 1);
+            if (first != std::string::npos && first < i && last >= first) {
+                items.emplace_back(str, first, last - first + 1);
+            } else if (c == ',') {
+                items.emplace_back();
+            }
+            itemStart = i + 1;
+        }
+    }
+    return true;
+}
+
+bool Parser::parseMapLiteral(const std::string& str, ArgList& keys, ArgList& values) const {
+    size_t begin = str.find_first_not_of(" \t");
+    size_t end = str.find_last_not_of(" \t");
+    if (begin == std::string::npos || str[begin] != '{' || str[end] != '}') {
+        return false;
+    }
+    
+    // Entries end at top-level commas and split at their first top-level colon
+    bool inQuotes = false;
+    int depth = 0;
+    size_t entryStart = begin + 1;
+    size_t colon = std::string::npos;
+    for (size_t i = begin + 1; i <= end; i++) {
+        char c = str[i];
+        if (c == '"') {
+            inQuotes = !inQuotes;
+        } else if (inQuotes) {
+            continue;
+        } else if (c == '[' || c == '{') {
+            depth++;
+        } else if ((c == ']' || c == '}') && depth > 0) {
+            depth--;
+        } else if (c == ':' && depth == 0 && colon == std::string::npos) {
+            colon = i;
+        } else if ((c == ',' || i == end) && depth == 0) {
+            std::string entry = trim(str.substr(entryStart, i - entryStart));
+            if (colon == std::string::npos) {
+                // Only the last entry may be empty, as in {} or a trailing comma
+                if (!entry.empty() || c == ',') {
+                    return false;
+                }
+            } else {
+                keys.push_back(trim(str.substr(entryStart, colon - entryStart)));
+                values.push_back(trim(str.substr(colon + 1, i - colon - 1)));
+            }
+            entryStart = i + 1;
+            colon = std::string::npos;
+        }
+    }
+    return true;
+}
+
 std::vector<std::string> Parser::split(const std::string& str, char delimiter) const {
     std::vector<std::string> tokens;
     std::stringstream ss(str);
@@ -108,8 +358,8 @@ std::string Parser::trim(const std::string& str) const {
     return (start < end) ? std::string(start, end) : std::string();
 }
 
-std::vector<std::string> Parser::parseParenthesizedArgs(const std::string& argsStr) const {
-    std::vector<std::string> args;
+ArgList Parser::parseParenthesizedArgs(const std::string& argsStr, std::pmr::memory_resource* resource) const {
+    ArgList args(resource);
     std::string currentArg;
     bool inQuotes = false;
     int nestedParenCount = 0;
@@ -121,11 +371,11 @@ std::vector<std::string> Parser::parseParenthesizedArgs(const std::string& argsS
             inQuotes = !inQuotes;
             currentArg += c;
         }
-        else if (c == '(' && !inQuotes) {
+        else if ((c == '(' || c == '[') && !inQuotes) {
             nestedParenCount++;
             currentArg += c;
         }
-        else if (c == ')' && !inQuotes) {
+        else if ((c == ')' || c == ']') && !inQuotes) {
             nestedParenCount--;
             currentArg += c;
         }
@@ -2,8 +2,13 @@
 #define PARSER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <tuple>
+#include <memory_resource>
+
+// Command arguments; backed by the interpreter's scratch arena while a statement runs
+using ArgList = std::pmr::vector<std::string>;
 
 class Parser {
 public:
@@ -11,7 +16,8 @@ public:
     ~Parser();
 
     // Parse a line of Flare code and return the command and its arguments
-    std::tuple<std::string, std::vector<std::string>> parseLine(const std::string& line);
+    std::tuple<std::string, ArgList> parseLine(const std::string& line,
+                                               std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     // Parse a variable declaration statement (for static mode)
     std::tuple<std::string, std::string, std::string> parseVariableDeclaration(const std::string& line);
@@ -22,18 +28,46 @@ public:
     // Check if a line is a memory management command
     bool isMemoryCommand(const std::string& line) const;
 
+    // Parse arguments for commands that take parenthesized arguments
+    ArgList parseParenthesizedArgs(const std::string& argsStr, std::pmr::memory_resource* resource) const;
+
+    // Position of the ')' matching the '(' at openParen, skipping quoted text, or npos
+    size_t findClosingParen(const std::string& str, size_t openParen) const;
+
+    // Check if an expression is a single call such as f(x), text.contains("a") or
+    // regex("a+").match(x), with nothing after it
+    bool isCallExpression(const std::string& expr) const;
+
+    // Check if an expression indexes or slices a name, such as data[i] or data[1:3],
+    // with nothing after it
+    bool isIndexExpression(const std::string& expr) const;
+
+    // Position of the last binary operator among ops in an expression such as a - b + c,
+    // standing between spaces outside quotes, brackets and parentheses, or npos. Given the
+    // operators of one precedence level, splitting there groups them from the left.
+    size_t findOperator(const std::string& expr, std::string_view ops) const;
+
+    // Split an assignment to an item, such as m["key"] = value or data[i] = value, into
+    // its target and value; returns false if line is anything else
+    bool parseIndexAssignment(const std::string& line, std::string& target, std::string& value) const;
+
+    // Split a list literal such as [a, "b, c", d] into its items (quotes are kept);
+    // returns false if str is not a list literal
+    bool parseListLiteral(const std::string& str, ArgList& items) const;
+
+    // Split a map literal such as {"a": 1, b: [2, 3]} into its keys and values (quotes are
+    // kept); returns false if str is not a map literal
+    bool parseMapLiteral(const std::string& str, ArgList& keys, ArgList& values) const;
+
 private:
     // Split a string by whitespace
-    std::vector<std::string> splitByWhitespace(const std::string& str) const;
+    ArgList splitByWhitespace(const std::string& str, std::pmr::memory_resource* resource) const;
 
     // Split a string by a delimiter
     std::vector<std::string> split(const std::string& str, char delimiter) const;
 
     // Trim whitespace from a string
     std::string trim(const std::string& str) const;
-
-    // Parse arguments for commands that take parenthesized arguments
-    std::vector<std::string> parseParenthesizedArgs(const std::string& argsStr) const;
 };
 
 #endif // PARSER_H
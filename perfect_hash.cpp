@@ -0,0 +1,122 @@
+#include "perfect_hash.h"
+#include <algorithm>
+#include <unordered_set>
+
+PerfectHash::PerfectHash() : m_seed(0) {
+}
+
+bool PerfectHash::build(std::vector<std::string> keys) {
+    m_keys = std::move(keys);
+    m_displacements.clear();
+    m_slots.clear();
+    if (m_keys.empty()) {
+        return true;
+    }
+
+    std::unordered_set<std::string_view> seen;
+    for (const auto& key : m_keys) {
+        if (!seen.insert(key).second) {
+            m_keys.clear();
+            return false;
+        }
+    }
+
+    // Half the slots stay empty and buckets hold two keys on average, so a free
+    // displacement is found within a few tries
+    size_t slotCount = 2;
+    while (slotCount < m_keys.size() * 2) {
+        slotCount *= 2;
+    }
+    m_slots.assign(slotCount, kEmpty);
+    m_displacements.assign(std::max<size_t>(1, m_keys.size() / 2), 0);
+
+    // Distinct keys only fail to place if their whole hashes collide, which another seed undoes
+    for (uint64_t attempt = 0; attempt < 64; attempt++) {
+        m_seed = attempt * 0x9E3779B97F4A7C15ull;
+        if (place()) {
+            return true;
+        }
+    }
+    m_keys.clear();
+    m_displacements.clear();
+    m_slots.clear();
+    return false;
+}
+
+bool PerfectHash::place() {
+    std::fill(m_slots.begin(), m_slots.end(), kEmpty);
+    std::fill(m_displacements.begin(), m_displacements.end(), 0);
+
+    std::vector<std::vector<uint32_t>> buckets(m_displacements.size());
+    std::vector<uint64_t> hashes(m_keys.size());
+    for (size_t i = 0; i < m_keys.size(); i++) {
+        hashes[i] = hash(m_keys[i], m_seed);
+        buckets[bucketOf(hashes[i])].push_back(static_cast<uint32_t>(i));
+    }
+
+    // The fullest buckets are placed first, while most slots are still free
+    std::vector<uint32_t> order(buckets.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    std::vector<size_t> taken;
+    for (uint32_t bucket : order) {
+        const std::vector<uint32_t>& members = buckets[bucket];
+        if (members.empty()) {
+            break;
+        }
+        bool placed = false;
+        for (uint32_t displacement = 0; !placed && displacement < m_slots.size() * 4; displacement++) {
+            taken.clear();
+            placed = true;
+            for (uint32_t key : members) {
+                size_t slot = slotOf(hashes[key], displacement);
+                if (m_slots[slot] != kEmpty || std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+                    placed = false;
+                    break;
+                }
+                taken.push_back(slot);
+            }
+            if (placed) {
+                m_displacements[bucket] = displacement;
+                for (size_t i = 0; i < members.size(); i++) {
+                    m_slots[taken[i]] = members[i];
+                }
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t PerfectHash::find(std::string_view key) const {
+    if (m_slots.empty()) {
+        return npos;
+    }
+    uint64_t h = hash(key, m_seed);
+    uint32_t index = m_slots[slotOf(h, m_displacements[bucketOf(h)])];
+    return index != kEmpty && m_keys[index] == key ? index : npos;
+}
+
+size_t PerfectHash::size() const {
+    return m_keys.size();
+}
+
+uint64_t PerfectHash::hash(std::string_view key, uint64_t seed) {
+    // FNV-1a, with a final mix so the top bits used for buckets depend on every byte
+    uint64_t h = 14695981039346656037ull ^ seed;
+    for (char c : key) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 1099511628211ull;
+    }
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return h;
+}
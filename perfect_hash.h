@@ -0,0 +1,55 @@
+#ifndef PERFECT_HASH_H
+#define PERFECT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Collision-free hash over a fixed set of string keys, built once and then
+ * only searched (hash and displace). Keys are split into small buckets by
+ * the top of their hash; each bucket is given a displacement that moves all
+ * of its keys onto slots no other key uses. A lookup is one hash, one
+ * displacement read, one slot read and one key comparison, however many keys
+ * there are.
+ */
+class PerfectHash {
+public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    PerfectHash();
+
+    // Lay out distinct keys; returns false if they contain a duplicate
+    bool build(std::vector<std::string> keys);
+
+    // Position of key in the keys given to build, or npos
+    size_t find(std::string_view key) const;
+
+    // Number of keys
+    size_t size() const;
+
+private:
+    static constexpr uint32_t kEmpty = UINT32_MAX;
+
+    std::vector<std::string> m_keys;
+    std::vector<uint32_t> m_displacements; // One per bucket
+    std::vector<uint32_t> m_slots;         // Key in each slot, or kEmpty
+    uint64_t m_seed;
+
+    static uint64_t hash(std::string_view key, uint64_t seed);
+
+    size_t bucketOf(uint64_t hash) const {
+        return static_cast<size_t>(((hash >> 32) * m_displacements.size()) >> 32);
+    }
+
+    size_t slotOf(uint64_t hash, uint32_t displacement) const {
+        return static_cast<size_t>((hash + displacement * ((hash >> 17) | 1)) & (m_slots.size() - 1));
+    }
+
+    // Try to place every key with the current seed
+    bool place();
+};
+
+#endif // PERFECT_HASH_H
@@ -0,0 +1,79 @@
+#include "prefix_trie.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+PrefixTrie::PrefixTrie() : m_size(0) {
+    clear();
+}
+
+uint32_t PrefixTrie::child(uint32_t node, unsigned char c) const {
+    const Node& current = m_nodes[node];
+    const void* found = std::memchr(current.labels.data(), c, current.labels.size());
+    if (found == nullptr) {
+        return kNone;
+    }
+    return current.children[static_cast<const char*>(found) - current.labels.data()];
+}
+
+uint32_t PrefixTrie::findNode(std::string_view key) const {
+    uint32_t node = 0;
+    for (char c : key) {
+        node = child(node, static_cast<unsigned char>(c));
+        if (node == kNone) {
+            return kNone;
+        }
+    }
+    return node;
+}
+
+bool PrefixTrie::insert(std::string_view key) {
+    uint32_t node = 0;
+    for (char c : key) {
+        uint32_t next = child(node, static_cast<unsigned char>(c));
+        if (next == kNone) {
+            next = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.emplace_back();
+            m_nodes[node].labels.push_back(c);
+            m_nodes[node].children.push_back(next);
+            if (node == 0) {
+                m_rootChildren[static_cast<unsigned char>(c)] = next;
+            }
+        }
+        node = next;
+    }
+
+    if (m_nodes[node].isKey) {
+        return false;
+    }
+    m_nodes[node].isKey = true;
+    m_size++;
+    return true;
+}
+
+bool PrefixTrie::erase(std::string_view key) {
+    // Nodes stay behind so other keys' paths never move; they're reused if the key comes back
+    uint32_t node = findNode(key);
+    if (node == kNone || !m_nodes[node].isKey) {
+        return false;
+    }
+    m_nodes[node].isKey = false;
+    m_size--;
+    return true;
+}
+
+bool PrefixTrie::contains(std::string_view key) const {
+    uint32_t node = findNode(key);
+    return node != kNone && m_nodes[node].isKey;
+}
+
+void PrefixTrie::clear() {
+    m_nodes.clear();
+    m_nodes.emplace_back();
+    std::fill(std::begin(m_rootChildren), std::end(m_rootChildren), kNone);
+    m_size = 0;
+}
+
+size_t PrefixTrie::size() const {
+    return m_size;
+}
@@ -0,0 +1,92 @@
+#ifndef PREFIX_TRIE_H
+#define PREFIX_TRIE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Where a key was found inside a text
+struct TrieMatch {
+    size_t start;
+    size_t length;
+};
+
+/**
+ * Byte trie over a set of keys, used as an optional index on a FlameMemory
+ * container. Each node keeps the first bytes of its children in a short
+ * string, so stepping down is a memchr over a handful of bytes.
+ * longestMatch finds the longest key occurring anywhere in a text by walking
+ * the trie from every position of the text once, instead of searching the
+ * text for each key separately.
+ */
+class PrefixTrie {
+public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    PrefixTrie();
+
+    // Add a key; returns false if it was already present
+    bool insert(std::string_view key);
+
+    // Remove a key; returns false if it was not present
+    bool erase(std::string_view key);
+
+    // Check whether a key is present
+    bool contains(std::string_view key) const;
+
+    // Remove all keys
+    void clear();
+
+    // Number of keys
+    size_t size() const;
+
+    // Longest key occurring in text (the leftmost one on ties), or start == npos.
+    // isLive(key) is asked about each candidate; keys it rejects are dropped from the trie.
+    template <typename Func>
+    TrieMatch longestMatch(std::string_view text, Func isLive) {
+        TrieMatch best = {npos, 0};
+        for (size_t start = 0; start < text.size() && text.size() - start > best.length; start++) {
+            // Most positions fail on the first byte, which the root table answers directly
+            uint32_t node = m_rootChildren[static_cast<unsigned char>(text[start])];
+            for (size_t i = start; node != kNone; ) {
+                size_t length = i - start + 1;
+                if (m_nodes[node].isKey && length > best.length) {
+                    if (isLive(text.substr(start, length))) {
+                        best = {start, length};
+                    } else {
+                        m_nodes[node].isKey = false;
+                        m_size--;
+                    }
+                }
+                if (++i == text.size()) {
+                    break;
+                }
+                node = child(node, static_cast<unsigned char>(text[i]));
+            }
+        }
+        return best;
+    }
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Node {
+        std::string labels;             // First byte of each child
+        std::vector<uint32_t> children; // Child node for each label
+        bool isKey = false;
+    };
+
+    std::vector<Node> m_nodes;          // m_nodes[0] is the root
+    uint32_t m_rootChildren[256];       // Children of the root by byte, kNone where there is none
+    size_t m_size;
+
+    // Child of node along byte c, or kNone
+    uint32_t child(uint32_t node, unsigned char c) const;
+
+    // Node reached by key, or kNone
+    uint32_t findNode(std::string_view key) const;
+};
+
+#endif // PREFIX_TRIE_H
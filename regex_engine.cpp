@@ -0,0 +1,947 @@
+#include "regex_engine.h"
+#include <algorithm>
+#include <cctype>
+#include <map>
+
+namespace {
+    // A pattern whose NFA grows past this many states is rejected, which bounds
+    // what repeat counts such as (a{100}){100} can cost
+    constexpr size_t kMaxNfaStates = 100000;
+
+    // When one direction's DFA holds this many words of transitions and kernels the
+    // cache is dropped and rebuilt on demand, so adversarial text can't grow it without bound
+    constexpr size_t kMaxDfaWords = size_t(1) << 22;
+
+    constexpr int32_t kMaxRepeat = 1000;
+    constexpr int kMaxNesting = 200;
+    constexpr size_t npos = std::string_view::npos;
+
+    // State flags
+    constexpr uint8_t kAtStart = 1;
+    constexpr uint8_t kAfterWord = 2;
+
+    inline bool isWordByte(unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    std::bitset<256> byteRange(unsigned char lo, unsigned char hi) {
+        std::bitset<256> bytes;
+        for (unsigned c = lo; c <= hi; c++) {
+            bytes.set(c);
+        }
+        return bytes;
+    }
+
+    std::bitset<256> wordBytes() {
+        return byteRange('a', 'z') | byteRange('A', 'Z') | byteRange('0', '9') | byteRange('_', '_');
+    }
+
+    std::bitset<256> spaceBytes() {
+        return byteRange('\t', '\r') | byteRange(' ', ' ');
+    }
+
+    // Add the other case of every letter in the set
+    void foldCase(std::bitset<256>& bytes) {
+        for (unsigned c = 'a'; c <= 'z'; c++) {
+            unsigned upper = c - 'a' + 'A';
+            if (bytes[c] || bytes[upper]) {
+                bytes.set(c);
+                bytes.set(upper);
+            }
+        }
+    }
+
+    int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+}
+
+RegexEngine::RegexEngine()
+    : m_caseInsensitive(false), m_usesBegin(false), m_usesWordBoundary(false), m_anySet(-1),
+      m_columns(1), m_markGeneration(0) {
+    std::fill(std::begin(m_classOf), std::end(m_classOf), 0);
+}
+
+bool RegexEngine::compile(const std::string& pattern) {
+    m_lastError.clear();
+    m_ast.clear();
+    m_sets.clear();
+    m_forward.nfa.clear();
+    m_reverse.nfa.clear();
+    m_usesBegin = false;
+    m_usesWordBoundary = false;
+
+    size_t pos = 0;
+    m_caseInsensitive = pattern.compare(0, 4, "(?i)") == 0;
+    if (m_caseInsensitive) {
+        pos = 4;
+    }
+
+    int32_t root = parseAlternation(pattern, pos, 0);
+    if (root < 0) {
+        return false;
+    }
+    if (pos < pattern.size()) {
+        m_lastError = "unmatched ')' at position " + std::to_string(pos);
+        return false;
+    }
+
+    std::bitset<256> all;
+    m_anySet = addSet(all.set());
+    buildClasses();
+
+    if (!buildAutomaton(m_forward, root, false) || !buildAutomaton(m_reverse, root, true)) {
+        m_forward.nfa.clear();
+        m_reverse.nfa.clear();
+        return false;
+    }
+
+    m_marks.assign(std::max(m_forward.nfa.size(), m_reverse.nfa.size()), 0);
+    m_markGeneration = 0;
+    resetGroups();
+    return true;
+}
+
+bool RegexEngine::match(std::string_view text) {
+    if (m_forward.nfa.empty()) {
+        return false;
+    }
+
+    int32_t state = startState(m_forward, false, true, false);
+    for (char c : text) {
+        state = step(m_forward, state, m_classOf[static_cast<unsigned char>(c)]) >> 1;
+        if (state == 0) {
+            return false;
+        }
+    }
+    return (step(m_forward, state, m_columns - 1) & 1) != 0;
+}
+
+bool RegexEngine::search(std::string_view text) {
+    if (m_forward.nfa.empty()) {
+        return false;
+    }
+
+    int32_t state = startState(m_forward, true, true, false);
+    for (char c : text) {
+        int32_t next = step(m_forward, state, m_classOf[static_cast<unsigned char>(c)]);
+        if ((next & 1) != 0) {
+            return true;
+        }
+        state = next >> 1;
+    }
+    return (step(m_forward, state, m_columns - 1) & 1) != 0;
+}
+
+void RegexEngine::findAll(std::string_view text, std::vector<std::pair<size_t, size_t>>& matches) {
+    if (m_forward.nfa.empty()) {
+        return;
+    }
+
+    // Backwards over the text, the reversed pattern matches exactly where a match starts
+    std::vector<bool> canStart(text.size() + 1, false);
+    int32_t state = startState(m_reverse, true, true, false);
+    for (size_t i = text.size(); i > 0; i--) {
+        int32_t next = step(m_reverse, state, m_classOf[static_cast<unsigned char>(text[i - 1])]);
+        canStart[i] = (next & 1) != 0;
+        state = next >> 1;
+    }
+    canStart[0] = (step(m_reverse, state, m_columns - 1) & 1) != 0;
+
+    // Forwards through the group automaton, with the text position each group began at.
+    // Tentative matches wait in order until no group that began at or before them is
+    // left, since until then an earlier start or a longer match could still replace them.
+    std::vector<size_t> starts;
+    std::vector<size_t> nextStarts;
+    std::vector<std::pair<size_t, size_t>> tentative;
+    size_t settled = 0;     // Tentative matches before this one have been reported
+    state = -1;
+    for (size_t pos = 0;; pos++) {
+        // With nothing in flight, positions where no match starts are skipped
+        if (state < 0 || (starts.empty() && settled == tentative.size() && !canStart[pos])) {
+            while (pos < text.size() && !canStart[pos]) {
+                pos++;
+            }
+            state = groupStartState(pos == 0, pos > 0 && isWordByte(static_cast<unsigned char>(text[pos - 1])));
+        }
+
+        bool atEnd = pos == text.size();
+        size_t column = atEnd ? m_columns - 1 : m_classOf[static_cast<unsigned char>(text[pos])];
+        bool spawn = !atEnd && canStart[pos];
+        int32_t moveIndex = m_groups.moves[(static_cast<size_t>(state) * m_columns + column) * 2 + spawn];
+        if (moveIndex < 0) {
+            moveIndex = buildGroupMove(state, column, spawn);
+        }
+        const GroupMove& move = m_groups.moveTable[moveIndex];
+
+        // A match ending here outranks the tentative matches that start at or after its start
+        if (move.matchedGroup >= 0) {
+            size_t matchStart = starts[move.matchedGroup];
+            while (tentative.size() > settled && tentative.back().first >= matchStart) {
+                tentative.pop_back();
+            }
+            tentative.emplace_back(matchStart, pos);
+        }
+        if (atEnd) {
+            for (; settled < tentative.size(); settled++) {
+                matches.emplace_back(tentative[settled].first, tentative[settled].second - tentative[settled].first);
+            }
+            break;
+        }
+
+        if (move.keepsStarts) {
+            starts.resize(move.groupCount);
+        } else {
+            nextStarts.clear();
+            for (uint32_t i = 0; i < move.groupCount; i++) {
+                int32_t source = m_groups.sources[move.sources + i];
+                nextStarts.push_back(source < 0 ? pos : starts[source]);
+            }
+            starts.swap(nextStarts);
+        }
+        state = move.next;
+
+        size_t oldestStart = starts.empty() ? npos : starts.front();
+        while (settled < tentative.size() && tentative[settled].first < oldestStart) {
+            matches.emplace_back(tentative[settled].first, tentative[settled].second - tentative[settled].first);
+            settled++;
+        }
+        if (settled == tentative.size()) {
+            tentative.clear();
+            settled = 0;
+        }
+    }
+}
+
+size_t RegexEngine::getStateCount() const {
+    return m_forward.kernels.size() + m_reverse.kernels.size();
+}
+
+const std::string& RegexEngine::getLastError() const {
+    return m_lastError;
+}
+
+// Parser
+
+int32_t RegexEngine::addNode(AstNode::Kind kind) {
+    m_ast.emplace_back();
+    m_ast.back().kind = kind;
+    return static_cast<int32_t>(m_ast.size() - 1);
+}
+
+int32_t RegexEngine::addSet(std::bitset<256> bytes) {
+    m_sets.push_back(bytes);
+    return static_cast<int32_t>(m_sets.size() - 1);
+}
+
+int32_t RegexEngine::parseAlternation(const std::string& pattern, size_t& pos, int depth) {
+    if (depth > kMaxNesting) {
+        m_lastError = "pattern is nested too deeply";
+        return -1;
+    }
+
+    int32_t first = parseConcat(pattern, pos, depth);
+    if (first < 0 || pos >= pattern.size() || pattern[pos] != '|') {
+        return first;
+    }
+
+    std::vector<int32_t> branches = {first};
+    while (pos < pattern.size() && pattern[pos] == '|') {
+        pos++;
+        int32_t branch = parseConcat(pattern, pos, depth);
+        if (branch < 0) {
+            return -1;
+        }
+        branches.push_back(branch);
+    }
+
+    int32_t node = addNode(AstNode::Alternate);
+    m_ast[node].children = std::move(branches);
+    return node;
+}
+
+int32_t RegexEngine::parseConcat(const std::string& pattern, size_t& pos, int depth) {
+    std::vector<int32_t> items;
+    while (pos < pattern.size() && pattern[pos] != '|' && pattern[pos] != ')') {
+        int32_t item = parseRepeat(pattern, pos, depth);
+        if (item < 0) {
+            return -1;
+        }
+        items.push_back(item);
+    }
+
+    if (items.size() == 1) {
+        return items[0];
+    }
+    int32_t node = addNode(items.empty() ? AstNode::Empty : AstNode::Concat);
+    m_ast[node].children = std::move(items);
+    return node;
+}
+
+int32_t RegexEngine::parseRepeat(const std::string& pattern, size_t& pos, int depth) {
+    int32_t node = parseAtom(pattern, pos, depth);
+    while (node >= 0 && pos < pattern.size()) {
+        char c = pattern[pos];
+        int32_t min = 0;
+        int32_t max = -1;
+        if (c == '*') {
+            pos++;
+        } else if (c == '+') {
+            min = 1;
+            pos++;
+        } else if (c == '?') {
+            max = 1;
+            pos++;
+        } else if (c == '{' && pos + 1 < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[pos + 1]))) {
+            // {m}, {m,} or {m,n}
+            size_t cursor = pos + 1;
+            auto readNumber = [&](int32_t& value) {
+                value = 0;
+                size_t begin = cursor;
+                while (cursor < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[cursor]))) {
+                    value = std::min(value * 10 + (pattern[cursor] - '0'), kMaxRepeat + 1);
+                    cursor++;
+                }
+                return cursor > begin;
+            };
+            readNumber(min);
+            max = min;
+            if (cursor < pattern.size() && pattern[cursor] == ',') {
+                cursor++;
+                if (!readNumber(max)) {
+                    max = -1;
+                }
+            }
+            if (cursor >= pattern.size() || pattern[cursor] != '}') {
+                m_lastError = "malformed repeat at position " + std::to_string(pos);
+                return -1;
+            }
+            if (min > kMaxRepeat || max > kMaxRepeat || (max >= 0 && max < min)) {
+                m_lastError = "bad repeat count at position " + std::to_string(pos);
+                return -1;
+            }
+            pos = cursor + 1;
+        } else {
+            break;
+        }
+
+        if (pos < pattern.size() && pattern[pos] == '?') {
+            m_lastError = "lazy quantifiers are not supported (matches are leftmost-longest)";
+            return -1;
+        }
+
+        int32_t repeat = addNode(AstNode::Repeat);
+        m_ast[repeat].min = min;
+        m_ast[repeat].max = max;
+        m_ast[repeat].children.push_back(node);
+        node = repeat;
+    }
+    return node;
+}
+
+int32_t RegexEngine::parseAtom(const std::string& pattern, size_t& pos, int depth) {
+    char c = pattern[pos];
+    std::bitset<256> bytes;
+
+    switch (c) {
+        case '(': {
+            size_t open = pos++;
+            if (pattern.compare(pos, 2, "?:") == 0) {
+                pos += 2;
+            } else if (pos < pattern.size() && pattern[pos] == '?') {
+                m_lastError = "unsupported group syntax at position " + std::to_string(open);
+                return -1;
+            }
+            int32_t inner = parseAlternation(pattern, pos, depth + 1);
+            if (inner < 0) {
+                return -1;
+            }
+            if (pos >= pattern.size() || pattern[pos] != ')') {
+                m_lastError = "missing ')' for group at position " + std::to_string(open);
+                return -1;
+            }
+            pos++;
+            return inner;
+        }
+        case '[':
+            return parseClass(pattern, pos);
+        case '.':
+            pos++;
+            bytes.set();
+            bytes.reset('\n');
+            break;
+        case '^':
+        case '$':
+            pos++;
+            m_usesBegin = true;
+            return addNode(c == '^' ? AstNode::Begin : AstNode::End);
+        case '*':
+        case '+':
+        case '?':
+            m_lastError = std::string("nothing to repeat before '") + c + "' at position " + std::to_string(pos);
+            return -1;
+        case '\\': {
+            int32_t assertion = -1;
+            if (!parseEscape(pattern, pos, bytes, &assertion)) {
+                return -1;
+            }
+            if (assertion >= 0) {
+                m_usesWordBoundary = true;
+                return addNode(static_cast<AstNode::Kind>(assertion));
+            }
+            break;
+        }
+        default:
+            pos++;
+            bytes.set(static_cast<unsigned char>(c));
+            break;
+    }
+
+    if (m_caseInsensitive) {
+        foldCase(bytes);
+    }
+    int32_t node = addNode(AstNode::Set);
+    m_ast[node].set = addSet(bytes);
+    return node;
+}
+
+int32_t RegexEngine::parseClass(const std::string& pattern, size_t& pos) {
+    size_t open = pos++;
+    bool negate = pos < pattern.size() && pattern[pos] == '^';
+    if (negate) {
+        pos++;
+    }
+
+    std::bitset<256> bytes;
+    bool first = true;
+    while (pos < pattern.size() && (pattern[pos] != ']' || first)) {
+        first = false;
+
+        // One byte, or a whole escape class such as \d which can't start a range
+        std::bitset<256> item;
+        if (pattern[pos] == '\\') {
+            if (!parseEscape(pattern, pos, item, nullptr)) {
+                return -1;
+            }
+        } else {
+            item.set(static_cast<unsigned char>(pattern[pos++]));
+        }
+
+        bool isRange = item.count() == 1 && pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']';
+        if (!isRange) {
+            bytes |= item;
+            continue;
+        }
+
+        pos++;
+        std::bitset<256> upper;
+        if (pattern[pos] == '\\') {
+            if (!parseEscape(pattern, pos, upper, nullptr)) {
+                return -1;
+            }
+        } else {
+            upper.set(static_cast<unsigned char>(pattern[pos++]));
+        }
+        if (upper.count() != 1) {
+            m_lastError = "bad character range in class at position " + std::to_string(open);
+            return -1;
+        }
+
+        unsigned lo = 0;
+        unsigned hi = 0;
+        while (!item[lo]) lo++;
+        while (!upper[hi]) hi++;
+        if (lo > hi) {
+            m_lastError = "character range out of order in class at position " + std::to_string(open);
+            return -1;
+        }
+        bytes |= byteRange(static_cast<unsigned char>(lo), static_cast<unsigned char>(hi));
+    }
+
+    if (pos >= pattern.size()) {
+        m_lastError = "missing ']' for class at position " + std::to_string(open);
+        return -1;
+    }
+    pos++;
+
+    // Fold before negating, so [^a] under (?i) excludes 'A' as well
+    if (m_caseInsensitive) {
+        foldCase(bytes);
+    }
+    if (negate) {
+        bytes.flip();
+    }
+
+    int32_t node = addNode(AstNode::Set);
+    m_ast[node].set = addSet(bytes);
+    return node;
+}
+
+bool RegexEngine::parseEscape(const std::string& pattern, size_t& pos, std::bitset<256>& bytes, int32_t* assertion) {
+    size_t start = pos++;
+    if (pos >= pattern.size()) {
+        m_lastError = "trailing backslash";
+        return false;
+    }
+
+    char c = pattern[pos++];
+    switch (c) {
+        case 'd': bytes = byteRange('0', '9'); return true;
+        case 'D': bytes = ~byteRange('0', '9'); return true;
+        case 'w': bytes = wordBytes(); return true;
+        case 'W': bytes = ~wordBytes(); return true;
+        case 's': bytes = spaceBytes(); return true;
+        case 'S': bytes = ~spaceBytes(); return true;
+        case 'n': bytes.set('\n'); return true;
+        case 't': bytes.set('\t'); return true;
+        case 'r': bytes.set('\r'); return true;
+        case 'f': bytes.set('\f'); return true;
+        case 'v': bytes.set('\v'); return true;
+        case 'x': {
+            int high = pos < pattern.size() ? hexValue(pattern[pos]) : -1;
+            int low = pos + 1 < pattern.size() ? hexValue(pattern[pos + 1]) : -1;
+            if (high < 0 || low < 0) {
+                m_lastError = "\\x needs two hex digits at position " + std::to_string(start);
+                return false;
+            }
+            pos += 2;
+            bytes.set(static_cast<unsigned>(high * 16 + low));
+            return true;
+        }
+        case 'b':
+        case 'B':
+            if (assertion == nullptr) {
+                m_lastError = std::string("\\") + c + " is not allowed in a class";
+                return false;
+            }
+            *assertion = c == 'b' ? AstNode::WordBoundary : AstNode::NotWordBoundary;
+            return true;
+        default:
+            if (std::isalnum(static_cast<unsigned char>(c))) {
+                m_lastError = std::string("unknown escape \\") + c + " at position " + std::to_string(start);
+                return false;
+            }
+            bytes.set(static_cast<unsigned char>(c));
+            return true;
+    }
+}
+
+// NFA construction
+
+void RegexEngine::buildClasses() {
+    // Two bytes share a class when every set, and word-ness if \b is used, treats them alike
+    std::map<std::vector<bool>, uint16_t> classes;
+    m_classByte.clear();
+    for (unsigned c = 0; c < 256; c++) {
+        std::vector<bool> signature;
+        signature.reserve(m_sets.size() + 1);
+        for (const auto& set : m_sets) {
+            signature.push_back(set[c]);
+        }
+        if (m_usesWordBoundary) {
+            signature.push_back(isWordByte(static_cast<unsigned char>(c)));
+        }
+
+        auto inserted = classes.emplace(std::move(signature), static_cast<uint16_t>(classes.size()));
+        if (inserted.second) {
+            m_classByte.push_back(static_cast<unsigned char>(c));
+        }
+        m_classOf[c] = inserted.first->second;
+    }
+    m_columns = m_classByte.size() + 1;
+}
+
+int32_t RegexEngine::addState(Automaton& automaton, NfaState::Kind kind, int32_t out, int32_t out1, int32_t set) {
+    if (automaton.nfa.size() >= kMaxNfaStates) {
+        return -1;
+    }
+    automaton.nfa.push_back({kind, out, out1, set});
+    return static_cast<int32_t>(automaton.nfa.size() - 1);
+}
+
+int32_t RegexEngine::emit(Automaton& automaton, int32_t node, int32_t next, bool reverse) {
+    if (next < 0) {
+        return -1;
+    }
+
+    const AstNode& ast = m_ast[node];
+    switch (ast.kind) {
+        case AstNode::Empty:
+            return next;
+        case AstNode::Set:
+            return addState(automaton, NfaState::Byte, next, -1, ast.set);
+        case AstNode::Begin:
+            return addState(automaton, reverse ? NfaState::End : NfaState::Begin, next, -1, -1);
+        case AstNode::End:
+            return addState(automaton, reverse ? NfaState::Begin : NfaState::End, next, -1, -1);
+        case AstNode::WordBoundary:
+            return addState(automaton, NfaState::WordBoundary, next, -1, -1);
+        case AstNode::NotWordBoundary:
+            return addState(automaton, NfaState::NotWordBoundary, next, -1, -1);
+        case AstNode::Concat:
+            // Built back to front, each item continuing into the one after it
+            if (reverse) {
+                for (int32_t child : ast.children) {
+                    next = emit(automaton, child, next, reverse);
+                }
+            } else {
+                for (auto it = ast.children.rbegin(); it != ast.children.rend(); ++it) {
+                    next = emit(automaton, *it, next, reverse);
+                }
+            }
+            return next;
+        case AstNode::Alternate: {
+            int32_t entry = emit(automaton, ast.children.back(), next, reverse);
+            for (size_t i = ast.children.size() - 1; i-- > 0 && entry >= 0; ) {
+                int32_t branch = emit(automaton, ast.children[i], next, reverse);
+                entry = branch < 0 ? -1 : addState(automaton, NfaState::Split, branch, entry, -1);
+            }
+            return entry;
+        }
+        case AstNode::Repeat: {
+            int32_t child = ast.children[0];
+            if (ast.max < 0) {
+                // Loop: a split that either enters the child, which comes back to it, or leaves
+                int32_t loop = addState(automaton, NfaState::Split, -1, next, -1);
+                if (loop < 0) {
+                    return -1;
+                }
+                int32_t body = emit(automaton, child, loop, reverse);
+                automaton.nfa[loop].out = body;
+                next = body < 0 ? -1 : loop;
+            } else {
+                // Optional copies nest, so x{0,2} becomes (x(x)?)?
+                int32_t skip = next;
+                for (int32_t i = ast.min; i < ast.max && next >= 0; i++) {
+                    int32_t body = emit(automaton, child, next, reverse);
+                    next = body < 0 ? -1 : addState(automaton, NfaState::Split, body, skip, -1);
+                }
+            }
+            for (int32_t i = 0; i < ast.min && next >= 0; i++) {
+                next = emit(automaton, child, next, reverse);
+            }
+            return next;
+        }
+    }
+    return -1;
+}
+
+bool RegexEngine::buildAutomaton(Automaton& automaton, int32_t root, bool reverse) {
+    automaton.nfa.clear();
+    int32_t matchState = addState(automaton, NfaState::Match, -1, -1, -1);
+    automaton.anchoredStart = emit(automaton, root, matchState, reverse);
+
+    // Unanchored searches loop over any byte before entering the pattern
+    int32_t loop = addState(automaton, NfaState::Split, automaton.anchoredStart, -1, -1);
+    int32_t any = addState(automaton, NfaState::Byte, loop, -1, m_anySet);
+    if (automaton.anchoredStart < 0 || loop < 0 || any < 0) {
+        m_lastError = "pattern is too large";
+        return false;
+    }
+    automaton.nfa[loop].out1 = any;
+    automaton.unanchoredStart = loop;
+
+    resetDfa(automaton);
+    return true;
+}
+
+// Lazy DFA
+
+void RegexEngine::resetDfa(Automaton& automaton) {
+    // State 0 is the dead state: no kernel, every transition back to itself
+    automaton.kernels.assign(1, std::vector<int32_t>());
+    automaton.flags.assign(1, 0);
+    automaton.transitions.assign(m_columns, 0);
+    automaton.stateIds.clear();
+    automaton.words = m_columns;
+    for (auto& row : automaton.starts) {
+        std::fill(std::begin(row), std::end(row), -1);
+    }
+}
+
+void RegexEngine::nextMarkGeneration() {
+    if (++m_markGeneration == 0) {
+        std::fill(m_marks.begin(), m_marks.end(), 0);
+        m_markGeneration = 1;
+    }
+}
+
+void RegexEngine::addKernel(const Automaton& automaton, std::vector<int32_t>& kernel, int32_t state) {
+    // Splits are followed; bytes, assertions and the match state are kept. Assertions
+    // are decided later, once the byte that follows them is known.
+    m_stack.push_back(state);
+    while (!m_stack.empty()) {
+        int32_t current = m_stack.back();
+        m_stack.pop_back();
+        if (m_marks[current] == m_markGeneration) {
+            continue;
+        }
+        m_marks[current] = m_markGeneration;
+
+        const NfaState& nfaState = automaton.nfa[current];
+        if (nfaState.kind == NfaState::Split) {
+            m_stack.push_back(nfaState.out1);
+            m_stack.push_back(nfaState.out);
+        } else {
+            kernel.push_back(current);
+        }
+    }
+}
+
+int32_t RegexEngine::internState(Automaton& automaton, std::vector<int32_t>& kernel, uint8_t flags) {
+    if (kernel.empty()) {
+        return 0;
+    }
+    std::sort(kernel.begin(), kernel.end());
+
+    // Flags only matter to assertions, so states without any share one identity
+    bool hasAssertion = false;
+    for (int32_t state : kernel) {
+        NfaState::Kind kind = automaton.nfa[state].kind;
+        hasAssertion = hasAssertion || (kind != NfaState::Byte && kind != NfaState::Match);
+    }
+    if (!hasAssertion) {
+        flags = 0;
+    }
+
+    std::string key(1, static_cast<char>(flags));
+    key.append(reinterpret_cast<const char*>(kernel.data()), kernel.size() * sizeof(int32_t));
+    auto found = automaton.stateIds.find(key);
+    if (found != automaton.stateIds.end()) {
+        return found->second;
+    }
+
+    int32_t id = static_cast<int32_t>(automaton.kernels.size());
+    automaton.kernels.push_back(kernel);
+    automaton.flags.push_back(flags);
+    automaton.transitions.resize(automaton.transitions.size() + m_columns, -1);
+    automaton.words += m_columns + kernel.size() * 2;
+    automaton.stateIds.emplace(std::move(key), id);
+    return id;
+}
+
+int32_t RegexEngine::startState(Automaton& automaton, bool unanchored, bool atStart, bool afterWord) {
+    uint8_t flags = static_cast<uint8_t>((atStart && m_usesBegin ? kAtStart : 0) |
+                                         (afterWord && m_usesWordBoundary ? kAfterWord : 0));
+    int32_t& cached = automaton.starts[unanchored ? 1 : 0][flags];
+    if (cached < 0) {
+        std::vector<int32_t> kernel;
+        nextMarkGeneration();
+        addKernel(automaton, kernel, unanchored ? automaton.unanchoredStart : automaton.anchoredStart);
+        cached = internState(automaton, kernel, flags);
+    }
+    return cached;
+}
+
+int32_t RegexEngine::buildTransition(Automaton& automaton, int32_t state, size_t column) {
+    bool atEnd = column == m_columns - 1;
+    unsigned char byte = atEnd ? 0 : m_classByte[column];
+    uint8_t flags = automaton.flags[state];
+    bool beforeWord = !atEnd && isWordByte(byte);
+
+    // Settle the kernel's assertions now that the next byte is known
+    m_resolved.clear();
+    nextMarkGeneration();
+    const std::vector<int32_t>& kernel = automaton.kernels[state];
+    bool matched = resolveKernel(automaton, kernel.data(), kernel.data() + kernel.size(), flags, atEnd, beforeWord);
+
+    // Then take the byte
+    std::vector<int32_t> nextKernel;
+    if (!atEnd) {
+        nextMarkGeneration();
+        for (int32_t current : m_resolved) {
+            const NfaState& nfaState = automaton.nfa[current];
+            if (m_sets[nfaState.set][byte]) {
+                addKernel(automaton, nextKernel, nfaState.out);
+            }
+        }
+    }
+
+    uint8_t nextFlags = beforeWord && m_usesWordBoundary ? kAfterWord : 0;
+    if (automaton.words >= kMaxDfaWords) {
+        // Start over rather than grow; only the state about to be entered is needed
+        resetDfa(automaton);
+        return (internState(automaton, nextKernel, nextFlags) << 1) | (matched ? 1 : 0);
+    }
+
+    int32_t next = (internState(automaton, nextKernel, nextFlags) << 1) | (matched ? 1 : 0);
+    automaton.transitions[static_cast<size_t>(state) * m_columns + column] = next;
+    return next;
+}
+
+bool RegexEngine::resolveKernel(const Automaton& automaton, const int32_t* begin, const int32_t* end,
+                                uint8_t flags, bool atEnd, bool beforeWord) {
+    bool atStart = (flags & kAtStart) != 0;
+    bool afterWord = (flags & kAfterWord) != 0;
+    bool matched = false;
+    m_stack.assign(begin, end);
+    while (!m_stack.empty()) {
+        int32_t current = m_stack.back();
+        m_stack.pop_back();
+        if (m_marks[current] == m_markGeneration) {
+            continue;
+        }
+        m_marks[current] = m_markGeneration;
+
+        const NfaState& nfaState = automaton.nfa[current];
+        bool passes = false;
+        switch (nfaState.kind) {
+            case NfaState::Byte:
+                m_resolved.push_back(current);
+                break;
+            case NfaState::Match:
+                matched = true;
+                break;
+            case NfaState::Split:
+                m_stack.push_back(nfaState.out1);
+                passes = true;
+                break;
+            case NfaState::Begin:
+                passes = atStart;
+                break;
+            case NfaState::End:
+                passes = atEnd;
+                break;
+            case NfaState::WordBoundary:
+                passes = afterWord != beforeWord;
+                break;
+            case NfaState::NotWordBoundary:
+                passes = afterWord == beforeWord;
+                break;
+        }
+        if (passes) {
+            m_stack.push_back(nfaState.out);
+        }
+    }
+    return matched;
+}
+
+// Group automaton
+
+void RegexEngine::resetGroups() {
+    m_groups.layouts.clear();
+    m_groups.flags.clear();
+    m_groups.moves.clear();
+    m_groups.moveTable.clear();
+    m_groups.sources.clear();
+    m_groups.stateIds.clear();
+    m_groups.words = 0;
+    std::fill(std::begin(m_groups.starts), std::end(m_groups.starts), -1);
+}
+
+int32_t RegexEngine::internGroupState(std::vector<int32_t>& layout, uint8_t flags) {
+    // Unlike a DFA state, one without groups isn't dead: a group may begin at any position.
+    // Its flags are kept even without assertions for the same reason.
+    std::string key(1, static_cast<char>(flags));
+    key.append(reinterpret_cast<const char*>(layout.data()), layout.size() * sizeof(int32_t));
+    auto found = m_groups.stateIds.find(key);
+    if (found != m_groups.stateIds.end()) {
+        return found->second;
+    }
+
+    int32_t id = static_cast<int32_t>(m_groups.layouts.size());
+    m_groups.layouts.push_back(layout);
+    m_groups.flags.push_back(flags);
+    m_groups.moves.resize(m_groups.moves.size() + m_columns * 2, -1);
+    m_groups.words += m_columns * 2 + layout.size() * 2;
+    m_groups.stateIds.emplace(std::move(key), id);
+    return id;
+}
+
+int32_t RegexEngine::groupStartState(bool atStart, bool afterWord) {
+    uint8_t flags = static_cast<uint8_t>((atStart && m_usesBegin ? kAtStart : 0) |
+                                         (afterWord && m_usesWordBoundary ? kAfterWord : 0));
+    int32_t& cached = m_groups.starts[flags];
+    if (cached < 0) {
+        std::vector<int32_t> layout;
+        cached = internGroupState(layout, flags);
+    }
+    return cached;
+}
+
+int32_t RegexEngine::buildGroupMove(int32_t state, size_t column, bool spawn) {
+    bool atEnd = column == m_columns - 1;
+    unsigned char byte = atEnd ? 0 : m_classByte[column];
+    uint8_t flags = m_groups.flags[state];
+    bool beforeWord = !atEnd && isWordByte(byte);
+
+    // Settle each group's assertions, earliest group first and with shared marks, so a
+    // state two groups reach is the earlier one's. The first group to reach the match
+    // state has matched, and every later group overlaps that match and is dropped.
+    m_resolved.clear();
+    nextMarkGeneration();
+    const std::vector<int32_t>& layout = m_groups.layouts[state];
+    int32_t matchedGroup = -1;
+    int32_t groupCount = 0;
+    for (size_t begin = 0; begin < layout.size() && matchedGroup < 0; groupCount++) {
+        size_t end = std::find(layout.begin() + begin, layout.end(), -1) - layout.begin();
+        if (resolveKernel(m_forward, layout.data() + begin, layout.data() + end, flags, atEnd, beforeWord)) {
+            matchedGroup = groupCount;
+        }
+        m_resolved.push_back(-1);
+        begin = end + 1;
+    }
+
+    // A group begun here is the latest, so it never takes a state from another; its
+    // empty match, if any, isn't reported
+    int32_t spawnGroup = -1;
+    if (spawn) {
+        int32_t start = m_forward.anchoredStart;
+        resolveKernel(m_forward, &start, &start + 1, flags, atEnd, beforeWord);
+        m_resolved.push_back(-1);
+        spawnGroup = groupCount;
+    }
+
+    // Then take the byte; groups left without states are gone
+    std::vector<int32_t> nextLayout;
+    std::vector<int32_t> sources;
+    bool keepsStarts = true;
+    if (!atEnd) {
+        nextMarkGeneration();
+        int32_t group = 0;
+        size_t kernelStart = 0;
+        for (int32_t current : m_resolved) {
+            if (current >= 0) {
+                const NfaState& nfaState = m_forward.nfa[current];
+                if (m_sets[nfaState.set][byte]) {
+                    addKernel(m_forward, nextLayout, nfaState.out);
+                }
+                continue;
+            }
+            if (nextLayout.size() > kernelStart) {
+                std::sort(nextLayout.begin() + kernelStart, nextLayout.end());
+                nextLayout.push_back(-1);
+                kernelStart = nextLayout.size();
+                int32_t source = group == spawnGroup ? -1 : group;
+                keepsStarts = keepsStarts && source == static_cast<int32_t>(sources.size());
+                sources.push_back(source);
+            }
+            group++;
+        }
+    }
+
+    uint8_t nextFlags = beforeWord && m_usesWordBoundary ? kAfterWord : 0;
+    bool reset = m_groups.words >= kMaxDfaWords;
+    if (reset) {
+        // Start over rather than grow; only the move about to be taken is needed
+        resetGroups();
+    }
+    GroupMove move;
+    move.next = internGroupState(nextLayout, nextFlags);
+    move.matchedGroup = matchedGroup;
+    move.groupCount = static_cast<uint32_t>(sources.size());
+    move.sources = static_cast<uint32_t>(m_groups.sources.size());
+    move.keepsStarts = keepsStarts;
+    m_groups.sources.insert(m_groups.sources.end(), sources.begin(), sources.end());
+    m_groups.moveTable.push_back(move);
+    m_groups.words += 4 + sources.size();
+
+    int32_t index = static_cast<int32_t>(m_groups.moveTable.size() - 1);
+    if (!reset) {
+        m_groups.moves[(static_cast<size_t>(state) * m_columns + column) * 2 + spawn] = index;
+    }
+    return index;
+}
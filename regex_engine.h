@@ -0,0 +1,182 @@
+#ifndef REGEX_ENGINE_H
+#define REGEX_ENGINE_H
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Regular expressions compiled to a Thompson NFA and run as a DFA that is
+ * built lazily, one state the first time the text reaches it. There is no
+ * backtracking: every byte of text costs one table lookup once the states
+ * it passes through exist, so running time is linear in the text whatever
+ * the pattern and input look like.
+ *
+ * Syntax: literals, ., [...] and [^...] classes with ranges, \d \w \s and
+ * their negations, \n \t \r \f \v \xHH, groups (...) and (?:...),
+ * alternation |, the quantifiers * + ? {m} {m,} {m,n}, the anchors ^ and $,
+ * word boundaries \b \B, and a leading (?i) for case-insensitive matching.
+ * Matches are leftmost-longest, as in POSIX. Groups only group; there are
+ * no captures or backreferences, which a DFA cannot provide.
+ *
+ * findAll runs a reversed automaton backwards over the text once to mark
+ * where matches can start, then goes forwards once through a second lazy
+ * DFA whose states group the NFA threads by the position they began at.
+ * Where groups meet in a state the earlier start keeps it, and a match
+ * drops every group begun after its own start, so the pass settles each
+ * leftmost-longest match without going back over the text; only the
+ * start of each live group is tracked beside the DFA state.
+ */
+class RegexEngine {
+public:
+    RegexEngine();
+
+    // Compile a pattern, replacing any previous one; on failure see getLastError
+    bool compile(const std::string& pattern);
+
+    // Whether the whole text matches
+    bool match(std::string_view text);
+
+    // Whether the pattern matches anywhere in the text
+    bool search(std::string_view text);
+
+    // Non-empty, non-overlapping matches from left to right, as (start, length) pairs
+    void findAll(std::string_view text, std::vector<std::pair<size_t, size_t>>& matches);
+
+    // DFA states built so far, over both directions
+    size_t getStateCount() const;
+
+    const std::string& getLastError() const;
+
+private:
+    // Pattern syntax tree, compiled once forwards and once backwards
+    struct AstNode {
+        enum Kind : uint8_t { Empty, Set, Concat, Alternate, Repeat, Begin, End, WordBoundary, NotWordBoundary };
+        Kind kind = Empty;
+        int32_t set = -1;               // Index into m_sets for Set
+        int32_t min = 0;                // Repeat bounds; max < 0 means unbounded
+        int32_t max = 0;
+        std::vector<int32_t> children;
+    };
+
+    struct NfaState {
+        enum Kind : uint8_t { Byte, Split, Begin, End, WordBoundary, NotWordBoundary, Match };
+        Kind kind;
+        int32_t out;
+        int32_t out1;                   // Second branch of a Split
+        int32_t set;                    // Bytes a Byte state accepts, as an index into m_sets
+    };
+
+    // One direction of the pattern: its NFA and the DFA built over it so far
+    struct Automaton {
+        std::vector<NfaState> nfa;
+        int32_t anchoredStart = -1;
+        int32_t unanchoredStart = -1;   // Also reaches anchoredStart after any prefix
+
+        // DFA states: kernel NFA states, context flags and one transition per column.
+        // A transition holds (next << 1) | matched, where matched says the pattern had
+        // matched just before the byte was read; -1 is a transition not built yet.
+        std::vector<std::vector<int32_t>> kernels;
+        std::vector<uint8_t> flags;
+        std::vector<int32_t> transitions;
+        std::unordered_map<std::string, int32_t> stateIds;
+        size_t words = 0;               // Rough size of the above, in 4-byte words
+        int32_t starts[2][4];           // [unanchored][flags], -1 until built
+    };
+
+    // findAll's automaton, also over the forward NFA. A state is a list of groups, each
+    // the kernel of the threads begun at one text position, earliest first; where groups
+    // meet in an NFA state the earlier one keeps it. A state has two moves per column,
+    // without and with a group begun at the position.
+    struct GroupMove {
+        int32_t next;
+        int32_t matchedGroup;           // Group that matched just before the byte, or -1
+        uint32_t groupCount;            // Groups of next
+        uint32_t sources;               // Offset in sources of one entry per group of next: the
+                                        // group it came from, or -1 for the one begun here
+        bool keepsStarts;               // Whether each group of next came from the same index
+    };
+
+    struct GroupAutomaton {
+        std::vector<std::vector<int32_t>> layouts;  // Each group's sorted kernel, ended by -1
+        std::vector<uint8_t> flags;
+        std::vector<int32_t> moves;                 // Index into moveTable, -1 until built
+        std::vector<GroupMove> moveTable;
+        std::vector<int32_t> sources;
+        std::unordered_map<std::string, int32_t> stateIds;
+        size_t words = 0;
+        int32_t starts[4];                          // States without groups, by flags
+    };
+
+    std::string m_lastError;
+    bool m_caseInsensitive;
+    bool m_usesBegin;                   // Whether ^ or $ occur, so state flags track the text start
+    bool m_usesWordBoundary;            // Whether \b or \B occur, so flags track the last byte
+    std::vector<AstNode> m_ast;
+    std::vector<std::bitset<256>> m_sets;
+    int32_t m_anySet;                   // Set of all bytes, for the unanchored prefix loop
+
+    // Bytes no pattern set tells apart share a column; one more column is end of text
+    uint16_t m_classOf[256];
+    std::vector<unsigned char> m_classByte;     // A representative byte of each class
+    size_t m_columns;
+
+    Automaton m_forward;
+    Automaton m_reverse;
+    GroupAutomaton m_groups;
+
+    // Scratch for closures, so stepping allocates nothing once states exist
+    std::vector<uint32_t> m_marks;
+    uint32_t m_markGeneration;
+    std::vector<int32_t> m_stack;
+    std::vector<int32_t> m_resolved;
+
+    // Parser; each returns an AST index, or -1 with m_lastError set
+    int32_t parseAlternation(const std::string& pattern, size_t& pos, int depth);
+    int32_t parseConcat(const std::string& pattern, size_t& pos, int depth);
+    int32_t parseRepeat(const std::string& pattern, size_t& pos, int depth);
+    int32_t parseAtom(const std::string& pattern, size_t& pos, int depth);
+    int32_t parseClass(const std::string& pattern, size_t& pos);
+    bool parseEscape(const std::string& pattern, size_t& pos, std::bitset<256>& bytes, int32_t* assertion);
+    int32_t addNode(AstNode::Kind kind);
+    int32_t addSet(std::bitset<256> bytes);
+
+    // Build an automaton's NFA from the syntax tree, returning the entry state of node
+    // followed by next. reverse compiles the mirror image of the pattern.
+    bool buildAutomaton(Automaton& automaton, int32_t root, bool reverse);
+    int32_t emit(Automaton& automaton, int32_t node, int32_t next, bool reverse);
+    int32_t addState(Automaton& automaton, NfaState::Kind kind, int32_t out, int32_t out1, int32_t set);
+    void buildClasses();
+
+    // Lazy DFA
+    void resetDfa(Automaton& automaton);
+    int32_t internState(Automaton& automaton, std::vector<int32_t>& kernel, uint8_t flags);
+    int32_t startState(Automaton& automaton, bool unanchored, bool atStart, bool afterWord);
+    int32_t buildTransition(Automaton& automaton, int32_t state, size_t column);
+    void addKernel(const Automaton& automaton, std::vector<int32_t>& kernel, int32_t state);
+    void nextMarkGeneration();
+
+    // Add the byte states the kernel states between begin and end lead to at a position
+    // with the given context to m_resolved; returns whether the match state was reached
+    bool resolveKernel(const Automaton& automaton, const int32_t* begin, const int32_t* end,
+                       uint8_t flags, bool atEnd, bool beforeWord);
+
+    // Follow the transition from state on a column, building it if needed
+    int32_t step(Automaton& automaton, int32_t state, size_t column) {
+        int32_t next = automaton.transitions[static_cast<size_t>(state) * m_columns + column];
+        return next >= 0 ? next : buildTransition(automaton, state, column);
+    }
+
+    // findAll's group automaton; buildGroupMove returns an index into moveTable
+    void resetGroups();
+    int32_t internGroupState(std::vector<int32_t>& layout, uint8_t flags);
+    int32_t groupStartState(bool atStart, bool afterWord);
+    int32_t buildGroupMove(int32_t state, size_t column, bool spawn);
+};
+
+#endif // REGEX_ENGINE_H
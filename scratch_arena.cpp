@@ -0,0 +1,77 @@
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cstdint>
+
+ScratchArena::ScratchArena(size_t chunkSize)
+    : m_chunkSize(chunkSize), m_currentChunk(0), m_offset(0) {
+    insertChunk(0, m_chunkSize);
+}
+
+ScratchArena::~ScratchArena() {
+}
+
+ScratchArena::Marker ScratchArena::mark() const {
+    return {m_currentChunk, m_offset};
+}
+
+void ScratchArena::rewind(const Marker& marker) {
+    // Everything past the marker is dead, the chunks themselves stay around
+    m_currentChunk = marker.chunk;
+    m_offset = marker.offset;
+}
+
+void ScratchArena::reset() {
+    m_currentChunk = 0;
+    m_offset = 0;
+
+    // Keep only the first chunk so a burst of temporaries doesn't pin memory forever
+    if (m_chunks.size() > 1) {
+        m_chunks.resize(1);
+    }
+}
+
+size_t ScratchArena::getReservedBytes() const {
+    size_t total = 0;
+    for (const auto& chunk : m_chunks) {
+        total += chunk.size;
+    }
+    return total;
+}
+
+void* ScratchArena::do_allocate(size_t bytes, size_t alignment) {
+    while (true) {
+        Chunk& chunk = m_chunks[m_currentChunk];
+        uintptr_t base = reinterpret_cast<uintptr_t>(chunk.data.get());
+        uintptr_t aligned = (base + m_offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        size_t newOffset = (aligned - base) + bytes;
+
+        if (newOffset <= chunk.size) {
+            m_offset = newOffset;
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        // Move on to the next chunk, making room for oversized requests
+        size_t needed = bytes + alignment;
+        if (m_currentChunk + 1 >= m_chunks.size() || m_chunks[m_currentChunk + 1].size < needed) {
+            insertChunk(m_currentChunk + 1, needed);
+        }
+
+        m_currentChunk++;
+        m_offset = 0;
+    }
+}
+
+void ScratchArena::do_deallocate(void* /*p*/, size_t /*bytes*/, size_t /*alignment*/) {
+    // Individual frees are no-ops, memory comes back when a scope rewinds
+}
+
+bool ScratchArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+void ScratchArena::insertChunk(size_t index, size_t minSize) {
+    Chunk chunk;
+    chunk.size = std::max(m_chunkSize, minSize);
+    chunk.data.reset(new std::byte[chunk.size]);
+    m_chunks.insert(m_chunks.begin() + index, std::move(chunk));
+}
@@ -0,0 +1,71 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+/**
+ * Bump allocator for short-lived interpreter temporaries.
+ * Allocations are carved out of large chunks and never freed individually;
+ * a Scope records the current position and rewinds to it when it ends, so
+ * nested statements release their temporaries in LIFO order.
+ */
+class ScratchArena : public std::pmr::memory_resource {
+public:
+    // Position inside the arena, used to rewind a scope
+    struct Marker {
+        size_t chunk;
+        size_t offset;
+    };
+
+    // Rewinds the arena to where it was when the scope was opened
+    class Scope {
+    public:
+        explicit Scope(ScratchArena& arena) : m_arena(arena), m_marker(arena.mark()) {}
+        ~Scope() { m_arena.rewind(m_marker); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        ScratchArena& m_arena;
+        Marker m_marker;
+    };
+
+    explicit ScratchArena(size_t chunkSize = 64 * 1024);
+    ~ScratchArena() override;
+
+    // Get the current position
+    Marker mark() const;
+
+    // Release everything allocated after the marker (chunks are kept for reuse)
+    void rewind(const Marker& marker);
+
+    // Release everything and return all but the first chunk to the system
+    void reset();
+
+    // Total bytes currently reserved from the system
+    size_t getReservedBytes() const;
+
+private:
+    struct Chunk {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    std::vector<Chunk> m_chunks;
+    size_t m_chunkSize;
+    size_t m_currentChunk;
+    size_t m_offset;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    // Allocate a new chunk large enough for the given request at the given position
+    void insertChunk(size_t index, size_t minSize);
+};
+
+#endif // SCRATCH_ARENA_H
@@ -0,0 +1,465 @@
+#include "string_kernels.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FLARE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Sets of up to this many bytes are matched with one vector compare per byte
+    constexpr size_t kMaxVectorSet = 16;
+
+    struct Kernels {
+        const char* name;
+        // needleSize is at least 2 and at most size
+        size_t (*find)(const char* text, size_t size, const char* needle, size_t needleSize);
+        // count is between 1 and kMaxVectorSet
+        size_t (*findAnyOf)(const char* text, size_t size, const char* bytes, size_t count);
+        // Index of the first non-whitespace byte, or size
+        size_t (*skipSpace)(const char* text, size_t size);
+        // One past the last non-whitespace byte, or 0
+        size_t (*skipSpaceBack)(const char* text, size_t size);
+        void (*split)(const char* text, size_t size, char delimiter, std::vector<std::string_view>& parts);
+    };
+
+    inline bool isSpace(unsigned char c) {
+        return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+    }
+
+    // Scalar kernels, also used for the tails the vector loops leave over
+
+    size_t findScalar(const char* text, size_t size, const char* needle, size_t needleSize) {
+        return std::string_view(text, size).find(std::string_view(needle, needleSize));
+    }
+
+    size_t findAnyOfScalar(const char* text, size_t size, const char* bytes, size_t count) {
+        for (size_t i = 0; i < size; i++) {
+            if (std::memchr(bytes, text[i], count) != nullptr) {
+                return i;
+            }
+        }
+        return StringKernels::npos;
+    }
+
+    size_t skipSpaceScalar(const char* text, size_t size) {
+        size_t i = 0;
+        while (i < size && isSpace(static_cast<unsigned char>(text[i]))) {
+            i++;
+        }
+        return i;
+    }
+
+    size_t skipSpaceBackScalar(const char* text, size_t size) {
+        while (size > 0 && isSpace(static_cast<unsigned char>(text[size - 1]))) {
+            size--;
+        }
+        return size;
+    }
+
+    void splitScalar(const char* text, size_t size, char delimiter, std::vector<std::string_view>& parts) {
+        size_t start = 0;
+        for (size_t i = 0; i < size; i++) {
+            if (text[i] == delimiter) {
+                parts.emplace_back(text + start, i - start);
+                start = i + 1;
+            }
+        }
+        parts.emplace_back(text + start, size - start);
+    }
+
+    const Kernels kScalarKernels = {
+        "scalar", findScalar, findAnyOfScalar, skipSpaceScalar, skipSpaceBackScalar, splitScalar
+    };
+
+    // Shift a tail result from a scalar kernel back to the caller's offsets
+    inline size_t offsetResult(size_t result, size_t offset) {
+        return result == StringKernels::npos ? result : result + offset;
+    }
+
+#ifdef FLARE_X86_KERNELS
+    // SSE2 kernels. SSE2 is part of every x86-64 CPU, so these need no check.
+    // Substring search compares the needle's first and last bytes against 16
+    // positions at once and only runs memcmp where both match.
+
+    inline __m128i spaceMaskSse2(__m128i block) {
+        // Whitespace is ' ' or a byte in '\t'..'\r'
+        __m128i shifted = _mm_sub_epi8(block, _mm_set1_epi8('\t'));
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('\r' - '\t')), shifted);
+        return _mm_or_si128(control, _mm_cmpeq_epi8(block, _mm_set1_epi8(' ')));
+    }
+
+    size_t findSse2(const char* text, size_t size, const char* needle, size_t needleSize) {
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i last = _mm_set1_epi8(needle[needleSize - 1]);
+        size_t i = 0;
+        for (; i + needleSize - 1 + 16 <= size; i += 16) {
+            __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+            __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + needleSize - 1));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last))));
+            while (mask != 0) {
+                unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+                if (std::memcmp(text + i + bit + 1, needle + 1, needleSize - 2) == 0) {
+                    return i + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+        return offsetResult(findScalar(text + i, size - i, needle, needleSize), i);
+    }
+
+    size_t findAnyOfSse2(const char* text, size_t size, const char* bytes, size_t count) {
+        __m128i targets[kMaxVectorSet];
+        for (size_t k = 0; k < count; k++) {
+            targets[k] = _mm_set1_epi8(bytes[k]);
+        }
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+            __m128i hits = _mm_cmpeq_epi8(block, targets[0]);
+            for (size_t k = 1; k < count; k++) {
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, targets[k]));
+            }
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+            if (mask != 0) {
+                return i + static_cast<size_t>(__builtin_ctz(mask));
+            }
+        }
+        return offsetResult(findAnyOfScalar(text + i, size - i, bytes, count), i);
+    }
+
+    size_t skipSpaceSse2(const char* text, size_t size) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(spaceMaskSse2(block))) ^ 0xFFFFu;
+            if (mask != 0) {
+                return i + static_cast<size_t>(__builtin_ctz(mask));
+            }
+        }
+        return i + skipSpaceScalar(text + i, size - i);
+    }
+
+    size_t skipSpaceBackSse2(const char* text, size_t size) {
+        for (; size >= 16; size -= 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + size - 16));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(spaceMaskSse2(block))) ^ 0xFFFFu;
+            if (mask != 0) {
+                return size - 16 + static_cast<size_t>(32 - __builtin_clz(mask));
+            }
+        }
+        return skipSpaceBackScalar(text, size);
+    }
+
+    void splitSse2(const char* text, size_t size, char delimiter, std::vector<std::string_view>& parts) {
+        const __m128i target = _mm_set1_epi8(delimiter);
+        size_t start = 0;
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, target)));
+            while (mask != 0) {
+                size_t pos = i + static_cast<size_t>(__builtin_ctz(mask));
+                parts.emplace_back(text + start, pos - start);
+                start = pos + 1;
+                mask &= mask - 1;
+            }
+        }
+        for (; i < size; i++) {
+            if (text[i] == delimiter) {
+                parts.emplace_back(text + start, i - start);
+                start = i + 1;
+            }
+        }
+        parts.emplace_back(text + start, size - start);
+    }
+
+    const Kernels kSse2Kernels = {
+        "sse2", findSse2, findAnyOfSse2, skipSpaceSse2, skipSpaceBackSse2, splitSse2
+    };
+
+    // AVX2 kernels: the same algorithms over 32 bytes per step, compiled for AVX2
+    // on their own so the rest of the binary still runs on any x86-64 CPU.
+    // Tails shorter than a step go to the SSE2 kernels, after clearing the upper
+    // register halves; legacy SSE code running with them dirty stalls on every
+    // instruction, which cost more than the whole scan on short strings.
+
+#define FLARE_TARGET_AVX2 __attribute__((target("avx2")))
+
+    FLARE_TARGET_AVX2 inline __m256i spaceMaskAvx2(__m256i block) {
+        __m256i shifted = _mm256_sub_epi8(block, _mm256_set1_epi8('\t'));
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8('\r' - '\t')), shifted);
+        return _mm256_or_si256(control, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')));
+    }
+
+    FLARE_TARGET_AVX2 size_t findAvx2(const char* text, size_t size, const char* needle, size_t needleSize) {
+        const __m256i first = _mm256_set1_epi8(needle[0]);
+        const __m256i last = _mm256_set1_epi8(needle[needleSize - 1]);
+        size_t i = 0;
+        // Two blocks per step, so the loop branch is taken once per 64 positions
+        for (; i + needleSize - 1 + 64 <= size; i += 64) {
+            const char* lastBytes = text + i + needleSize - 1;
+            __m256i low = _mm256_and_si256(
+                _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i)), first),
+                _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lastBytes)), last));
+            __m256i high = _mm256_and_si256(
+                _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + 32)), first),
+                _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lastBytes + 32)), last));
+            if (_mm256_testz_si256(_mm256_or_si256(low, high), _mm256_or_si256(low, high))) {
+                continue;
+            }
+            uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(low)) |
+                            (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(high))) << 32);
+            while (mask != 0) {
+                size_t bit = static_cast<size_t>(__builtin_ctzll(mask));
+                if (std::memcmp(text + i + bit + 1, needle + 1, needleSize - 2) == 0) {
+                    return i + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+        _mm256_zeroupper();
+        return offsetResult(findSse2(text + i, size - i, needle, needleSize), i);
+    }
+
+    FLARE_TARGET_AVX2 size_t findAnyOfAvx2(const char* text, size_t size, const char* bytes, size_t count) {
+        __m256i targets[kMaxVectorSet];
+        for (size_t k = 0; k < count; k++) {
+            targets[k] = _mm256_set1_epi8(bytes[k]);
+        }
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+            __m256i hits = _mm256_cmpeq_epi8(block, targets[0]);
+            for (size_t k = 1; k < count; k++) {
+                hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, targets[k]));
+            }
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+            if (mask != 0) {
+                return i + static_cast<size_t>(__builtin_ctz(mask));
+            }
+        }
+        _mm256_zeroupper();
+        return offsetResult(findAnyOfSse2(text + i, size - i, bytes, count), i);
+    }
+
+    FLARE_TARGET_AVX2 size_t skipSpaceAvx2(const char* text, size_t size) {
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+            unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(spaceMaskAvx2(block)));
+            if (mask != 0) {
+                return i + static_cast<size_t>(__builtin_ctz(mask));
+            }
+        }
+        _mm256_zeroupper();
+        return i + skipSpaceSse2(text + i, size - i);
+    }
+
+    FLARE_TARGET_AVX2 size_t skipSpaceBackAvx2(const char* text, size_t size) {
+        for (; size >= 32; size -= 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + size - 32));
+            unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(spaceMaskAvx2(block)));
+            if (mask != 0) {
+                return size - 32 + static_cast<size_t>(32 - __builtin_clz(mask));
+            }
+        }
+        _mm256_zeroupper();
+        return skipSpaceBackSse2(text, size);
+    }
+
+    FLARE_TARGET_AVX2 void splitAvx2(const char* text, size_t size, char delimiter, std::vector<std::string_view>& parts) {
+        const __m256i target = _mm256_set1_epi8(delimiter);
+        size_t start = 0;
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, target)));
+            while (mask != 0) {
+                size_t pos = i + static_cast<size_t>(__builtin_ctz(mask));
+                parts.emplace_back(text + start, pos - start);
+                start = pos + 1;
+                mask &= mask - 1;
+            }
+        }
+        for (; i < size; i++) {
+            if (text[i] == delimiter) {
+                parts.emplace_back(text + start, i - start);
+                start = i + 1;
+            }
+        }
+        parts.emplace_back(text + start, size - start);
+    }
+
+#undef FLARE_TARGET_AVX2
+
+    const Kernels kAvx2Kernels = {
+        "avx2", findAvx2, findAnyOfAvx2, skipSpaceAvx2, skipSpaceBackAvx2, splitAvx2
+    };
+#endif
+
+    const Kernels& selectKernels() {
+        // FLARE_STRING_KERNELS=scalar|sse2 caps the choice, for comparing implementations
+        const char* cap = std::getenv("FLARE_STRING_KERNELS");
+        std::string_view limit = cap != nullptr ? cap : "";
+        if (limit == "scalar") {
+            return kScalarKernels;
+        }
+#ifdef FLARE_X86_KERNELS
+        __builtin_cpu_init();
+        if (limit != "sse2" && __builtin_cpu_supports("avx2")) {
+            return kAvx2Kernels;
+        }
+        return kSse2Kernels;
+#else
+        return kScalarKernels;
+#endif
+    }
+
+    const Kernels& kernels() {
+        static const Kernels& selected = selectKernels();
+        return selected;
+    }
+}
+
+namespace StringKernels {
+    size_t find(std::string_view text, std::string_view needle, size_t from) {
+        if (from > text.size()) {
+            return npos;
+        }
+        if (needle.empty()) {
+            return from;
+        }
+        if (needle.size() > text.size() - from) {
+            return npos;
+        }
+
+        // Look for the first byte with memchr first: when it is rare in the text that
+        // settles the search at memchr speed, and when it is common the vector filter
+        // on first and last bytes takes over from the first candidate on
+        const void* found = std::memchr(text.data() + from, needle[0], text.size() - from - needle.size() + 1);
+        if (found == nullptr) {
+            return npos;
+        }
+        size_t candidate = static_cast<size_t>(static_cast<const char*>(found) - text.data());
+        if (std::memcmp(text.data() + candidate + 1, needle.data() + 1, needle.size() - 1) == 0) {
+            return candidate;
+        }
+        if (text.size() - candidate - 1 < needle.size()) {
+            return npos;
+        }
+        from = candidate + 1;
+        return offsetResult(kernels().find(text.data() + from, text.size() - from, needle.data(), needle.size()), from);
+    }
+
+    size_t findAnyOf(std::string_view text, std::string_view bytes, size_t from) {
+        if (from >= text.size() || bytes.empty()) {
+            return npos;
+        }
+        if (bytes.size() == 1) {
+            const void* found = std::memchr(text.data() + from, bytes[0], text.size() - from);
+            return found != nullptr ? static_cast<size_t>(static_cast<const char*>(found) - text.data()) : npos;
+        }
+        if (bytes.size() <= kMaxVectorSet) {
+            return offsetResult(kernels().findAnyOf(text.data() + from, text.size() - from, bytes.data(), bytes.size()), from);
+        }
+
+        // Large sets go through a lookup table instead
+        bool inSet[256] = {};
+        for (char c : bytes) {
+            inSet[static_cast<unsigned char>(c)] = true;
+        }
+        for (size_t i = from; i < text.size(); i++) {
+            if (inSet[static_cast<unsigned char>(text[i])]) {
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    std::string_view trim(std::string_view text) {
+        // Most strings have nothing to trim, which two byte checks settle
+        if (text.empty() || (!isSpace(static_cast<unsigned char>(text.front())) &&
+                             !isSpace(static_cast<unsigned char>(text.back())))) {
+            return text;
+        }
+        const Kernels& active = kernels();
+        size_t start = active.skipSpace(text.data(), text.size());
+        if (start == text.size()) {
+            return text.substr(start);
+        }
+        size_t end = start + active.skipSpaceBack(text.data() + start, text.size() - start);
+        return text.substr(start, end - start);
+    }
+
+    void split(std::string_view text, char delimiter, std::vector<std::string_view>& parts) {
+        kernels().split(text.data(), text.size(), delimiter, parts);
+    }
+
+    std::string replaceAll(std::string_view text, std::string_view from, std::string_view to) {
+        std::string result;
+        if (from.empty()) {
+            result.assign(text);
+            return result;
+        }
+
+        result.reserve(text.size());
+        size_t copied = 0;
+        size_t pos = find(text, from);
+        while (pos != npos) {
+            result.append(text, copied, pos - copied);
+            result.append(to);
+            copied = pos + from.size();
+            pos = find(text, from, copied);
+        }
+        result.append(text, copied, npos);
+        return result;
+    }
+
+    std::string replaceAll(std::string_view text, const std::vector<std::string_view>& from,
+                           const std::vector<std::string_view>& to) {
+        if (from.size() == 1 && to.size() == 1) {
+            return replaceAll(text, from[0], to[0]);
+        }
+
+        // Candidate positions are the ones holding the first byte of some pattern
+        std::string firstBytes;
+        for (std::string_view pattern : from) {
+            if (!pattern.empty() && firstBytes.find(pattern[0]) == std::string::npos) {
+                firstBytes.push_back(pattern[0]);
+            }
+        }
+
+        std::string result;
+        result.reserve(text.size());
+        size_t copied = 0;
+        size_t pos = findAnyOf(text, firstBytes);
+        while (pos != npos) {
+            size_t matched = npos;
+            for (size_t i = 0; i < from.size() && i < to.size(); i++) {
+                if (!from[i].empty() && text.compare(pos, from[i].size(), from[i]) == 0) {
+                    matched = i;
+                    break;
+                }
+            }
+
+            if (matched == npos) {
+                pos = findAnyOf(text, firstBytes, pos + 1);
+                continue;
+            }
+            result.append(text, copied, pos - copied);
+            result.append(to[matched]);
+            copied = pos + from[matched].size();
+            pos = findAnyOf(text, firstBytes, copied);
+        }
+        result.append(text, copied, npos);
+        return result;
+    }
+
+    const char* getImplementationName() {
+        return kernels().name;
+    }
+}
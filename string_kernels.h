@@ -0,0 +1,44 @@
+#ifndef STRING_KERNELS_H
+#define STRING_KERNELS_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Byte-scanning kernels behind Utils and the string builtins.
+ * Each kernel has an AVX2, an SSE2 and a plain scalar version; the widest
+ * one the CPU supports is picked once, the first time any kernel runs.
+ * The SIMD versions test 16 or 32 bytes per step and only fall back to a
+ * byte comparison at the few positions that survive the vector filter.
+ * Whitespace means the same bytes as std::isspace in the "C" locale.
+ */
+namespace StringKernels {
+    constexpr size_t npos = std::string_view::npos;
+
+    // Position of the first occurrence of needle at or after from, or npos
+    size_t find(std::string_view text, std::string_view needle, size_t from = 0);
+
+    // Position of the first byte at or after from that is one of bytes, or npos
+    size_t findAnyOf(std::string_view text, std::string_view bytes, size_t from = 0);
+
+    // text without leading and trailing whitespace
+    std::string_view trim(std::string_view text);
+
+    // Append the pieces of text between delimiters to parts; n delimiters give n + 1 pieces
+    void split(std::string_view text, char delimiter, std::vector<std::string_view>& parts);
+
+    // Replace every occurrence of from with to, left to right, in one pass
+    std::string replaceAll(std::string_view text, std::string_view from, std::string_view to);
+
+    // Replace occurrences of any from[i] with to[i] in one left-to-right pass. Where
+    // several patterns match at the same position, the one listed first wins.
+    std::string replaceAll(std::string_view text, const std::vector<std::string_view>& from,
+                           const std::vector<std::string_view>& to);
+
+    // Name of the kernel set in use: "avx2", "sse2" or "scalar"
+    const char* getImplementationName();
+}
+
+#endif // STRING_KERNELS_H
@@ -0,0 +1,205 @@
+#include "text_index.h"
+#include <cctype>
+
+TextIndex::TextIndex() : m_totalLength(0), m_postingBytes(0) {
+}
+
+void TextIndex::tokenize(std::string_view text, std::vector<std::string>& terms) {
+    // Runs of ASCII letters and digits, lowercased; bytes above 0x7f count as letters so
+    // UTF-8 words stay whole
+    size_t i = 0;
+    while (i < text.size()) {
+        while (i < text.size() && !(std::isalnum(static_cast<unsigned char>(text[i])) ||
+                                    static_cast<unsigned char>(text[i]) >= 0x80)) {
+            i++;
+        }
+        if (i == text.size()) {
+            break;
+        }
+
+        std::string term;
+        while (i < text.size() && (std::isalnum(static_cast<unsigned char>(text[i])) ||
+                                   static_cast<unsigned char>(text[i]) >= 0x80)) {
+            char c = text[i++];
+            term.push_back(c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c);
+        }
+        terms.push_back(std::move(term));
+    }
+}
+
+void TextIndex::writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void TextIndex::add(std::string_view key, std::string_view text) {
+    remove(key);
+
+    m_terms.clear();
+    tokenize(text, m_terms);
+    m_counts.clear();
+    for (auto& term : m_terms) {
+        m_counts[std::move(term)]++;
+    }
+
+    uint32_t doc = static_cast<uint32_t>(m_docs.size());
+    m_docs.push_back({std::string(key), static_cast<uint32_t>(m_terms.size()), true});
+    m_docIds.emplace(std::string(key), doc);
+    m_totalLength += m_terms.size();
+
+    for (const auto& termCount : m_counts) {
+        auto inserted = m_termIds.emplace(termCount.first, static_cast<uint32_t>(m_postings.size()));
+        if (inserted.second) {
+            m_postings.emplace_back();
+        }
+        Postings& list = m_postings[inserted.first->second];
+
+        // Deltas restart at each block, from the last document of the block before
+        size_t before = list.bytes.size() + list.dense.size();
+        if (list.blocks.empty() || list.blocks.back().count == kBlockSize) {
+            uint32_t base = list.blocks.empty() ? 0 : list.blocks.back().lastDoc;
+            list.blocks.push_back({base, static_cast<uint32_t>(list.bytes.size()), 0});
+        }
+        Block& block = list.blocks.back();
+        writeVarint(list.bytes, doc - block.lastDoc);
+        writeVarint(list.bytes, termCount.second);
+        block.lastDoc = doc;
+        block.count++;
+        list.documents++;
+        list.maxCount = std::max(list.maxCount, termCount.second);
+        list.minLength = std::min(list.minLength, static_cast<uint32_t>(m_terms.size()));
+
+        if (!list.dense.empty()) {
+            list.dense.resize(doc + 1, 0);
+            list.dense[doc] = static_cast<uint8_t>(std::min(termCount.second, 255u));
+        } else if (list.documents >= kDenseMinimum && list.documents * 4 >= m_docs.size()) {
+            makeDense(list);
+        }
+        m_postingBytes += list.bytes.size() + list.dense.size() - before;
+    }
+}
+
+void TextIndex::makeDense(Postings& list) {
+    Cursor cursor;
+    for (cursor.start(list); cursor.doc != UINT32_MAX; cursor.next()) {
+        list.dense.resize(cursor.doc + 1, 0);
+        list.dense[cursor.doc] = static_cast<uint8_t>(std::min(cursor.count, 255u));
+    }
+}
+
+bool TextIndex::remove(std::string_view key) {
+    auto found = m_docIds.find(std::string(key));
+    if (found == m_docIds.end()) {
+        return false;
+    }
+    Document& document = m_docs[found->second];
+    document.live = false;
+    m_totalLength -= document.length;
+    m_docIds.erase(found);
+    return true;
+}
+
+void TextIndex::clear() {
+    m_docs.clear();
+    m_docIds.clear();
+    m_termIds.clear();
+    m_postings.clear();
+    m_totalLength = 0;
+    m_postingBytes = 0;
+}
+
+size_t TextIndex::size() const {
+    return m_docIds.size();
+}
+
+size_t TextIndex::getDocumentCount() const {
+    return m_docs.size();
+}
+
+size_t TextIndex::getTermCount() const {
+    return m_termIds.size();
+}
+
+size_t TextIndex::getPostingBytes() const {
+    return m_postingBytes;
+}
+
+// Cursor
+
+void TextIndex::Cursor::start(const Postings& list) {
+    postings = &list;
+    block = 0;
+    pos = 0;
+    left = list.blocks.empty() ? 0 : list.blocks[0].count;
+    doc = 0;
+    count = 0;
+    if (left == 0) {
+        doc = UINT32_MAX;
+        return;
+    }
+    next();
+}
+
+void TextIndex::Cursor::next() {
+    if (left == 0) {
+        if (++block >= postings->blocks.size()) {
+            doc = UINT32_MAX;
+            return;
+        }
+        pos = postings->blocks[block].offset;
+        left = postings->blocks[block].count;
+        doc = postings->blocks[block - 1].lastDoc;
+    }
+
+    const uint8_t* bytes = postings->bytes.data();
+    uint32_t values[2];
+    for (uint32_t& value : values) {
+        value = 0;
+        for (int shift = 0; ; shift += 7) {
+            uint8_t byte = bytes[pos++];
+            value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if (byte < 0x80) {
+                break;
+            }
+        }
+    }
+    doc += values[0];
+    count = values[1];
+    left--;
+}
+
+void TextIndex::Cursor::seek(uint32_t target) {
+    if (doc >= target) {
+        return;
+    }
+
+    // Whole blocks that end before target are skipped without decoding
+    if (postings->blocks[block].lastDoc < target) {
+        while (block + 1 < postings->blocks.size() && postings->blocks[block + 1].lastDoc < target) {
+            block++;
+        }
+        if (block + 1 >= postings->blocks.size()) {
+            doc = UINT32_MAX;
+            return;
+        }
+        left = 0;
+    }
+    while (doc < target) {
+        next();
+    }
+}
+
+uint32_t TextIndex::Cursor::countAt(uint32_t target) {
+    const std::vector<uint8_t>& dense = postings->dense;
+    if (!dense.empty()) {
+        uint32_t value = target < dense.size() ? dense[target] : 0;
+        if (value < 255) {
+            return value;
+        }
+    }
+    seek(target);
+    return doc == target ? count : 0;
+}
@@ -0,0 +1,251 @@
+#ifndef TEXT_INDEX_H
+#define TEXT_INDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A document found by TextIndex::search
+struct SearchHit {
+    std::string key;
+    float score;
+};
+
+/**
+ * Inverted index over short texts, each stored under a key, used as the
+ * full-text index of a FlameMemory container. Texts are split into
+ * lowercase runs of letters and digits.
+ *
+ * Every term has a posting list of (document, term count) pairs, kept as
+ * varint deltas in blocks of 128 with each block's last document alongside,
+ * so a list can be skipped forward a block at a time without decoding it.
+ * Queries are ranked by BM25, walking all the query's lists together in
+ * document order. Once k results are held, the common terms whose best
+ * possible contributions together can't lift a document into them stop
+ * proposing documents; they are only probed, by skipping, for documents
+ * the rarer terms found, so common words cost little however many
+ * documents contain them. Terms in a quarter or more of the documents also
+ * keep a count per document, so probing them is a single load instead of
+ * decoding into the middle of a block.
+ *
+ * Documents get increasing ids, so postings are only ever appended.
+ * Replacing or removing a key leaves its old postings behind as dead;
+ * callers rebuild once dead documents outnumber live ones.
+ */
+class TextIndex {
+public:
+    TextIndex();
+
+    // Index text under key, replacing whatever was indexed for the key before
+    void add(std::string_view key, std::string_view text);
+
+    // Stop returning key; returns false if it wasn't indexed
+    bool remove(std::string_view key);
+
+    // Remove everything
+    void clear();
+
+    // Live keys, and all documents including replaced and removed ones
+    size_t size() const;
+    size_t getDocumentCount() const;
+
+    // Distinct terms, and bytes of postings, compressed lists and dense counts together
+    size_t getTermCount() const;
+    size_t getPostingBytes() const;
+
+    // Up to k keys best matching query, best first. isLive(key) is asked about each
+    // document before it is returned; documents it rejects are removed.
+    template <typename Func>
+    void search(std::string_view query, size_t k, std::vector<SearchHit>& hits, Func isLive);
+
+    // Append the terms of text to terms
+    static void tokenize(std::string_view text, std::vector<std::string>& terms);
+
+private:
+    static constexpr size_t kBlockSize = 128;
+    static constexpr float kK1 = 1.2f;
+    static constexpr float kB = 0.75f;
+    static constexpr uint32_t kDenseMinimum = 1024;    // Shortest list given dense counts
+
+    struct Block {
+        uint32_t lastDoc;               // Last document in the block
+        uint32_t offset;                // Where the block starts in Postings::bytes
+        uint32_t count;
+    };
+
+    struct Postings {
+        std::vector<uint8_t> bytes;     // (doc delta, count) varint pairs; deltas restart per block
+        std::vector<Block> blocks;
+        uint32_t documents = 0;         // Documents containing the term, dead ones included
+        uint32_t maxCount = 0;          // Largest count and shortest document in the list,
+        uint32_t minLength = UINT32_MAX;    // for score bounds
+        std::vector<uint8_t> dense;     // Count by document, capped at 255, once the term is common
+    };
+
+    struct Document {
+        std::string key;
+        uint32_t length;                // Terms in the text
+        bool live;
+    };
+
+    // Walks one posting list in document order
+    struct Cursor {
+        const Postings* postings;
+        size_t block;
+        size_t pos;                     // Next byte to decode
+        uint32_t left;                  // Postings left in the current block
+        uint32_t doc;                   // Current document, or UINT32_MAX when done
+        uint32_t count;
+        float idf;
+        float bound;                    // Highest score this term can add
+
+        void start(const Postings& list);
+        void next();
+        void seek(uint32_t target);     // First document >= target
+
+        // Count in document target, which must not be before the current one; lists
+        // with dense counts answer without moving
+        uint32_t countAt(uint32_t target);
+    };
+
+    std::vector<Document> m_docs;
+    std::unordered_map<std::string, uint32_t> m_docIds;         // Live documents by key
+    std::unordered_map<std::string, uint32_t> m_termIds;
+    std::vector<Postings> m_postings;
+    uint64_t m_totalLength;             // Of live documents
+    size_t m_postingBytes;
+
+    // Scratch reused across calls
+    std::vector<std::string> m_terms;
+    std::unordered_map<std::string, uint32_t> m_counts;
+
+    // BM25 weight of a term seen count times in a document of the given length
+    static float termScore(float idf, uint32_t count, uint32_t length, float averageLength) {
+        float norm = kK1 * (1.0f - kB + kB * static_cast<float>(length) / averageLength);
+        return idf * (static_cast<float>(count) * (kK1 + 1.0f)) / (static_cast<float>(count) + norm);
+    }
+
+    static void writeVarint(std::vector<uint8_t>& out, uint32_t value);
+
+    // Give a list dense counts, filled in from its postings
+    void makeDense(Postings& list);
+};
+
+template <typename Func>
+void TextIndex::search(std::string_view query, size_t k, std::vector<SearchHit>& hits, Func isLive) {
+    hits.clear();
+    if (k == 0 || m_docIds.empty()) {
+        return;
+    }
+
+    // One cursor per distinct known query term
+    m_terms.clear();
+    tokenize(query, m_terms);
+    std::sort(m_terms.begin(), m_terms.end());
+    m_terms.erase(std::unique(m_terms.begin(), m_terms.end()), m_terms.end());
+
+    float documents = static_cast<float>(m_docs.size());
+    float averageLength = std::max(1.0f, static_cast<float>(m_totalLength) / static_cast<float>(m_docIds.size()));
+    std::vector<Cursor> cursors;
+    for (const auto& term : m_terms) {
+        auto found = m_termIds.find(term);
+        if (found == m_termIds.end()) {
+            continue;
+        }
+        const Postings& list = m_postings[found->second];
+        float frequency = static_cast<float>(list.documents);
+
+        Cursor cursor;
+        cursor.start(list);
+        cursor.idf = std::log(1.0f + (documents - frequency + 0.5f) / (frequency + 0.5f));
+        cursor.bound = termScore(cursor.idf, list.maxCount, list.minLength, averageLength);
+        cursors.push_back(cursor);
+    }
+    if (cursors.empty()) {
+        return;
+    }
+
+    // Lowest bound first; bounds[i] is what cursors 0..i can add together
+    std::sort(cursors.begin(), cursors.end(), [](const Cursor& a, const Cursor& b) {
+        return a.bound < b.bound;
+    });
+    std::vector<float> bounds(cursors.size());
+    float sum = 0.0f;
+    for (size_t i = 0; i < cursors.size(); i++) {
+        sum += cursors[i].bound;
+        bounds[i] = sum;
+    }
+
+    // The best k so far, in a heap with the weakest on top; ties go to the earlier document
+    struct Candidate {
+        float score;
+        uint32_t doc;
+    };
+    auto better = [](const Candidate& a, const Candidate& b) {
+        return a.score > b.score || (a.score == b.score && a.doc < b.doc);
+    };
+    std::vector<Candidate> best;
+
+    float threshold = 0.0f;
+
+    // Cursors below firstEssential can't reach the threshold by themselves, so they
+    // never propose documents, only score the ones the others propose
+    size_t firstEssential = 0;
+    while (true) {
+        uint32_t doc = UINT32_MAX;
+        for (size_t i = firstEssential; i < cursors.size(); i++) {
+            doc = std::min(doc, cursors[i].doc);
+        }
+        if (doc == UINT32_MAX) {
+            break;
+        }
+
+        const Document& document = m_docs[doc];
+        float score = 0.0f;
+        for (size_t i = firstEssential; i < cursors.size(); i++) {
+            if (cursors[i].doc == doc) {
+                score += termScore(cursors[i].idf, cursors[i].count, document.length, averageLength);
+                cursors[i].next();
+            }
+        }
+        for (size_t i = firstEssential; i-- > 0 && score + bounds[i] >= threshold; ) {
+            uint32_t count = cursors[i].countAt(doc);
+            if (count > 0) {
+                score += termScore(cursors[i].idf, count, document.length, averageLength);
+            }
+        }
+
+        if (!document.live || (best.size() == k && score <= threshold)) {
+            continue;
+        }
+        if (!isLive(std::string_view(document.key))) {
+            remove(document.key);
+            continue;
+        }
+
+        best.push_back({score, doc});
+        std::push_heap(best.begin(), best.end(), better);
+        if (best.size() > k) {
+            std::pop_heap(best.begin(), best.end(), better);
+            best.pop_back();
+        }
+        if (best.size() == k) {
+            threshold = best.front().score;
+            while (firstEssential < cursors.size() && bounds[firstEssential] < threshold) {
+                firstEssential++;
+            }
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end(), better);
+    for (const Candidate& candidate : best) {
+        hits.push_back({m_docs[candidate.doc].key, candidate.score});
+    }
+}
+
+#endif // TEXT_INDEX_H
@@ -0,0 +1,88 @@
+#include "timer_wheel.h"
+
+TimerWheel::TimerWheel() : m_currentTick(0), m_count(0) {
+}
+
+TimerWheel::~TimerWheel() {
+}
+
+void TimerWheel::add(uint64_t deadline, uint64_t target) {
+    m_count++;
+    if (deadline <= m_currentTick) {
+        m_due.push_back({deadline, target});
+        return;
+    }
+    place({deadline, target});
+}
+
+void TimerWheel::place(const WheelTimer& timer) {
+    uint64_t delta = timer.deadline - m_currentTick;
+
+    for (size_t level = 0; level < kLevels; level++) {
+        uint64_t span = static_cast<uint64_t>(1) << (kSlotBits * (level + 1));
+        if (delta < span || level == kLevels - 1) {
+            // Deadlines past the last level wait in its furthest slot and cascade again later
+            uint64_t deadline = delta < span ? timer.deadline : m_currentTick + span - 1;
+            size_t slot = (deadline >> (kSlotBits * level)) & (kSlots - 1);
+            m_slots[level][slot].push_back(timer);
+            return;
+        }
+    }
+}
+
+void TimerWheel::cascade(size_t level) {
+    size_t slot = (m_currentTick >> (kSlotBits * level)) & (kSlots - 1);
+    std::vector<WheelTimer> timers;
+    timers.swap(m_slots[level][slot]);
+    for (const auto& timer : timers) {
+        if (timer.deadline <= m_currentTick) {
+            m_due.push_back(timer);
+        } else {
+            place(timer);
+        }
+    }
+}
+
+void TimerWheel::advance(uint64_t now, std::vector<WheelTimer>& out) {
+    while (true) {
+        if (!m_due.empty()) {
+            m_count -= m_due.size();
+            out.insert(out.end(), m_due.begin(), m_due.end());
+            m_due.clear();
+        }
+
+        if (m_currentTick >= now) {
+            break;
+        }
+
+        // Nothing pending: jump straight to now
+        if (m_count == 0) {
+            m_currentTick = now;
+            break;
+        }
+
+        m_currentTick++;
+
+        // When a level wraps round, bring the next coarser slot down first
+        for (size_t level = 1; level < kLevels; level++) {
+            if ((m_currentTick & ((static_cast<uint64_t>(1) << (kSlotBits * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+
+        std::vector<WheelTimer>& slot = m_slots[0][m_currentTick & (kSlots - 1)];
+        for (const auto& timer : slot) {
+            m_due.push_back(timer);
+        }
+        slot.clear();
+    }
+}
+
+uint64_t TimerWheel::getCurrentTick() const {
+    return m_currentTick;
+}
+
+size_t TimerWheel::size() const {
+    return m_count;
+}
@@ -0,0 +1,55 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A scheduled expiry; target is an opaque ID chosen by the caller
+struct WheelTimer {
+    uint64_t deadline;
+    uint64_t target;
+};
+
+/**
+ * Hierarchical timing wheel with millisecond ticks.
+ * Five levels of 64 slots cover about twelve days; a timer sits in the
+ * coarsest level that still resolves its deadline and moves down a level
+ * each time that slot comes round. Each tick only looks at one slot, so
+ * expiring timers never scans the set of pending ones.
+ */
+class TimerWheel {
+public:
+    TimerWheel();
+    ~TimerWheel();
+
+    // Schedule a target to expire at the given tick
+    void add(uint64_t deadline, uint64_t target);
+
+    // Move time forward to now, appending every timer that expired to out
+    void advance(uint64_t now, std::vector<WheelTimer>& out);
+
+    // Current tick
+    uint64_t getCurrentTick() const;
+
+    // Number of pending timers
+    size_t size() const;
+
+private:
+    static constexpr size_t kLevels = 5;
+    static constexpr size_t kSlotBits = 6;
+    static constexpr size_t kSlots = 1 << kSlotBits;
+
+    std::vector<WheelTimer> m_slots[kLevels][kSlots];
+    std::vector<WheelTimer> m_due;   // Timers added with a deadline already reached
+    uint64_t m_currentTick;
+    size_t m_count;
+
+    // Put a timer in the slot matching its distance from the current tick
+    void place(const WheelTimer& timer);
+
+    // Move the timers of a coarse slot down to finer levels
+    void cascade(size_t level);
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,304 @@
+// Trains samples/intent.flm, the model behind samples/intent_classifier.flrs.
+//
+// Build and run from the repository root:
+//   g++ -std=c++17 -O2 -I. tools/train_intent_model.cpp mlp_model.cpp linear_algebra.cpp text_index.cpp -o train_intent_model
+//   ./train_intent_model samples/intent.flm
+//
+// The network is 256 hashed term features -> 32 relu units (int8 weights) -> 8 softmax outputs
+// (fp32), one per intent of samples/simple_ai.flrs, trained by plain SGD from a fixed seed so
+// the same build writes the same file. Features are hashed exactly as MlpModel::textFeatures
+// does, which is checked against the written model before the program exits.
+
+#include "mlp_model.h"
+#include "text_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr size_t kInputs = 256;
+    constexpr size_t kHidden = 32;
+    constexpr size_t kEpochs = 3000;
+    constexpr float kLearningRate = 0.2f;
+
+    // Row strides are the widths rounded up to a multiple of 32; both already are
+    constexpr size_t kInputStride = 256;
+    constexpr size_t kHiddenStride = 32;
+
+    struct Intent {
+        const char* label;
+        std::vector<const char*> examples;
+    };
+
+    const std::vector<Intent> kIntents = {
+        {"hello", {"hello", "hi", "hey", "hello there", "hi there", "hey flare", "greetings", "good morning",
+                   "good evening", "howdy", "hi bot", "hello friend", "hey there how are you", "yo", "hiya",
+                   "hello again"}},
+        {"what is flare", {"what is flare", "what's flare", "tell me about flare", "what is this language",
+                           "explain flare", "what kind of language is flare", "describe flare", "who made flare",
+                           "what is the flare language", "flare what is it"}},
+        {"how does flare work", {"how does flare work", "how does it work", "how do flare scripts run",
+                                 "how is flare interpreted", "how does the interpreter work",
+                                 "explain how flare runs", "how do I run flare", "how does flare execute code",
+                                 "how flare works"}},
+        {"memory management", {"memory management", "how is memory managed", "tell me about memory",
+                               "static and dynamic memory", "how does memory work in flare", "memory models",
+                               "manage memory", "what memory modes are there", "dynamic mode memory",
+                               "static mode"}},
+        {"flamememory", {"flamememory", "what is flamememory", "tell me about flame memory", "fmem",
+                         "flame memory storage", "key value storage", "how do I store values",
+                         "fmem write and read", "what is fmem", "flame store"}},
+        {"help", {"help", "i need help", "can you help me", "help me please", "what can i ask", "assist me",
+                  "support", "i am stuck", "how do i use you", "what should i ask"}},
+        {"capabilities", {"capabilities", "what can flare do", "what are flare features", "features",
+                          "what can you do", "list capabilities", "abilities", "what is flare capable of",
+                          "show me features", "what features does it have"}},
+        {"default", {"the weather is nice", "pizza recipe", "who won the game", "blue green red",
+                     "random words here", "i like trains", "buy stocks now", "sing a song",
+                     "what time is it in tokyo", "the cat sat on the mat", "quantum physics", "cook pasta",
+                     "football scores", "tell me a joke"}},
+    };
+
+    // Same as MlpModel::textFeatures: FNV-1a of each term into a bucket, then unit length
+    void textFeatures(const std::string& text, float* features) {
+        std::fill(features, features + kInputs, 0.0f);
+        std::vector<std::string> terms;
+        TextIndex::tokenize(text, terms);
+        for (const auto& term : terms) {
+            uint32_t hash = 2166136261u;
+            for (char c : term) {
+                hash ^= static_cast<uint8_t>(c);
+                hash *= 16777619u;
+            }
+            features[hash % kInputs] += 1.0f;
+        }
+
+        float norm = 0.0f;
+        for (size_t j = 0; j < kInputs; j++) {
+            norm += features[j] * features[j];
+        }
+        if (norm > 0.0f) {
+            norm = 1.0f / std::sqrt(norm);
+            for (size_t j = 0; j < kInputs; j++) {
+                features[j] *= norm;
+            }
+        }
+    }
+
+    struct Network {
+        std::vector<float> hiddenWeights = std::vector<float>(kHidden * kInputs);
+        std::vector<float> hiddenBias = std::vector<float>(kHidden, 0.0f);
+        std::vector<float> outputWeights;
+        std::vector<float> outputBias;
+    };
+
+    // One SGD step on a sample; returns its cross-entropy loss
+    double trainStep(Network& net, const float* x, size_t label) {
+        size_t outputs = net.outputBias.size();
+        float hidden[kHidden];
+        for (size_t j = 0; j < kHidden; j++) {
+            float sum = net.hiddenBias[j];
+            for (size_t k = 0; k < kInputs; k++) {
+                sum += net.hiddenWeights[j * kInputs + k] * x[k];
+            }
+            hidden[j] = sum > 0 ? sum : 0;
+        }
+
+        std::vector<float> probabilities(outputs);
+        float largest = -1e9f;
+        for (size_t c = 0; c < outputs; c++) {
+            float sum = net.outputBias[c];
+            for (size_t j = 0; j < kHidden; j++) {
+                sum += net.outputWeights[c * kHidden + j] * hidden[j];
+            }
+            probabilities[c] = sum;
+            largest = std::max(largest, sum);
+        }
+        float total = 0;
+        for (size_t c = 0; c < outputs; c++) {
+            probabilities[c] = std::exp(probabilities[c] - largest);
+            total += probabilities[c];
+        }
+        for (size_t c = 0; c < outputs; c++) {
+            probabilities[c] /= total;
+        }
+        double loss = -std::log(probabilities[label] + 1e-9);
+
+        // Backpropagate through the softmax and the relu
+        float hiddenGradient[kHidden] = {0};
+        for (size_t c = 0; c < outputs; c++) {
+            float gradient = probabilities[c] - (c == label);
+            for (size_t j = 0; j < kHidden; j++) {
+                hiddenGradient[j] += gradient * net.outputWeights[c * kHidden + j];
+                net.outputWeights[c * kHidden + j] -= kLearningRate * gradient * hidden[j];
+            }
+            net.outputBias[c] -= kLearningRate * gradient;
+        }
+        for (size_t j = 0; j < kHidden; j++) {
+            if (hidden[j] <= 0) {
+                continue;
+            }
+            for (size_t k = 0; k < kInputs; k++) {
+                net.hiddenWeights[j * kInputs + k] -= kLearningRate * hiddenGradient[j] * x[k];
+            }
+            net.hiddenBias[j] -= kLearningRate * hiddenGradient[j];
+        }
+        return loss;
+    }
+
+    // Lay the network out as described in mlp_model.h
+    std::vector<char> encodeModel(const Network& net) {
+        size_t outputs = net.outputBias.size();
+        std::vector<char> file(64 + 2 * 40, 0);
+        auto align = [&](size_t alignment) {
+            while (file.size() % alignment != 0) {
+                file.push_back(0);
+            }
+        };
+        auto append = [&](const void* data, size_t size) {
+            size_t offset = file.size();
+            file.insert(file.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+            return static_cast<uint64_t>(offset);
+        };
+        auto put32 = [&](size_t offset, uint32_t value) { std::memcpy(&file[offset], &value, sizeof(value)); };
+        auto put64 = [&](size_t offset, uint64_t value) { std::memcpy(&file[offset], &value, sizeof(value)); };
+
+        // Hidden layer: each row quantized to int8 with its own scale
+        std::vector<int8_t> quantized(kHidden * kInputStride, 0);
+        std::vector<float> scales(kHidden);
+        for (size_t j = 0; j < kHidden; j++) {
+            float largest = 0;
+            for (size_t k = 0; k < kInputs; k++) {
+                largest = std::max(largest, std::fabs(net.hiddenWeights[j * kInputs + k]));
+            }
+            scales[j] = largest > 0 ? largest / 127 : 1;
+            for (size_t k = 0; k < kInputs; k++) {
+                quantized[j * kInputStride + k] = static_cast<int8_t>(std::lrint(net.hiddenWeights[j * kInputs + k] / scales[j]));
+            }
+        }
+        align(32);
+        uint64_t hiddenWeights = append(quantized.data(), quantized.size());
+        align(4);
+        uint64_t hiddenScales = append(scales.data(), scales.size() * sizeof(float));
+        uint64_t hiddenBias = append(net.hiddenBias.data(), kHidden * sizeof(float));
+
+        // Output layer, fp32
+        std::vector<float> padded(outputs * kHiddenStride, 0.0f);
+        for (size_t c = 0; c < outputs; c++) {
+            std::copy(net.outputWeights.begin() + c * kHidden, net.outputWeights.begin() + (c + 1) * kHidden,
+                      padded.begin() + c * kHiddenStride);
+        }
+        align(32);
+        uint64_t outputWeights = append(padded.data(), padded.size() * sizeof(float));
+        uint64_t outputBias = append(net.outputBias.data(), outputs * sizeof(float));
+
+        uint64_t labels = file.size();
+        for (const Intent& intent : kIntents) {
+            append(intent.label, std::strlen(intent.label) + 1);
+        }
+
+        std::memcpy(&file[0], "FLAREMLP", 8);
+        put32(8, 1);                        // version
+        put32(12, 2);                       // layers
+        put32(16, kInputs);
+        put32(20, outputs);
+        put32(24, outputs);                 // labels
+        put32(28, 1);                       // softmax
+        put64(32, labels);
+        put64(40, file.size());
+
+        put32(64, kInputs);
+        put32(68, kHidden);
+        put32(72, kInputStride);
+        file[76] = 1;                       // int8
+        file[77] = 1;                       // relu
+        put64(80, hiddenWeights);
+        put64(88, hiddenScales);
+        put64(96, hiddenBias);
+
+        put32(104, kHidden);
+        put32(108, outputs);
+        put32(112, kHiddenStride);
+        put64(120, outputWeights);
+        put64(136, outputBias);
+        return file;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s model.flm\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::vector<float>> samples;
+    std::vector<size_t> labels;
+    for (size_t c = 0; c < kIntents.size(); c++) {
+        for (const char* example : kIntents[c].examples) {
+            samples.emplace_back(kInputs);
+            textFeatures(example, samples.back().data());
+            labels.push_back(c);
+        }
+    }
+
+    // He initialization, with the hidden layer scaled up to learn from sparse inputs quickly
+    size_t outputs = kIntents.size();
+    std::mt19937 random(7);
+    std::normal_distribution<float> normal(0, 1);
+    Network net;
+    net.outputWeights.resize(outputs * kHidden);
+    net.outputBias.assign(outputs, 0.0f);
+    for (float& weight : net.hiddenWeights) {
+        weight = normal(random) * std::sqrt(2.0f / kInputs) * 4;
+    }
+    for (float& weight : net.outputWeights) {
+        weight = normal(random) * std::sqrt(2.0f / kHidden);
+    }
+
+    for (size_t epoch = 0; epoch < kEpochs; epoch++) {
+        double loss = 0;
+        for (size_t n = 0; n < samples.size(); n++) {
+            size_t i = random() % samples.size();
+            loss += trainStep(net, samples[i].data(), labels[i]);
+        }
+        if (epoch % 1000 == 0) {
+            std::fprintf(stderr, "epoch %zu loss %.4f\n", epoch, loss / samples.size());
+        }
+    }
+
+    std::vector<char> file = encodeModel(net);
+    FILE* out = std::fopen(argv[1], "wb");
+    if (out == nullptr || std::fwrite(file.data(), 1, file.size(), out) != file.size() || std::fclose(out) != 0) {
+        std::fprintf(stderr, "cannot write %s\n", argv[1]);
+        return 1;
+    }
+    std::fprintf(stderr, "wrote %zu bytes to %s\n", file.size(), argv[1]);
+
+    // Load it back the way the interpreter does and check the features and the fit
+    MlpModel model;
+    if (!model.load(argv[1])) {
+        std::fprintf(stderr, "%s\n", model.getLastError().c_str());
+        return 1;
+    }
+    size_t correct = 0;
+    std::vector<float> features(kInputs);
+    for (size_t c = 0; c < kIntents.size(); c++) {
+        for (const char* example : kIntents[c].examples) {
+            std::vector<float> expected(kInputs);
+            textFeatures(example, expected.data());
+            model.textFeatures(example, features.data());
+            if (features != expected) {
+                std::fprintf(stderr, "features of \"%s\" differ from MlpModel::textFeatures\n", example);
+                return 1;
+            }
+            correct += model.classify(features.data()) == c;
+        }
+    }
+    std::fprintf(stderr, "%zu of %zu examples classified correctly\n", correct, samples.size());
+    return 0;
+}
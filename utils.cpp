@@ -1,7 +1,9 @@
 #include "utils.h"
+#include "string_kernels.h"
 #include <algorithm>
 #include <sstream>
 #include <cctype>
+#include <stdexcept>
 
 Utils::Utils() {
 }
@@ -10,23 +12,23 @@ Utils::~Utils() {
 }
 
 std::string Utils::trim(const std::string& str) const {
-    auto start = std::find_if_not(str.begin(), str.end(), [](unsigned char c) {
-        return std::isspace(c);
-    });
-    
-    auto end = std::find_if_not(str.rbegin(), str.rend(), [](unsigned char c) {
-        return std::isspace(c);
-    }).base();
-    
-    return (start < end) ? std::string(start, end) : std::string();
+    return std::string(StringKernels::trim(str));
 }
 
 std::vector<std::string> Utils::split(const std::string& str, char delimiter) const {
+    std::vector<std::string_view> parts;
+    StringKernels::split(str, delimiter, parts);
+    
+    // A trailing delimiter ends the last token rather than starting an empty one,
+    // and an empty string has no tokens at all
+    if (parts.back().empty()) {
+        parts.pop_back();
+    }
+    
     std::vector<std::string> tokens;
-    std::stringstream ss(str);
-    std::string token;
-    while (std::getline(ss, token, delimiter)) {
-        tokens.push_back(trim(token));
+    tokens.reserve(parts.size());
+    for (std::string_view part : parts) {
+        tokens.emplace_back(StringKernels::trim(part));
     }
     return tokens;
 }
@@ -69,11 +71,40 @@ std::string Utils::toUpper(const std::string& str) const {
 }
 
 std::string Utils::replaceAll(const std::string& str, const std::string& from, const std::string& to) const {
-    std::string result = str;
-    size_t startPos = 0;
-    while ((startPos = result.find(from, startPos)) != std::string::npos) {
-        result.replace(startPos, from.length(), to);
-        startPos += to.length();
+    return StringKernels::replaceAll(str, from, to);
+}
+
+bool Utils::parseDurationMs(const std::string& str, uint64_t& milliseconds) const {
+    std::string text = trim(str);
+    size_t unitPos = 0;
+    while (unitPos < text.size() && (std::isdigit(static_cast<unsigned char>(text[unitPos])) || text[unitPos] == '.')) {
+        unitPos++;
     }
-    return result;
+    if (unitPos == 0) {
+        return false;
+    }
+    
+    double amount = 0.0;
+    try {
+        amount = std::stod(text.substr(0, unitPos));
+    } catch (const std::exception& e) {
+        return false;
+    }
+    
+    std::string unit = toLower(text.substr(unitPos));
+    double scale = 0.0;
+    if (unit.empty() || unit == "s") {
+        scale = 1000.0;
+    } else if (unit == "ms") {
+        scale = 1.0;
+    } else if (unit == "m") {
+        scale = 60.0 * 1000.0;
+    } else if (unit == "h") {
+        scale = 60.0 * 60.0 * 1000.0;
+    } else {
+        return false;
+    }
+    
+    milliseconds = static_cast<uint64_t>(amount * scale);
+    return true;
 }
@@ -1,6 +1,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -32,6 +33,9 @@ public:
     
     // Replace all occurrences of a substring
     std::string replaceAll(const std::string& str, const std::string& from, const std::string& to) const;
+    
+    // Parse a duration such as "500ms", "30s", "5m" or "2h" (plain numbers are seconds)
+    bool parseDurationMs(const std::string& str, uint64_t& milliseconds) const;
 };
 
 #endif // UTILS_H
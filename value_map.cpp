@@ -0,0 +1,145 @@
+#include "value_map.h"
+#include <functional>
+#include <utility>
+
+namespace {
+    uint32_t hashKey(std::string_view key) {
+        size_t hash = std::hash<std::string_view>{}(key);
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+    }
+}
+
+ValueMap::ValueMap() : m_size(0) {
+}
+
+uint32_t ValueMap::findEntry(std::string_view key) const {
+    // A few keys are compared faster than one is hashed
+    if (m_slots.empty()) {
+        for (uint32_t index = 0; index < m_entries.size(); index++) {
+            const Entry& entry = m_entries[index];
+            if (entry.isUsed && entry.key == key) {
+                return index;
+            }
+        }
+        return npos;
+    }
+
+    // An empty slot ends the probe sequence
+    uint32_t hash = hashKey(key);
+    size_t mask = m_slots.size() - 1;
+    for (size_t slot = hash & mask; m_slots[slot].entry != npos; slot = (slot + 1) & mask) {
+        if (m_slots[slot].hash == hash && m_entries[m_slots[slot].entry].key == key) {
+            return m_slots[slot].entry;
+        }
+    }
+    return npos;
+}
+
+Variable* ValueMap::find(std::string_view key) {
+    uint32_t index = findEntry(key);
+    return index == npos ? nullptr : &m_entries[index].value;
+}
+
+const Variable* ValueMap::find(std::string_view key) const {
+    uint32_t index = findEntry(key);
+    return index == npos ? nullptr : &m_entries[index].value;
+}
+
+void ValueMap::set(std::string_view key, Variable value) {
+    uint32_t index = findEntry(key);
+    if (index != npos) {
+        m_entries[index].value = std::move(value);
+        return;
+    }
+    uint32_t hash = hashKey(key);
+
+    m_entries.push_back({std::string(key), std::move(value), hash, true});
+    m_size++;
+    if (m_entries.size() > kSmallSize && m_entries.size() * 2 > m_slots.size()) {
+        rebuild();
+        return;
+    }
+    if (!m_slots.empty()) {
+        size_t mask = m_slots.size() - 1;
+        size_t slot = hash & mask;
+        while (m_slots[slot].entry != npos) {
+            slot = (slot + 1) & mask;
+        }
+        m_slots[slot] = {hash, static_cast<uint32_t>(m_entries.size() - 1)};
+    }
+}
+
+bool ValueMap::erase(std::string_view key) {
+    uint32_t index = findEntry(key);
+    if (index == npos) {
+        return false;
+    }
+
+    if (!m_slots.empty()) {
+        uint32_t hash = m_entries[index].hash;
+        size_t mask = m_slots.size() - 1;
+        size_t slot = hash & mask;
+        while (m_slots[slot].entry != index) {
+            slot = (slot + 1) & mask;
+        }
+
+        // Shift back every later slot of the run whose home lies at or before the hole
+        size_t hole = slot;
+        for (size_t next = (hole + 1) & mask; m_slots[next].entry != npos; next = (next + 1) & mask) {
+            size_t home = m_slots[next].hash & mask;
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                m_slots[hole] = m_slots[next];
+                hole = next;
+            }
+        }
+        m_slots[hole].entry = npos;
+    }
+
+    Entry& entry = m_entries[index];
+    entry.isUsed = false;
+    entry.key = std::string();
+    entry.value = Variable();
+    m_size--;
+
+    if (m_entries.size() - m_size > m_size) {
+        rebuild();
+    }
+    return true;
+}
+
+size_t ValueMap::size() const {
+    return m_size;
+}
+
+void ValueMap::rebuild() {
+    size_t live = 0;
+    for (size_t index = 0; index < m_entries.size(); index++) {
+        if (m_entries[index].isUsed) {
+            if (live != index) {
+                m_entries[live] = std::move(m_entries[index]);
+            }
+            live++;
+        }
+    }
+    m_entries.resize(live);
+
+    m_slots.clear();
+    if (live <= kSmallSize) {
+        return;
+    }
+
+    // At most half full, with room to grow before the next rebuild
+    size_t capacity = 16;
+    while (capacity < live * 4) {
+        capacity *= 2;
+    }
+    m_slots.assign(capacity, {0, npos});
+    size_t mask = capacity - 1;
+    for (uint32_t index = 0; index < live; index++) {
+        size_t slot = m_entries[index].hash & mask;
+        while (m_slots[slot].entry != npos) {
+            slot = (slot + 1) & mask;
+        }
+        m_slots[slot] = {m_entries[index].hash, index};
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef VALUE_MAP_H
+#define VALUE_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "variable.h"
+
+/**
+ * The entries of a script map (map.name = {}), keyed by string.
+ *
+ * Entries sit in an array in insertion order, which is also the order maps
+ * are printed and walked in. Up to kSmallSize entries are found by scanning
+ * that array and comparing keys, which beats hashing the key, so small
+ * maps keep no index at all. Past that, an open-addressing index of
+ * (hash, entry) slots with linear probing is built beside the array; it is
+ * kept at most half full, and erasing shifts later slots back instead of
+ * leaving tombstones.
+ * Erased entries leave holes in the array until they outnumber the live
+ * ones, when the array is compacted and the index rebuilt.
+ */
+class ValueMap {
+public:
+    ValueMap();
+
+    // Look up a key; returns nullptr if it is not present
+    Variable* find(std::string_view key);
+    const Variable* find(std::string_view key) const;
+
+    // Insert a value or overwrite the one already under key
+    void set(std::string_view key, Variable value);
+
+    // Remove a key; returns false if it was not present
+    bool erase(std::string_view key);
+
+    // Number of entries
+    size_t size() const;
+
+    // Call func(key, value) for every entry, in insertion order
+    template <typename Func>
+    void forEach(Func func) const {
+        for (const auto& entry : m_entries) {
+            if (entry.isUsed) {
+                func(std::string_view(entry.key), entry.value);
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kSmallSize = 8;
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    struct Entry {
+        std::string key;
+        Variable value;
+        uint32_t hash;
+        bool isUsed;
+    };
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t entry;     // npos for an empty slot
+    };
+
+    std::vector<Entry> m_entries;
+    std::vector<Slot> m_slots;      // Empty while the map is small
+    size_t m_size;
+
+    // Index of the entry holding key, or npos
+    uint32_t findEntry(std::string_view key) const;
+
+    // Compact the entries and rebuild the index to suit their number
+    void rebuild();
+};
+
+#endif // VALUE_MAP_H
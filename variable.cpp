@@ -1,19 +1,102 @@
 #include "variable.h"
+#include "parser.h"
+#include "value_map.h"
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <string_view>
 
 Variable::Variable() : m_typeAndName("unknown"), m_name("unknown"), m_type(Type::UNKNOWN) {
     m_value = std::string("");
 }
 
-Variable::Variable(const std::string& typeAndName, const std::string& value) 
-    : m_typeAndName(typeAndName) {
+Variable::Variable(const std::string& typeAndName, const std::string& value) {
+    setTypeAndName(typeAndName);
     
-    // Extract the name part (after the dot)
+    // Set the value based on the type
+    setValueFromString(value);
+}
+
+Variable::Variable(const std::string& typeAndName, std::vector<float> values) {
+    setTypeAndName(typeAndName);
+    m_value = PackedList<float>(std::move(values));
+}
+
+Variable::Variable(const std::string& typeAndName, std::vector<int> values) {
+    setTypeAndName(typeAndName);
+    m_value = PackedList<int>(std::move(values));
+}
+
+Variable::Variable(const std::string& typeAndName, std::vector<std::string> values) {
+    setTypeAndName(typeAndName);
+    m_value = PackedList<std::string>(std::move(values));
+}
+
+Variable::Variable(const std::string& typeAndName, BitVector value) {
+    setTypeAndName(typeAndName);
+    m_value = std::move(value);
+}
+
+Variable::Variable(const std::string& typeAndName, BufferView value) {
+    setTypeAndName(typeAndName);
+    m_value = std::move(value);
+}
+
+Variable::Variable(const std::string& typeAndName, const Variable& value) {
+    setTypeAndName(typeAndName);
+    const BitVector* bits = value.getBinaryValue();
+    if (m_type == Type::BINARY && bits != nullptr) {
+        m_value = bits->resized(getDeclaredWidth(typeAndName));
+    } else if (m_type == Type::BINARY && value.m_type == Type::INTEGER) {
+        // A negative int keeps its two's complement bits
+        m_value = BitVector(getDeclaredWidth(typeAndName), static_cast<uint64_t>(static_cast<int64_t>(value.getIntValue())));
+    } else if (m_type == Type::INTEGER && bits != nullptr) {
+        m_value = static_cast<int>(bits->toUint64());
+    } else if (m_type == value.m_type) {
+        m_value = value.m_value;
+    } else {
+        setValueFromString(value.getValueAsString());
+    }
+}
+
+size_t Variable::getDeclaredWidth(const std::string& typeAndName) {
+    const size_t defaultWidth = 32;
+    if (typeAndName.compare(0, 4, "bin.") != 0) {
+        return 0;
+    }
+    size_t widthEnd = typeAndName.find('.', 4);
+    if (widthEnd == std::string::npos || widthEnd == 4) {
+        return defaultWidth;
+    }
+    size_t width = 0;
+    for (size_t i = 4; i < widthEnd; i++) {
+        if (!std::isdigit(static_cast<unsigned char>(typeAndName[i])) || width > BitVector::kMaxWidth) {
+            return defaultWidth;
+        }
+        width = width * 10 + static_cast<size_t>(typeAndName[i] - '0');
+    }
+    return width >= 1 && width <= BitVector::kMaxWidth ? width : defaultWidth;
+}
+
+Variable::Variable(Type type, const char* typeAndName, ValueType value)
+    : m_typeAndName(typeAndName), m_name("item"), m_type(type), m_value(std::move(value)) {
+}
+
+void Variable::setTypeAndName(const std::string& typeAndName) {
+    m_typeAndName = typeAndName;
+    
+    // Extract the name part (after the dot, and after the width of bin.16.name)
     size_t dotPos = typeAndName.find('.');
     if (dotPos != std::string::npos && dotPos + 1 < typeAndName.length()) {
         m_name = typeAndName.substr(dotPos + 1);
+        size_t widthEnd = m_name.find('.');
+        if (typeAndName.compare(0, dotPos, "bin") == 0 && widthEnd != std::string::npos && widthEnd > 0 &&
+            std::all_of(m_name.begin(), m_name.begin() + widthEnd, [](unsigned char c) { return std::isdigit(c); })) {
+            m_name = m_name.substr(widthEnd + 1);
+        }
     } else {
         m_name = typeAndName;
     }
@@ -27,9 +110,6 @@ Variable::Variable(const std::string& typeAndName, const std::string& value)
     }
     
     m_type = typeFromString(typeStr);
-    
-    // Set the value based on the type
-    setValueFromString(value);
 }
 
 std::string Variable::getTypeAndName() const {
@@ -54,6 +134,8 @@ std::string Variable::getTypeString() const {
         case Type::BINARY: return "bin";
         case Type::LIST: return "ls";
         case Type::BOOLEAN: return "act";
+        case Type::MAP: return "map";
+        case Type::BUFFER: return "buf";
         default: return "unknown";
     }
 }
@@ -63,8 +145,8 @@ Variable::Type Variable::getType() const {
 }
 
 std::string Variable::getValueAsString() const {
-    if (std::holds_alternative<std::string>(m_value)) {
-        return std::get<std::string>(m_value);
+    if (const std::string* text = getString()) {
+        return *text;
     }
     else if (std::holds_alternative<int>(m_value)) {
         return std::to_string(std::get<int>(m_value));
@@ -75,31 +157,96 @@ std::string Variable::getValueAsString() const {
     else if (std::holds_alternative<bool>(m_value)) {
         return std::get<bool>(m_value) ? "true" : "false";
     }
-    else if (std::holds_alternative<std::vector<Variable>>(m_value)) {
-        std::stringstream ss;
-        ss << "[";
-        const auto& list = std::get<std::vector<Variable>>(m_value);
-        for (size_t i = 0; i < list.size(); ++i) {
-            ss << list[i].getValueAsString();
-            if (i < list.size() - 1) {
-                ss << ", ";
+    else if (std::holds_alternative<PackedList<Variable>>(m_value) || std::holds_alternative<PackedList<float>>(m_value) ||
+             std::holds_alternative<PackedList<int>>(m_value) || std::holds_alternative<PackedList<std::string>>(m_value)) {
+        std::string result = "[";
+        for (size_t i = 0; i < getListLength(); i++) {
+            if (i > 0) {
+                result += ", ";
             }
+            result += getListItem(i).getValueAsString();
         }
-        ss << "]";
-        return ss.str();
+        return result + "]";
+    }
+    else if (const BitVector* bits = getBinaryValue()) {
+        return bits->toString();
+    }
+    else if (const ValueMap* map = getMap()) {
+        std::string result = "{";
+        map->forEach([&](std::string_view key, const Variable& value) {
+            if (result.size() > 1) {
+                result += ", ";
+            }
+            result.append(key);
+            result += ": ";
+            result += value.getValueAsString();
+        });
+        return result + "}";
+    }
+    else if (const BufferView* view = getBuffer()) {
+        return "buf(" + std::to_string(view->getBlockId()) + ", " + std::to_string(view->getOffset()) + ", " +
+               std::to_string(view->getLength()) + ")";
     }
     
     return "";
 }
 
+size_t Variable::getByteSize() const {
+    if (const std::string* text = getString()) {
+        return text->size();
+    }
+    else if (std::holds_alternative<int>(m_value)) {
+        return sizeof(int);
+    }
+    else if (std::holds_alternative<float>(m_value)) {
+        return sizeof(float);
+    }
+    else if (std::holds_alternative<bool>(m_value)) {
+        return sizeof(bool);
+    }
+    else if (std::holds_alternative<PackedList<Variable>>(m_value)) {
+        size_t total = 0;
+        for (const auto& item : std::get<PackedList<Variable>>(m_value)) {
+            total += item.getByteSize();
+        }
+        return total;
+    }
+    else if (std::holds_alternative<PackedList<float>>(m_value)) {
+        return std::get<PackedList<float>>(m_value).size() * sizeof(float);
+    }
+    else if (std::holds_alternative<PackedList<int>>(m_value)) {
+        return std::get<PackedList<int>>(m_value).size() * sizeof(int);
+    }
+    else if (std::holds_alternative<PackedList<std::string>>(m_value)) {
+        size_t total = 0;
+        for (const auto& item : std::get<PackedList<std::string>>(m_value)) {
+            total += item.size();
+        }
+        return total;
+    }
+    else if (const BitVector* bits = getBinaryValue()) {
+        return (bits->width() + 7) / 8;
+    }
+    else if (const ValueMap* map = getMap()) {
+        size_t total = 0;
+        map->forEach([&](std::string_view key, const Variable& value) {
+            total += key.size() + value.getByteSize();
+        });
+        return total;
+    }
+    
+    // A buf value's bytes belong to its block, which is counted there
+    return 0;
+}
+
 void Variable::setValueFromString(const std::string& value) {
     switch (m_type) {
         case Type::STRING: {
             // Remove quotes if present
             if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
-                m_value = value.substr(1, value.size() - 2);
+                m_value = makeString(value.substr(1, value.size() - 2));
             } else {
-                m_value = value;
+                m_value = makeString(value);
             }
             break;
         }
@@ -120,17 +267,13 @@ void Variable::setValueFromString(const std::string& value) {
             break;
         }
         case Type::BINARY: {
-            // Handle binary values (hexadecimal, etc.)
-            try {
-                // Assuming hexadecimal format (0xNNNN)
-                if (value.substr(0, 2) == "0x") {
-                    m_value = std::stoi(value.substr(2), nullptr, 16);
-                } else {
-                    m_value = std::stoi(value);
-                }
-            } catch (...) {
-                m_value = 0;
+            // 0x hex, 0b binary or decimal, cut to the declared width; anything else is zero
+            size_t width = getDeclaredWidth(m_typeAndName);
+            BitVector bits;
+            if (!BitVector::parse(value, width, bits)) {
+                bits = BitVector(width, 0);
             }
+            m_value = std::move(bits);
             break;
         }
         case Type::BOOLEAN: {
@@ -142,21 +285,43 @@ void Variable::setValueFromString(const std::string& value) {
             break;
         }
         case Type::LIST: {
-            // Initialize an empty list
-            m_value = std::vector<Variable>();
-            // In a full implementation, we would parse the string to extract list elements
+            // List literals are parsed; anything else starts out empty
+            if (!parseListLiteral(value)) {
+                m_value = PackedList<Variable>();
+            }
+            break;
+        }
+        case Type::MAP: {
+            // Map literals are parsed; anything else starts out empty
+            if (!parseMapLiteral(value)) {
+                m_value = std::make_shared<ValueMap>();
+            }
+            break;
+        }
+        case Type::BUFFER: {
+            // Views only come from view(); text gives one onto no block
+            m_value = BufferView();
             break;
         }
         default:
-            m_value = std::string(value);
+            m_value = makeString(value);
             break;
     }
 }
 
+void Variable::setIntValue(int value) {
+    if (m_type == Type::INTEGER) {
+        m_value = value;
+    }
+}
+
 int Variable::getIntValue() const {
     if (std::holds_alternative<int>(m_value)) {
         return std::get<int>(m_value);
     }
+    if (const BitVector* bits = getBinaryValue()) {
+        return static_cast<int>(bits->toUint64());
+    }
     return 0;
 }
 
@@ -167,11 +332,38 @@ float Variable::getFloatValue() const {
     return 0.0f;
 }
 
-std::string Variable::getStringValue() const {
-    if (std::holds_alternative<std::string>(m_value)) {
-        return std::get<std::string>(m_value);
+const std::string& Variable::getStringValue() const {
+    static const std::string empty;
+    const std::string* text = getString();
+    return text != nullptr ? *text : empty;
+}
+
+Variable::ValueType Variable::makeString(std::string value) {
+    // Strings this short live in std::string's own small buffer, where copying them
+    // costs no more than sharing
+    const size_t inlineLength = 15;
+    if (value.size() <= inlineLength) {
+        return value;
     }
-    return "";
+    return std::make_shared<std::string>(std::move(value));
+}
+
+const std::string* Variable::getString() const {
+    if (auto* text = std::get_if<std::string>(&m_value)) {
+        return text;
+    }
+    if (auto* shared = std::get_if<SharedString>(&m_value)) {
+        return shared->get();
+    }
+    return nullptr;
+}
+
+const BitVector* Variable::getBinaryValue() const {
+    return std::get_if<BitVector>(&m_value);
+}
+
+const BufferView* Variable::getBuffer() const {
+    return std::get_if<BufferView>(&m_value);
 }
 
 bool Variable::getBoolValue() const {
@@ -182,25 +374,306 @@ bool Variable::getBoolValue() const {
 }
 
 std::vector<Variable> Variable::getListValue() const {
-    if (std::holds_alternative<std::vector<Variable>>(m_value)) {
-        return std::get<std::vector<Variable>>(m_value);
+    if (auto* boxed = std::get_if<PackedList<Variable>>(&m_value)) {
+        return std::vector<Variable>(boxed->begin(), boxed->end());
+    }
+    std::vector<Variable> items;
+    items.reserve(getListLength());
+    for (size_t i = 0; i < getListLength(); i++) {
+        items.push_back(getListItem(i));
+    }
+    return items;
+}
+
+const PackedList<float>* Variable::getFloatArray() const {
+    return std::get_if<PackedList<float>>(&m_value);
+}
+
+const PackedList<int>* Variable::getIntArray() const {
+    return std::get_if<PackedList<int>>(&m_value);
+}
+
+const PackedList<std::string>* Variable::getStringArray() const {
+    return std::get_if<PackedList<std::string>>(&m_value);
+}
+
+size_t Variable::getListLength() const {
+    if (auto* items = std::get_if<PackedList<Variable>>(&m_value)) {
+        return items->size();
+    }
+    if (auto* floats = std::get_if<PackedList<float>>(&m_value)) {
+        return floats->size();
+    }
+    if (auto* ints = std::get_if<PackedList<int>>(&m_value)) {
+        return ints->size();
+    }
+    if (auto* strings = std::get_if<PackedList<std::string>>(&m_value)) {
+        return strings->size();
+    }
+    return 0;
+}
+
+Variable Variable::getListItem(size_t index) const {
+    if (auto* items = std::get_if<PackedList<Variable>>(&m_value)) {
+        return (*items)[index];
+    }
+    
+    // Packed items are boxed under short names, which don't allocate
+    if (auto* floats = std::get_if<PackedList<float>>(&m_value)) {
+        return Variable(Type::FLOAT, "fl.item", (*floats)[index]);
+    }
+    if (auto* ints = std::get_if<PackedList<int>>(&m_value)) {
+        return Variable(Type::INTEGER, "int.item", (*ints)[index]);
+    }
+    if (auto* strings = std::get_if<PackedList<std::string>>(&m_value)) {
+        return Variable(Type::STRING, "str.item", makeString((*strings)[index]));
+    }
+    return Variable();
+}
+
+Variable Variable::getListSlice(size_t start, size_t end) const {
+    Variable slice = *this;
+    if (auto* items = std::get_if<PackedList<Variable>>(&m_value)) {
+        slice.m_value = items->slice(start, end);
+    } else if (auto* floats = std::get_if<PackedList<float>>(&m_value)) {
+        slice.m_value = floats->slice(start, end);
+    } else if (auto* ints = std::get_if<PackedList<int>>(&m_value)) {
+        slice.m_value = ints->slice(start, end);
+    } else if (auto* strings = std::get_if<PackedList<std::string>>(&m_value)) {
+        slice.m_value = strings->slice(start, end);
     }
-    return std::vector<Variable>();
+    return slice;
+}
+
+bool Variable::setListItem(size_t index, Variable&& var) {
+    if (index >= getListLength()) {
+        return false;
+    }
+    
+    // Same rules as addToList: the packed type is kept where the item allows it
+    if (auto* ints = std::get_if<PackedList<int>>(&m_value)) {
+        if (var.isInteger()) {
+            ints->set(index, var.getIntValue());
+            return true;
+        }
+        if (var.isFloat()) {
+            std::vector<float> floats(ints->begin(), ints->end());
+            m_value = PackedList<float>(std::move(floats));
+        }
+    }
+    if (auto* floats = std::get_if<PackedList<float>>(&m_value)) {
+        if (var.isFloat() || var.isInteger()) {
+            floats->set(index, var.isFloat() ? var.getFloatValue() : static_cast<float>(var.getIntValue()));
+            return true;
+        }
+    } else if (auto* strings = std::get_if<PackedList<std::string>>(&m_value)) {
+        if (var.isString()) {
+            strings->set(index, var.getStringValue());
+            return true;
+        }
+    }
+    unpackList();
+    std::get<PackedList<Variable>>(m_value).set(index, std::move(var));
+    return true;
+}
+
+void Variable::appendString(const std::string& text) {
+    if (auto* shared = std::get_if<SharedString>(&m_value)) {
+        if (shared->use_count() == 1) {
+            // std::string grows its buffer geometrically, so repeated appends are amortized O(1)
+            (*shared)->append(text);
+            return;
+        }
+    } else if (auto* inlineText = std::get_if<std::string>(&m_value)) {
+        inlineText->append(text);
+        m_value = makeString(std::move(*inlineText));
+        return;
+    }
+    
+    // Shared with other variables: this one gets a copy of its own
+    const std::string& current = getStringValue();
+    std::string value;
+    value.reserve(current.size() + text.size());
+    value += current;
+    value += text;
+    m_value = makeString(std::move(value));
 }
 
 void Variable::addToList(const Variable& var) {
+    addToList(Variable(var));
+}
+
+void Variable::addToList(Variable&& var) {
     if (m_type == Type::LIST) {
-        if (std::holds_alternative<std::vector<Variable>>(m_value)) {
-            std::get<std::vector<Variable>>(m_value).push_back(var);
-        } else {
-            // Initialize the list if it's not already one
-            std::vector<Variable> list;
-            list.push_back(var);
-            m_value = list;
+        // An empty list takes the packed type of its first item
+        if (getListLength() == 0) {
+            if (var.isInteger()) {
+                m_value = PackedList<int>();
+            } else if (var.isFloat()) {
+                m_value = PackedList<float>();
+            } else if (var.isString()) {
+                m_value = PackedList<std::string>();
+            }
+        }
+        
+        // Items of the packed type stay packed, and ints join a float list as floats;
+        // a float joining an int list turns it into floats, anything else unpacks it
+        if (auto* ints = std::get_if<PackedList<int>>(&m_value)) {
+            if (var.isInteger()) {
+                ints->push_back(var.getIntValue());
+                return;
+            }
+            if (var.isFloat()) {
+                std::vector<float> floats(ints->begin(), ints->end());
+                m_value = PackedList<float>(std::move(floats));
+            }
         }
+        if (auto* floats = std::get_if<PackedList<float>>(&m_value)) {
+            if (var.isFloat() || var.isInteger()) {
+                floats->push_back(var.isFloat() ? var.getFloatValue() : static_cast<float>(var.getIntValue()));
+                return;
+            }
+        } else if (auto* strings = std::get_if<PackedList<std::string>>(&m_value)) {
+            if (var.isString()) {
+                strings->push_back(var.getStringValue());
+                return;
+            }
+        }
+        unpackList();
+        
+        if (!std::holds_alternative<PackedList<Variable>>(m_value)) {
+            m_value = PackedList<Variable>();
+        }
+        std::get<PackedList<Variable>>(m_value).push_back(std::move(var));
     }
 }
 
+bool Variable::parseListLiteral(const std::string& value) {
+    ArgList items;
+    if (!Parser().parseListLiteral(value, items)) {
+        return false;
+    }
+    
+    // Items are ints while every one is a whole number literal, then floats while
+    // every one is a number; otherwise all are strings, numbers included as written
+    std::vector<int> ints;
+    std::vector<float> floats;
+    bool allInts = true;
+    bool allNumbers = true;
+    bool nested = false;
+    for (const auto& item : items) {
+        if (!item.empty() && (item.front() == '[' || item.front() == '{')) {
+            nested = true;
+        }
+        if (!allNumbers) {
+            continue;
+        }
+        
+        const char* start = item.c_str();
+        char* end = nullptr;
+        errno = 0;
+        float number = std::strtof(start, &end);
+        if (end == start || errno == ERANGE || *end != '\0') {
+            allNumbers = false;
+            allInts = false;
+            continue;
+        }
+        floats.push_back(number);
+        
+        if (allInts) {
+            long whole = std::strtol(start, &end, 10);
+            if (*end == '\0' && whole >= INT_MIN && whole <= INT_MAX) {
+                ints.push_back(static_cast<int>(whole));
+            } else {
+                allInts = false;
+            }
+        }
+    }
+    
+    if (items.empty()) {
+        m_value = PackedList<Variable>();
+    } else if (nested) {
+        // Nested lists and maps can't be packed; every item is boxed with its own type
+        std::vector<Variable> boxed;
+        for (const auto& item : items) {
+            boxed.push_back(parseLiteralItem(std::string(item)));
+        }
+        m_value = PackedList<Variable>(std::move(boxed));
+    } else if (allInts) {
+        m_value = PackedList<int>(std::move(ints));
+    } else if (allNumbers) {
+        m_value = PackedList<float>(std::move(floats));
+    } else {
+        std::vector<std::string> strings;
+        strings.reserve(items.size());
+        for (const auto& item : items) {
+            // Remove quotes if present
+            if (item.size() >= 2 && item.front() == '"' && item.back() == '"') {
+                strings.emplace_back(item, 1, item.size() - 2);
+            } else {
+                strings.emplace_back(item);
+            }
+        }
+        m_value = PackedList<std::string>(std::move(strings));
+    }
+    return true;
+}
+
+bool Variable::parseMapLiteral(const std::string& value) {
+    ArgList keys;
+    ArgList values;
+    if (!Parser().parseMapLiteral(value, keys, values)) {
+        return false;
+    }
+    
+    auto map = std::make_shared<ValueMap>();
+    for (size_t i = 0; i < keys.size(); i++) {
+        std::string_view key = keys[i];
+        // Remove quotes if present
+        if (key.size() >= 2 && key.front() == '"' && key.back() == '"') {
+            key = key.substr(1, key.size() - 2);
+        }
+        map->set(key, parseLiteralItem(std::string(values[i])));
+    }
+    m_value = std::move(map);
+    return true;
+}
+
+Variable Variable::parseLiteralItem(const std::string& item) {
+    if (!item.empty() && item.front() == '[') {
+        return Variable("ls.item", item);
+    }
+    if (!item.empty() && item.front() == '{') {
+        return Variable("map.item", item);
+    }
+    
+    // A scalar is typed the way a list of just that item would be
+    Variable single("ls.item", "[" + item + "]");
+    return single.getListLength() == 1 ? single.getListItem(0) : Variable("str.item", "");
+}
+
+void Variable::unpackList() {
+    if (getFloatArray() != nullptr || getIntArray() != nullptr || getStringArray() != nullptr) {
+        m_value = PackedList<Variable>(getListValue());
+    }
+}
+
+const ValueMap* Variable::getMap() const {
+    auto* map = std::get_if<std::shared_ptr<ValueMap>>(&m_value);
+    return map != nullptr ? map->get() : nullptr;
+}
+
+ValueMap* Variable::getMutableMap() {
+    auto* map = std::get_if<std::shared_ptr<ValueMap>>(&m_value);
+    if (map == nullptr) {
+        return nullptr;
+    }
+    if (map->use_count() != 1) {
+        *map = std::make_shared<ValueMap>(**map);
+    }
+    return map->get();
+}
+
 bool Variable::isString() const {
     return m_type == Type::STRING;
 }
@@ -225,6 +698,14 @@ bool Variable::isBoolean() const {
     return m_type == Type::BOOLEAN;
 }
 
+bool Variable::isMap() const {
+    return m_type == Type::MAP;
+}
+
+bool Variable::isBuffer() const {
+    return m_type == Type::BUFFER;
+}
+
 Variable::Type Variable::typeFromString(const std::string& typeStr) {
     if (typeStr == "str") return Type::STRING;
     if (typeStr == "int") return Type::INTEGER;
@@ -232,6 +713,8 @@ Variable::Type Variable::typeFromString(const std::string& typeStr) {
     if (typeStr == "bin") return Type::BINARY;
     if (typeStr == "ls") return Type::LIST;
     if (typeStr == "act") return Type::BOOLEAN;
+    if (typeStr == "map") return Type::MAP;
+    if (typeStr == "buf") return Type::BUFFER;
     
     // Default to string for unknown types
     return Type::STRING;
@@ -1,10 +1,16 @@
 #ifndef VARIABLE_H
 #define VARIABLE_H
 
+#include "bit_vector.h"
+#include "buffer_view.h"
+#include "packed_list.h"
+#include <memory>
 #include <string>
 #include <vector>
 #include <variant>
 
+class ValueMap;
+
 /**
  * Represents a variable in the Flare language.
  * Variables in Flare have a type and a value.
@@ -19,6 +25,8 @@ public:
         BINARY,     // bin
         LIST,       // ls
         BOOLEAN,    // act
+        MAP,        // map
+        BUFFER,     // buf
         UNKNOWN
     };
 
@@ -26,6 +34,25 @@ public:
     Variable();
     Variable(const std::string& typeAndName, const std::string& value);
     
+    // A list packed as plain numbers or strings
+    Variable(const std::string& typeAndName, std::vector<float> values);
+    Variable(const std::string& typeAndName, std::vector<int> values);
+    Variable(const std::string& typeAndName, std::vector<std::string> values);
+    
+    // A binary value; its width is the value's own, not one given in typeAndName
+    Variable(const std::string& typeAndName, BitVector value);
+    
+    // A view of bytes in a memory block
+    Variable(const std::string& typeAndName, BufferView value);
+    
+    // A copy of value under another type and name; when the types differ the value
+    // converts through its string form. A binary value takes the width typeAndName gives it
+    Variable(const std::string& typeAndName, const Variable& value);
+    
+    // Bits of a bin variable declared as "bin.16.name", or the default width of 32 for
+    // "bin.name"; 0 if typeAndName isn't a bin declaration
+    static size_t getDeclaredWidth(const std::string& typeAndName);
+    
     // Get the full type and name (e.g., "str.name")
     std::string getTypeAndName() const;
     
@@ -41,18 +68,60 @@ public:
     // Get the value as a string
     std::string getValueAsString() const;
     
+    // Get the size of the value payload in bytes
+    size_t getByteSize() const;
+    
     // Set the value from a string
     void setValueFromString(const std::string& value);
     
+    // Set an int variable's value directly; other types are left as they are
+    void setIntValue(int value);
+    
     // Get the specific value based on type
     int getIntValue() const;
     float getFloatValue() const;
-    std::string getStringValue() const;
+    const std::string& getStringValue() const;
     bool getBoolValue() const;
+    
+    // The bits of a binary value, or nullptr for anything else
+    const BitVector* getBinaryValue() const;
+    
+    // The window of a buf value, or nullptr for anything else
+    const BufferView* getBuffer() const;
+    
+    // The items of a list, copied out; getListLength and getListItem read them in place
     std::vector<Variable> getListValue() const;
     
+    // The items of a packed list, or nullptr if the list isn't packed that way
+    const PackedList<float>* getFloatArray() const;
+    const PackedList<int>* getIntArray() const;
+    const PackedList<std::string>* getStringArray() const;
+    
+    // Number of items in a list, 0 for anything else
+    size_t getListLength() const;
+    
+    // Item at index, which must be below getListLength()
+    Variable getListItem(size_t index) const;
+    
+    // Items [start, end) of a list, clamped to it; a packed list shares its items
+    Variable getListSlice(size_t start, size_t end) const;
+    
+    // Replace the item at index of a list; returns false if index is out of range
+    bool setListItem(size_t index, Variable&& var);
+    
+    // Append text to a string value, growing it in place unless other variables share it
+    void appendString(const std::string& text);
+    
     // Add a value to a list variable
     void addToList(const Variable& var);
+    void addToList(Variable&& var);
+    
+    // The entries of a map, or nullptr for anything else
+    const ValueMap* getMap() const;
+    
+    // The entries of a map to change, first copied if other variables share them;
+    // nullptr for anything else
+    ValueMap* getMutableMap();
     
     // Check if the variable is of a specific type
     bool isString() const;
@@ -61,18 +130,52 @@ public:
     bool isBinary() const;
     bool isList() const;
     bool isBoolean() const;
+    bool isMap() const;
+    bool isBuffer() const;
 
 private:
     std::string m_typeAndName;  // Full type.name
     std::string m_name;         // Just the name
     Type m_type;                // Type enum
     
-    // Value can be one of several types
-    using ValueType = std::variant<std::string, int, float, bool, std::vector<Variable>>;
+    // Strings too long to be stored inline are shared between copies; only a sole owner
+    // changes one, by appending to it
+    using SharedString = std::shared_ptr<std::string>;
+    
+    // Value can be one of several types; lists of numbers or strings are packed, and
+    // every list shares its items between copies until one of them is changed
+    using ValueType = std::variant<std::string, SharedString, int, float, bool, PackedList<Variable>,
+                                   PackedList<float>, PackedList<int>, PackedList<std::string>,
+                                   std::shared_ptr<ValueMap>, BitVector, BufferView>;
     ValueType m_value;
     
+    // A string value, kept inline when short and shared otherwise
+    static ValueType makeString(std::string value);
+    
+    // The string value, or nullptr if the value isn't a string
+    const std::string* getString() const;
+    
+    // A list item, named "item"
+    Variable(Type type, const char* typeAndName, ValueType value);
+    
+    // Set the type and name parts from a "type.name" string
+    void setTypeAndName(const std::string& typeAndName);
+    
     // Helper method to determine the type from a type string
     Type typeFromString(const std::string& typeStr);
+    
+    // Parse a list literal such as [1, 2.5, -3] or ["a", "b"] into a list packed as
+    // ints, floats or strings by its contents; returns false if value isn't a list literal
+    bool parseListLiteral(const std::string& value);
+    
+    // Parse a map literal such as {} or {"a": 1, b: [2, 3]}; returns false if value isn't one
+    bool parseMapLiteral(const std::string& value);
+    
+    // One item of a list or map literal, typed by its text
+    static Variable parseLiteralItem(const std::string& item);
+    
+    // Turn a packed list into a list of separate items
+    void unpackList();
 };
 
 #endif // VARIABLE_H